@@ -0,0 +1,175 @@
+/****************************************************************
+Finds the strongly connected components of a directed graph with
+an iterative version of Tarjan's algorithm, so the depth of the
+search is not limited by the call stack. Each component is then
+marked as closed if no edge leaves it. Closed components with at
+least one edge are the rank sinks of the graph.
+****************************************************************/
+
+#include "componentfinder.h"
+
+#include <algorithm>
+
+// marks a node not yet reached by the search
+static const MatrixIndex UNVISITED = 0xFFFFFFFF;
+
+// Find the strongly connected components of a graph in time linear in the
+// number of nodes and edges. Rather than recursing, the search keeps a stack
+// of the nodes it is part way through. When a node is first reached all its
+// out-neighbours are pushed onto a stack of edges still to follow, and the
+// node is finished once its edges have all been popped.
+void ComponentFinder::findComponents(const DirectedGraph& graph)
+{
+    MatrixIndex numberOfNodes = graph.getNodeCount();
+
+    // order in which each node was reached, and the earliest node on the
+    // component stack reachable from it
+    std::vector<MatrixIndex> visitOrder(numberOfNodes, UNVISITED);
+    std::vector<MatrixIndex> lowLink(numberOfNodes);
+    std::vector<bool> onComponentStack(numberOfNodes, false);
+    // nodes reached but not yet assigned a component
+    std::vector<MatrixIndex> componentStack;
+    // nodes being searched, and where each one's edges start on the edge stack
+    std::vector<std::pair<MatrixIndex, size_t> > searchStack;
+    // targets of the edges still to be followed
+    std::vector<MatrixIndex> edgeStack;
+    MatrixIndex visitCount = 0;
+
+    m_components.assign(numberOfNodes, UNVISITED);
+    m_componentSizes.clear();
+
+    // reach a node for the first time
+    auto visit = [&](MatrixIndex node)
+    {
+	visitOrder[node] = lowLink[node] = visitCount++;
+	componentStack.push_back(node);
+	onComponentStack[node] = true;
+	searchStack.push_back(std::make_pair(node, edgeStack.size()));
+	graph.forEachOutNeighbour(node, [&edgeStack](MatrixIndex tonode)
+	{
+	    edgeStack.push_back(tonode);
+	});
+    };
+
+    for(MatrixIndex root = 0 ; root < numberOfNodes ; ++root)
+    {
+	if(visitOrder[root] != UNVISITED)
+	{
+	    continue;
+	}
+
+	visit(root);
+
+	while(!searchStack.empty())
+	{
+	    MatrixIndex node = searchStack.back().first;
+
+	    if(edgeStack.size() > searchStack.back().second)
+	    {
+		MatrixIndex tonode = edgeStack.back();
+		edgeStack.pop_back();
+
+		if(visitOrder[tonode] == UNVISITED)
+		{
+		    visit(tonode);
+		}
+		else if(onComponentStack[tonode])
+		{
+		    lowLink[node] = std::min(lowLink[node], visitOrder[tonode]);
+		}
+
+		continue;
+	    }
+
+	    // all edges of the node have been followed
+	    searchStack.pop_back();
+
+	    if(!searchStack.empty())
+	    {
+		MatrixIndex parent = searchStack.back().first;
+		lowLink[parent] = std::min(lowLink[parent], lowLink[node]);
+	    }
+
+	    if(lowLink[node] == visitOrder[node])
+	    {
+		// the node is the root of a component, which is everything
+		// above it on the component stack
+		ComponentIndex component = m_componentSizes.size();
+		MatrixIndex member;
+		MatrixIndex size = 0;
+
+		do
+		{
+		    member = componentStack.back();
+		    componentStack.pop_back();
+		    onComponentStack[member] = false;
+		    m_components[member] = component;
+		    ++size;
+		}
+		while(member != node);
+
+		m_componentSizes.push_back(size);
+	    }
+	}
+    }
+
+    // a component is closed if none of its nodes link outside it
+    ComponentIndex componentCount = m_componentSizes.size();
+
+    m_isClosed.assign(componentCount, true);
+    m_hasInternalEdge.assign(componentCount, false);
+
+    for(MatrixIndex fromnode = 0 ; fromnode < numberOfNodes ; ++fromnode)
+    {
+	ComponentIndex component = m_components[fromnode];
+
+	graph.forEachOutNeighbour(fromnode, [&](MatrixIndex tonode)
+	{
+	    if(m_components[tonode] == component)
+	    {
+		m_hasInternalEdge[component] = true;
+	    }
+	    else
+	    {
+		m_isClosed[component] = false;
+	    }
+	});
+    }
+}
+
+// returns how many components were found
+ComponentFinder::ComponentIndex ComponentFinder::getComponentCount() const
+{
+    return m_componentSizes.size();
+}
+
+// returns the component a node belongs to
+ComponentFinder::ComponentIndex ComponentFinder::getComponent(MatrixIndex node) const
+{
+    return m_components[node];
+}
+
+// returns how many nodes are in a component
+MatrixIndex ComponentFinder::getComponentSize(ComponentIndex component) const
+{
+    return m_componentSizes[component];
+}
+
+// returns true if no edge leaves the component
+bool ComponentFinder::isClosed(ComponentIndex component) const
+{
+    return m_isClosed[component];
+}
+
+// returns true if at least one edge joins two nodes of the component
+bool ComponentFinder::hasInternalEdge(ComponentIndex component) const
+{
+    return m_hasInternalEdge[component];
+}
+
+// Returns true if the component is a rank sink: closed and with at least one
+// edge. A single node without edges is isolated or a rank leak, not a sink.
+bool ComponentFinder::isSink(ComponentIndex component) const
+{
+    return m_isClosed[component] && m_hasInternalEdge[component];
+}
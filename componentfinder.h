@@ -0,0 +1,52 @@
+/****************************************************************
+Finds the strongly connected components of a directed graph with
+an iterative version of Tarjan's algorithm, so the depth of the
+search is not limited by the call stack. Each component is then
+marked as closed if no edge leaves it. Closed components with at
+least one edge are the rank sinks of the graph.
+****************************************************************/
+
+#ifndef COMPONENTFINDER_H
+#define COMPONENTFINDER_H
+
+#include "directedgraph.h"
+
+#include <vector>
+
+class ComponentFinder
+{
+    public:
+	typedef MatrixIndex ComponentIndex;
+
+	ComponentFinder(){};
+	virtual ~ComponentFinder(){};
+
+	// find the strongly connected components of a graph
+	void findComponents(const DirectedGraph& graph);
+
+	// returns how many components were found
+	ComponentIndex getComponentCount() const;
+	// returns the component a node belongs to
+	ComponentIndex getComponent(MatrixIndex node) const;
+	// returns how many nodes are in a component
+	MatrixIndex getComponentSize(ComponentIndex component) const;
+	// returns true if no edge leaves the component
+	bool isClosed(ComponentIndex component) const;
+	// returns true if at least one edge joins two nodes of the component
+	bool hasInternalEdge(ComponentIndex component) const;
+	// returns true if the component is closed and has an edge, so it is a rank sink
+	bool isSink(ComponentIndex component) const;
+
+    private:
+	// component of each node, components are numbered in the order they
+	// are completed, which is a reverse topological order of the components
+	std::vector<ComponentIndex> m_components;
+	// number of nodes in each component
+	std::vector<MatrixIndex> m_componentSizes;
+	// whether each component has no edges leaving it
+	std::vector<bool> m_isClosed;
+	// whether each component has an edge between two of its nodes
+	std::vector<bool> m_hasInternalEdge;
+};
+
+#endif
@@ -0,0 +1,264 @@
+/****************************************************************
+Compressed storage for the edges of a large, sparse directed graph,
+in the style of WebGraph. Each sorted neighbour list is stored as
+gaps between neighbours, so nodes linking to nearby nodes take a
+byte or so per edge instead of four. The first neighbour is stored
+as its zigzag encoded distance from the node itself and each later
+one as one less than its gap from the one before, all as LEB128
+varints of seven bits a byte. Rows are decoded as they are walked,
+trading a little arithmetic for far less memory traffic. Rows and
+columns are stored the same way. Removing edges re-encodes a row
+in place, which never makes it longer, leaving slack at its end.
+Inserting an edge re-encodes the row in place when the slack can
+take it, and otherwise every row is laid out again with room to
+spare.
+****************************************************************/
+
+#include "compressedadjacency.h"
+
+#include <cstring>
+
+// encode the sparse rows and columns of a graph
+CompressedAdjacency::CompressedAdjacency(MatrixIndex nodecount,
+					 const EdgeIndex* outOffsets, const MatrixIndex* outDegrees, const MatrixIndex* outNeighbours,
+					 const EdgeIndex* inOffsets, const MatrixIndex* inDegrees, const MatrixIndex* inNeighbours)
+{
+    encodeRows(nodecount, outOffsets, outDegrees, outNeighbours, m_outOffsets, m_outBytes);
+    encodeRows(nodecount, inOffsets, inDegrees, inNeighbours, m_inOffsets, m_inBytes);
+}
+
+// Encode one direction's lists back to back. The bytes are sized for the
+// worst case first, five bytes a neighbour, then trimmed to what was used.
+void CompressedAdjacency::encodeRows(MatrixIndex nodecount, const EdgeIndex* offsets, const MatrixIndex* degrees,
+				     const MatrixIndex* neighbours, Offsets& rowOffsets, Bytes& bytes)
+{
+    EdgeIndex edgecount = 0;
+
+    for(MatrixIndex node = 0 ; node < nodecount ; ++node)
+    {
+	edgecount += degrees[node];
+    }
+
+    rowOffsets.resize((uint64_t)nodecount + 1);
+    bytes.resize(edgecount * 5);
+
+    Byte* start = bytes.data();
+    Byte* position = start;
+
+    for(MatrixIndex node = 0 ; node < nodecount ; ++node)
+    {
+	const MatrixIndex* row = neighbours + offsets[node];
+
+	rowOffsets[node] = position - start;
+
+	for(MatrixIndex k = 0 ; k < degrees[node] ; ++k)
+	{
+	    position = writeVarint(position, k ? row[k] - row[k - 1] - 1 : encodeFirst(node, row[0]));
+	}
+    }
+
+    rowOffsets[nodecount] = position - start;
+    bytes.resize(position - start);
+    bytes.shrink_to_fit();
+}
+
+// returns true if there is an edge from i to j, given the out-degree of i
+bool CompressedAdjacency::isEdge(MatrixIndex i, MatrixIndex j, MatrixIndex degree) const
+{
+    const Byte* row = m_outBytes.data() + m_outOffsets[i];
+
+    if(!degree)
+    {
+	return false;
+    }
+
+    MatrixIndex neighbour = decodeFirst(i, readVarint(row));
+
+    for(MatrixIndex k = 1 ; k < degree && neighbour < j ; ++k)
+    {
+	neighbour += (MatrixIndex)readVarint(row) + 1;
+    }
+
+    return neighbour == j;
+}
+
+// Drop the neighbours removed(neighbour) is true for from a row and re-encode
+// the rest in place. A kept neighbour's encoding is never longer than the
+// encodings it replaces, its own and those of the neighbours dropped before
+// it, so writing never overtakes reading. Returns the number of neighbours left.
+template<typename Removed>
+MatrixIndex CompressedAdjacency::filterRow(Byte* row, MatrixIndex node, MatrixIndex degree, Removed removed)
+{
+    const Byte* read = row;
+    Byte* write = row;
+    MatrixIndex kept = 0;
+    MatrixIndex neighbour = 0;
+    MatrixIndex previous = 0;
+
+    for(MatrixIndex k = 0 ; k < degree ; ++k)
+    {
+	uint64_t value = readVarint(read);
+	neighbour = k ? neighbour + (MatrixIndex)value + 1 : decodeFirst(node, value);
+
+	if(removed(neighbour))
+	{
+	    continue;
+	}
+
+	write = writeVarint(write, kept ? neighbour - previous - 1 : encodeFirst(node, neighbour));
+	previous = neighbour;
+	++kept;
+    }
+
+    return kept;
+}
+
+// remove a neighbour from a node's row, returns false if it was not there
+bool CompressedAdjacency::eraseOutNeighbour(MatrixIndex node, MatrixIndex& degree, MatrixIndex neighbour)
+{
+    MatrixIndex kept = filterRow(m_outBytes.data() + m_outOffsets[node], node, degree, [neighbour](MatrixIndex n)
+    {
+	return n == neighbour;
+    });
+
+    bool erased = kept != degree;
+    degree = kept;
+
+    return erased;
+}
+
+// remove a neighbour from a node's column, returns false if it was not there
+bool CompressedAdjacency::eraseInNeighbour(MatrixIndex node, MatrixIndex& degree, MatrixIndex neighbour)
+{
+    MatrixIndex kept = filterRow(m_inBytes.data() + m_inOffsets[node], node, degree, [neighbour](MatrixIndex n)
+    {
+	return n == neighbour;
+    });
+
+    bool erased = kept != degree;
+    degree = kept;
+
+    return erased;
+}
+
+// drop every neighbour flagged true from a node's row, updating its degree
+void CompressedAdjacency::filterOutNeighbours(MatrixIndex node, MatrixIndex& degree, const bool* removed)
+{
+    degree = filterRow(m_outBytes.data() + m_outOffsets[node], node, degree, [removed](MatrixIndex n)
+    {
+	return removed[n];
+    });
+}
+
+// drop every neighbour flagged true from a node's column, updating its degree
+void CompressedAdjacency::filterInNeighbours(MatrixIndex node, MatrixIndex& degree, const bool* removed)
+{
+    degree = filterRow(m_inBytes.data() + m_inOffsets[node], node, degree, [removed](MatrixIndex n)
+    {
+	return removed[n];
+    });
+}
+
+// Add a neighbour to a node's row, which must not hold it already. The row
+// is re-encoded into scratch space first, as the new neighbour lengthens
+// the encoding of the row after it, and copied back if it fits in the
+// bytes up to the next row.
+bool CompressedAdjacency::insertIntoRow(Bytes& bytes, const Offsets& rowOffsets, MatrixIndex node, MatrixIndex& degree, MatrixIndex neighbour)
+{
+    Byte* row = bytes.data() + rowOffsets[node];
+    uint64_t room = rowOffsets[node + 1] - rowOffsets[node];
+
+    // each neighbour takes at most five bytes
+    m_scratch.resize(((uint64_t)degree + 1) * 5);
+
+    Byte* write = m_scratch.data();
+    MatrixIndex previous = 0;
+    bool inserted = false;
+    MatrixIndex written = 0;
+
+    // write the next neighbour of the new row
+    auto append = [&](MatrixIndex next)
+    {
+	write = writeVarint(write, written ? next - previous - 1 : encodeFirst(node, next));
+	previous = next;
+	++written;
+    };
+
+    decodeRow(row, node, degree, [&](MatrixIndex next)
+    {
+	if(!inserted && neighbour < next)
+	{
+	    append(neighbour);
+	    inserted = true;
+	}
+
+	append(next);
+    });
+
+    if(!inserted)
+    {
+	append(neighbour);
+    }
+
+    uint64_t length = write - m_scratch.data();
+
+    if(length > room)
+    {
+	return false;
+    }
+
+    memcpy(row, m_scratch.data(), length);
+    ++degree;
+
+    return true;
+}
+
+// add a neighbour to a node's row, returns false if the row has no room for it
+bool CompressedAdjacency::insertOutNeighbour(MatrixIndex node, MatrixIndex& degree, MatrixIndex neighbour)
+{
+    return insertIntoRow(m_outBytes, m_outOffsets, node, degree, neighbour);
+}
+
+// add a neighbour to a node's column, returns false if the column has no room for it
+bool CompressedAdjacency::insertInNeighbour(MatrixIndex node, MatrixIndex& degree, MatrixIndex neighbour)
+{
+    return insertIntoRow(m_inBytes, m_inOffsets, node, degree, neighbour);
+}
+
+// Copy one direction's rows to new bytes, each row keeping the bytes it had
+// and gaining COMPRESSED_SLACK_MINIMUM more plus a share of its length, so
+// no row needs decoding and rows that fill up get proportionally more room.
+void CompressedAdjacency::spreadRows(Offsets& rowOffsets, Bytes& bytes)
+{
+    uint64_t nodecount = rowOffsets.size() - 1;
+    Offsets spreadOffsets(nodecount + 1, 0);
+
+    for(uint64_t node = 0 ; node < nodecount ; ++node)
+    {
+	uint64_t length = rowOffsets[node + 1] - rowOffsets[node];
+	spreadOffsets[node + 1] = spreadOffsets[node] + length + length / COMPRESSED_SLACK_DIVISOR + COMPRESSED_SLACK_MINIMUM;
+    }
+
+    Bytes spreadBytes(spreadOffsets[nodecount]);
+
+    for(uint64_t node = 0 ; node < nodecount ; ++node)
+    {
+	memcpy(spreadBytes.data() + spreadOffsets[node], bytes.data() + rowOffsets[node], rowOffsets[node + 1] - rowOffsets[node]);
+    }
+
+    rowOffsets.swap(spreadOffsets);
+    bytes.swap(spreadBytes);
+}
+
+// lay out every row and column again with room for more neighbours
+void CompressedAdjacency::makeRoom()
+{
+    spreadRows(m_outOffsets, m_outBytes);
+    spreadRows(m_inOffsets, m_inBytes);
+}
+
+// returns the number of bytes the rows and columns take, including their offsets
+uint64_t CompressedAdjacency::getStorageSize() const
+{
+    return (m_outOffsets.size() + m_inOffsets.size()) * sizeof(EdgeIndex) + m_outBytes.size() + m_inBytes.size();
+}
@@ -0,0 +1,169 @@
+/****************************************************************
+Compressed storage for the edges of a large, sparse directed graph,
+in the style of WebGraph. Each sorted neighbour list is stored as
+gaps between neighbours, so nodes linking to nearby nodes take a
+byte or so per edge instead of four. The first neighbour is stored
+as its zigzag encoded distance from the node itself and each later
+one as one less than its gap from the one before, all as LEB128
+varints of seven bits a byte. Rows are decoded as they are walked,
+trading a little arithmetic for far less memory traffic. Rows and
+columns are stored the same way. Removing edges re-encodes a row
+in place, which never makes it longer, leaving slack at its end.
+Inserting an edge re-encodes the row in place when the slack can
+take it, and otherwise every row is laid out again with room to
+spare.
+****************************************************************/
+
+#ifndef COMPRESSEDADJACENCY_H
+#define COMPRESSEDADJACENCY_H
+
+#include "graphtypes.h"
+
+#include <stdint.h>
+#include <vector>
+
+// Bytes left free after each row and column when they are laid out again
+// to make room for inserted edges, at least enough for one insertion
+#define COMPRESSED_SLACK_MINIMUM 16
+// and a further share of each row's bytes, one part in this many
+#define COMPRESSED_SLACK_DIVISOR 4
+
+class CompressedAdjacency
+{
+    public:
+	typedef uint8_t Byte;
+
+	// Encode the sparse rows and columns of a graph. The neighbours of node i
+	// in each direction are neighbours[offsets[i]] .. [offsets[i] + degrees[i]].
+	CompressedAdjacency(MatrixIndex nodecount,
+			    const EdgeIndex* outOffsets, const MatrixIndex* outDegrees, const MatrixIndex* outNeighbours,
+			    const EdgeIndex* inOffsets, const MatrixIndex* inDegrees, const MatrixIndex* inNeighbours);
+	virtual ~CompressedAdjacency(){};
+
+	// returns true if there is an edge from i to j, given the out-degree of i
+	bool isEdge(MatrixIndex i, MatrixIndex j, MatrixIndex degree) const;
+	// remove a neighbour from a node's row or column, updating its degree,
+	// returns false if the neighbour was not there
+	bool eraseOutNeighbour(MatrixIndex node, MatrixIndex& degree, MatrixIndex neighbour);
+	bool eraseInNeighbour(MatrixIndex node, MatrixIndex& degree, MatrixIndex neighbour);
+	// drop every neighbour flagged true from a node's row or column, updating its degree
+	void filterOutNeighbours(MatrixIndex node, MatrixIndex& degree, const bool* removed);
+	void filterInNeighbours(MatrixIndex node, MatrixIndex& degree, const bool* removed);
+	// add a neighbour not yet there to a node's row or column, updating its degree,
+	// returns false, changing nothing, if the row has no room for it
+	bool insertOutNeighbour(MatrixIndex node, MatrixIndex& degree, MatrixIndex neighbour);
+	bool insertInNeighbour(MatrixIndex node, MatrixIndex& degree, MatrixIndex neighbour);
+	// lay out every row and column again with room for more neighbours at the end of each
+	void makeRoom();
+
+	// call visitor(tonode) for each of the degree nodes the given node links to, in increasing order
+	template<typename Visitor>
+	void forEachOutNeighbour(MatrixIndex node, MatrixIndex degree, Visitor visitor) const
+	{
+	    decodeRow(m_outBytes.data() + m_outOffsets[node], node, degree, visitor);
+	}
+	// call visitor(fromnode) for each of the degree nodes linking to the given node, in increasing order
+	template<typename Visitor>
+	void forEachInNeighbour(MatrixIndex node, MatrixIndex degree, Visitor visitor) const
+	{
+	    decodeRow(m_inBytes.data() + m_inOffsets[node], node, degree, visitor);
+	}
+
+	// returns the number of bytes the rows and columns take, including their offsets
+	uint64_t getStorageSize() const;
+
+    private:
+	CompressedAdjacency(const CompressedAdjacency&);
+	CompressedAdjacency& operator=(const CompressedAdjacency&);
+
+	typedef std::vector<EdgeIndex> Offsets;
+	typedef std::vector<Byte> Bytes;
+
+	// encode one direction's lists back to back
+	static void encodeRows(MatrixIndex nodecount, const EdgeIndex* offsets, const MatrixIndex* degrees, const MatrixIndex* neighbours,
+			       Offsets& rowOffsets, Bytes& bytes);
+	// Drop the neighbours removed(neighbour) is true for from a row, re-encoding
+	// the rest in place. Returns the number of neighbours left.
+	template<typename Removed>
+	static MatrixIndex filterRow(Byte* row, MatrixIndex node, MatrixIndex degree, Removed removed);
+	// Add a neighbour to the row of the given node, re-encoding it in place.
+	// Returns false if the re-encoded row does not fit in the row's bytes.
+	bool insertIntoRow(Bytes& bytes, const Offsets& rowOffsets, MatrixIndex node, MatrixIndex& degree, MatrixIndex neighbour);
+	// copy one direction's rows, slack and all, adding room at the end of each
+	static void spreadRows(Offsets& rowOffsets, Bytes& bytes);
+
+	// append a value as a varint, returns the position after it
+	static Byte* writeVarint(Byte* position, uint64_t value)
+	{
+	    while(value >= 0x80)
+	    {
+		*position++ = (Byte)(value | 0x80);
+		value >>= 7;
+	    }
+
+	    *position++ = (Byte)value;
+	    return position;
+	}
+	// read a varint and move position past it
+	static uint64_t readVarint(const Byte*& position)
+	{
+	    uint64_t value = *position++;
+
+	    if(value < 0x80)
+	    {
+		return value;
+	    }
+
+	    value &= 0x7F;
+
+	    for(unsigned shift = 7 ; ; shift += 7)
+	    {
+		uint64_t byte = *position++;
+		value |= (byte & 0x7F) << shift;
+
+		if(byte < 0x80)
+		{
+		    return value;
+		}
+	    }
+	}
+	// zigzag encode the signed distance of a node's first neighbour from the node
+	static uint64_t encodeFirst(MatrixIndex node, MatrixIndex neighbour)
+	{
+	    int64_t distance = (int64_t)neighbour - node;
+	    return ((uint64_t)distance << 1) ^ (uint64_t)(distance >> 63);
+	}
+	static MatrixIndex decodeFirst(MatrixIndex node, uint64_t value)
+	{
+	    return (MatrixIndex)(node + (int64_t)((value >> 1) ^ (0 - (value & 1))));
+	}
+
+	// call visitor with each of the degree neighbours encoded at row
+	template<typename Visitor>
+	static void decodeRow(const Byte* row, MatrixIndex node, MatrixIndex degree, Visitor visitor)
+	{
+	    if(!degree)
+	    {
+		return;
+	    }
+
+	    MatrixIndex neighbour = decodeFirst(node, readVarint(row));
+	    visitor(neighbour);
+
+	    for(MatrixIndex k = 1 ; k < degree ; ++k)
+	    {
+		neighbour += (MatrixIndex)readVarint(row) + 1;
+		visitor(neighbour);
+	    }
+	}
+
+	// the rows of node i start at m_outBytes[m_outOffsets[i]], and the columns likewise
+	Offsets m_outOffsets;
+	Bytes m_outBytes;
+	Offsets m_inOffsets;
+	Bytes m_inBytes;
+	// a row re-encoded by an insertion before it is copied back
+	Bytes m_scratch;
+};
+
+#endif
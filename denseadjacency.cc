@@ -0,0 +1,173 @@
+/****************************************************************
+Bit matrix storage for the edges of a small, dense directed graph.
+Each node has a row of 64-bit words with a bit set for every node
+it links to, and a second row in the transposed matrix with a bit
+set for every node linking to it, so both directions can be walked
+without scanning columns. Both matrices share one cache line
+aligned allocation and every row starts on a cache line. Degrees
+are counted with popcount and removing a vertex clears words.
+****************************************************************/
+
+#include "denseadjacency.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+// construct a matrix for the given number of nodes with no edges
+DenseAdjacency::DenseAdjacency(MatrixIndex nodecount):m_words(NULL),m_nodecount(nodecount),m_rowWordCount(getRowWordCount(nodecount))
+{
+    uint64_t size = getStorageSize(nodecount);
+
+    if(size)
+    {
+	m_words = static_cast<Word*>(aligned_alloc(DENSE_ROW_WORD_ALIGNMENT*sizeof(Word), size));
+
+	if(!m_words)
+	{
+	    throw std::bad_alloc();
+	}
+
+	memset(m_words, 0, size);
+    }
+}
+
+DenseAdjacency::~DenseAdjacency()
+{
+    free(m_words);
+}
+
+// returns number of words in each row, including padding
+uint64_t DenseAdjacency::getRowWordCount(MatrixIndex nodecount)
+{
+    uint64_t words = ((uint64_t)nodecount + 63) / 64;
+
+    return (words + DENSE_ROW_WORD_ALIGNMENT - 1) / DENSE_ROW_WORD_ALIGNMENT * DENSE_ROW_WORD_ALIGNMENT;
+}
+
+// Returns the number of bytes the out and in matrices take for a graph
+// of the given size, which is a multiple of the row alignment
+uint64_t DenseAdjacency::getStorageSize(MatrixIndex nodecount)
+{
+    return 2 * (uint64_t)nodecount * getRowWordCount(nodecount) * sizeof(Word);
+}
+
+// add an edge, returns false if it was already there
+bool DenseAdjacency::setEdge(MatrixIndex i, MatrixIndex j)
+{
+    Word& outWord = getOutRow(i)[j / 64];
+    Word outBit = (Word)1 << (j % 64);
+
+    if(outWord & outBit)
+    {
+	return false;
+    }
+
+    outWord |= outBit;
+    getInRow(j)[i / 64] |= (Word)1 << (i % 64);
+
+    return true;
+}
+
+// remove an edge, returns false if it was not there
+bool DenseAdjacency::clearEdge(MatrixIndex i, MatrixIndex j)
+{
+    Word& outWord = getOutRow(i)[j / 64];
+    Word outBit = (Word)1 << (j % 64);
+
+    if(!(outWord & outBit))
+    {
+	return false;
+    }
+
+    outWord &= ~outBit;
+    getInRow(j)[i / 64] &= ~((Word)1 << (i % 64));
+
+    return true;
+}
+
+// Remove every edge to and from a vertex. The vertex's bit is cleared in
+// the rows of its neighbours, then both of its own rows are zeroed.
+void DenseAdjacency::clearVertex(MatrixIndex vertex)
+{
+    Word vertexMask = ~((Word)1 << (vertex % 64));
+    uint64_t vertexWord = vertex / 64;
+
+    forEachOutNeighbour(vertex, [&](MatrixIndex tonode)
+    {
+	getInRow(tonode)[vertexWord] &= vertexMask;
+    });
+
+    forEachInNeighbour(vertex, [&](MatrixIndex fromnode)
+    {
+	getOutRow(fromnode)[vertexWord] &= vertexMask;
+    });
+
+    memset(getOutRow(vertex), 0, m_rowWordCount*sizeof(Word));
+    memset(getInRow(vertex), 0, m_rowWordCount*sizeof(Word));
+}
+
+// Remove every edge to and from each vertex flagged true. The rows of
+// removed vertices are zeroed and every other row is masked with the set
+// of kept vertices, a word at a time.
+void DenseAdjacency::clearVertices(const bool* vertices)
+{
+    std::vector<Word> keep(m_rowWordCount, 0);
+
+    for(MatrixIndex node = 0 ; node < m_nodecount ; ++node)
+    {
+	if(!vertices[node])
+	{
+	    keep[node / 64] |= (Word)1 << (node % 64);
+	}
+    }
+
+    const Word* keepWords = keep.data();
+
+    for(uint64_t row = 0 ; row < 2 * (uint64_t)m_nodecount ; ++row)
+    {
+	Word* words = m_words + row*m_rowWordCount;
+
+	if(vertices[row < m_nodecount ? row : row - m_nodecount])
+	{
+	    memset(words, 0, m_rowWordCount*sizeof(Word));
+	    continue;
+	}
+
+	for(uint64_t word = 0 ; word < m_rowWordCount ; ++word)
+	{
+	    words[word] &= keepWords[word];
+	}
+    }
+}
+
+// count the set bits of each row of a matrix
+void DenseAdjacency::countRows(const Word* matrix, MatrixIndex* degrees) const
+{
+    for(MatrixIndex node = 0 ; node < m_nodecount ; ++node)
+    {
+	const Word* row = matrix + node*m_rowWordCount;
+	MatrixIndex degree = 0;
+
+	for(uint64_t word = 0 ; word < m_rowWordCount ; ++word)
+	{
+	    degree += __builtin_popcountll(row[word]);
+	}
+
+	degrees[node] = degree;
+    }
+}
+
+// count the out-degree of every node into degrees
+void DenseAdjacency::countOutDegrees(MatrixIndex* degrees) const
+{
+    countRows(getOutRow(0), degrees);
+}
+
+// Count the in-degree of every node into degrees. The transposed matrix
+// is kept for walking in-neighbours anyway, so in-degrees are counted from
+// its rows in the same way as out-degrees rather than by summing columns.
+void DenseAdjacency::countInDegrees(MatrixIndex* degrees) const
+{
+    countRows(getInRow(0), degrees);
+}
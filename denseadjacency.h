@@ -0,0 +1,113 @@
+/****************************************************************
+Bit matrix storage for the edges of a small, dense directed graph.
+Each node has a row of 64-bit words with a bit set for every node
+it links to, and a second row in the transposed matrix with a bit
+set for every node linking to it, so both directions can be walked
+without scanning columns. Both matrices share one cache line
+aligned allocation and every row starts on a cache line. Degrees
+are counted with popcount and removing a vertex clears words.
+****************************************************************/
+
+#ifndef DENSEADJACENCY_H
+#define DENSEADJACENCY_H
+
+#include "graphtypes.h"
+
+#include <stdint.h>
+#include <vector>
+
+// Rows are padded to a multiple of this many 64-bit words
+// (one cache line) so each row starts on a cache line
+#define DENSE_ROW_WORD_ALIGNMENT 8
+
+class DenseAdjacency
+{
+    public:
+	typedef uint64_t Word;
+
+	// construct a matrix for the given number of nodes with no edges
+	DenseAdjacency(MatrixIndex nodecount);
+	virtual ~DenseAdjacency();
+
+	// returns true if there is an edge from i to j
+	bool isEdge(MatrixIndex i, MatrixIndex j) const
+	{
+	    return (getOutRow(i)[j / 64] >> (j % 64)) & 1;
+	}
+	// add an edge, returns false if it was already there
+	bool setEdge(MatrixIndex i, MatrixIndex j);
+	// remove an edge, returns false if it was not there
+	bool clearEdge(MatrixIndex i, MatrixIndex j);
+	// remove every edge to and from a vertex
+	void clearVertex(MatrixIndex vertex);
+	// remove every edge to and from each vertex flagged true
+	void clearVertices(const bool* vertices);
+
+	// count the out-degree of every node into degrees
+	void countOutDegrees(MatrixIndex* degrees) const;
+	// count the in-degree of every node into degrees
+	void countInDegrees(MatrixIndex* degrees) const;
+
+	// call visitor(tonode) for each node the given node links to, in increasing order
+	template<typename Visitor>
+	void forEachOutNeighbour(MatrixIndex node, Visitor visitor) const
+	{
+	    forEachSetBit(getOutRow(node), visitor);
+	}
+	// call visitor(fromnode) for each node linking to the given node, in increasing order
+	template<typename Visitor>
+	void forEachInNeighbour(MatrixIndex node, Visitor visitor) const
+	{
+	    forEachSetBit(getInRow(node), visitor);
+	}
+
+	// returns the number of bytes the matrices take for a graph of the given size
+	static uint64_t getStorageSize(MatrixIndex nodecount);
+
+    private:
+	DenseAdjacency(const DenseAdjacency&);
+	DenseAdjacency& operator=(const DenseAdjacency&);
+
+	// returns number of words in each row, including padding
+	static uint64_t getRowWordCount(MatrixIndex nodecount);
+
+	const Word* getOutRow(MatrixIndex node) const
+	{
+	    return m_words + node*m_rowWordCount;
+	}
+	const Word* getInRow(MatrixIndex node) const
+	{
+	    return m_words + (m_nodecount + (uint64_t)node)*m_rowWordCount;
+	}
+	Word* getOutRow(MatrixIndex node)
+	{
+	    return m_words + node*m_rowWordCount;
+	}
+	Word* getInRow(MatrixIndex node)
+	{
+	    return m_words + (m_nodecount + (uint64_t)node)*m_rowWordCount;
+	}
+
+	// count the set bits of each row of a matrix
+	void countRows(const Word* matrix, MatrixIndex* degrees) const;
+
+	// call visitor(index) for each bit set in a row, lowest first
+	template<typename Visitor>
+	void forEachSetBit(const Word* row, Visitor visitor) const
+	{
+	    for(uint64_t word = 0 ; word < m_rowWordCount ; ++word)
+	    {
+		for(Word bits = row[word] ; bits ; bits &= bits - 1)
+		{
+		    visitor((MatrixIndex)(word*64 + __builtin_ctzll(bits)));
+		}
+	    }
+	}
+
+	// the out rows of every node followed by the in rows of every node
+	Word* m_words;
+	MatrixIndex m_nodecount;
+	uint64_t m_rowWordCount;
+};
+
+#endif
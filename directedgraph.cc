@@ -1,80 +1,780 @@
 /****************************************************************
-Class representing a directed graph. The graph is an adjacency
-matrix to which edges and vertices can be added. Nodes in the 
-graph also map to node objects.
+Class representing a directed graph. The graph is stored as
+compressed sparse rows (out-edges of each node) and compressed
+sparse columns (in-edges of each node) so memory and scan cost
+scale with the number of edges. Edges are queued with addEdge()
+and the sparse arrays are built by finalise(), or inserted one at
+a time with insertEdge() into slack left at the end of each row,
+which is made by laying the rows out again when it runs out. The arrays can
+also live in a memory mapped graph snapshot. Small graphs dense
+enough for it are instead stored as bit matrices, and large ones
+can be stored gap encoded to save memory. Nodes in the
+graph also map to node names held in a single string table.
 ****************************************************************/
 
 #include "directedgraph.h"
-#include <iostream>
+#include "mappedfile.h"
+#include "logger.h"
+#include <algorithm>
 
-// construct a square matrix of given size
-DirectedGraph::DirectedGraph(MatrixIndex nodecount):m_nodecount(nodecount)
+// construct an empty graph
+DirectedGraph::DirectedGraph():DirectedGraph(0){}
+
+// construct a graph of given size with no edges
+DirectedGraph::DirectedGraph(MatrixIndex nodecount):m_nodecount(nodecount),m_edgecount(0),m_namecount(0),m_uncheckedNeighbours(false),m_storage(STORAGE_AUTOMATIC)
 {
-    m_adjacencyMatrix = new bool*[nodecount];
-    
-    for(MatrixIndex i = 0 ; i < nodecount ; ++i)
-    {
-        m_adjacencyMatrix[i] = new bool[nodecount];
-	memset(m_adjacencyMatrix[i], '\0', nodecount);
-    }
+    m_outOffsetStorage.assign(nodecount + 1, 0);
+    m_outDegreeStorage.assign(nodecount, 0);
+    m_inOffsetStorage.assign(nodecount + 1, 0);
+    m_inDegreeStorage.assign(nodecount, 0);
+    useOwnedArrays();
+
+    m_nameOffsetStorage.assign(1, 0);
+    m_nameOffsets = m_nameOffsetStorage.data();
+    m_names = m_nameStorage.data();
 }
 
 DirectedGraph::~DirectedGraph()
 {
-    for(MatrixIndex i = 0 ; i < m_nodecount ; ++i)
-    {
-        delete[] m_adjacencyMatrix[i];
-    }
+}
 
-    delete[] m_adjacencyMatrix;
+// point the sparse arrays at the storage owned by the graph
+void DirectedGraph::useOwnedArrays()
+{
+    m_outOffsets = m_outOffsetStorage.data();
+    m_outDegree = m_outDegreeStorage.data();
+    m_outNeighbours = m_outNeighbourStorage.data();
+    m_inOffsets = m_inOffsetStorage.data();
+    m_inDegree = m_inDegreeStorage.data();
+    m_inNeighbours = m_inNeighbourStorage.data();
 }
 
-// returns true if there is an edge between two nodes 
+// returns true if there is an edge between two nodes
 // and false otherwise
 bool DirectedGraph::isEdge(MatrixIndex i, MatrixIndex j) const
 {
-    return m_adjacencyMatrix[i][j] ? true : false;
+    if(m_dense)
+    {
+	return m_dense->isEdge(i, j);
+    }
+
+    if(m_compressed)
+    {
+	return m_compressed->isEdge(i, j, m_outDegree[i]);
+    }
+
+    const MatrixIndex* row = m_outNeighbours + m_outOffsets[i];
+
+    return std::binary_search(row, row + m_outDegree[i], j);
 }
 
-// add edge to graph
+// queue an edge to be added to the graph, the edge is not
+// visible until finalise() is called
 void DirectedGraph::addEdge(MatrixIndex i, MatrixIndex j)
 {
-    m_adjacencyMatrix[i][j] = true;
+    m_pendingEdges.push_back(std::make_pair(i, j));
+}
+
+// Add an edge to the graph straight away rather than queueing it for
+// finalise(), keeping the edges in the storage they are in. Bit matrices
+// just set the edge's bit. Sparse and gap encoded rows take it in the slack
+// at their end, and once a row or column has none left every row and
+// column is laid out again with room to spare. Laying out copies the rows
+// without sorting them and gives each row room in proportion to its length,
+// so a run of insertions costs amortised time in the degrees of the nodes
+// it touches rather than rebuilding the graph for each. Returns false if
+// the edge was already in the graph.
+bool DirectedGraph::insertEdge(MatrixIndex i, MatrixIndex j)
+{
+    if(isEdge(i, j))
+    {
+	return false;
+    }
+
+    if(m_dense)
+    {
+	m_dense->setEdge(i, j);
+	++m_outDegree[i];
+	++m_inDegree[j];
+    }
+    else if(m_compressed)
+    {
+	if(!m_compressed->insertOutNeighbour(i, m_outDegree[i], j))
+	{
+	    m_compressed->makeRoom();
+	    m_compressed->insertOutNeighbour(i, m_outDegree[i], j);
+	}
+
+	if(!m_compressed->insertInNeighbour(j, m_inDegree[j], i))
+	{
+	    m_compressed->makeRoom();
+	    m_compressed->insertInNeighbour(j, m_inDegree[j], i);
+	}
+    }
+    else
+    {
+	// snapshot rows have no slack, so the first insertion lays them out again too
+	if(m_outOffsets[i] + m_outDegree[i] == m_outOffsets[i + 1] || m_inOffsets[j] + m_inDegree[j] == m_inOffsets[j + 1])
+	{
+	    spreadRows();
+	}
+
+	insertNeighbour(m_outNeighbours + m_outOffsets[i], m_outDegree[i], j);
+	insertNeighbour(m_inNeighbours + m_inOffsets[j], m_inDegree[j], i);
+    }
+
+    ++m_edgecount;
+
+    return true;
+}
+
+// Lay out the sparse rows and columns again in storage owned by the graph,
+// each followed by room for EDGE_SLACK_MINIMUM more edges plus a share of
+// its degree. The rows are copied as they are, already sorted.
+void DirectedGraph::spreadRows()
+{
+    // lay out one direction's lists with room after each
+    auto spread = [this](const EdgeIndex* offsets, const MatrixIndex* degrees, const MatrixIndex* neighbours,
+			 Offsets& spreadOffsets, Neighbours& spreadNeighbours)
+    {
+	spreadOffsets.assign(m_nodecount + 1, 0);
+
+	for(MatrixIndex i = 0 ; i < m_nodecount ; ++i)
+	{
+	    spreadOffsets[i + 1] = spreadOffsets[i] + degrees[i] + degrees[i] / EDGE_SLACK_DIVISOR + EDGE_SLACK_MINIMUM;
+	}
+
+	spreadNeighbours.assign(spreadOffsets[m_nodecount], 0);
+
+	for(MatrixIndex i = 0 ; i < m_nodecount ; ++i)
+	{
+	    std::copy(neighbours + offsets[i], neighbours + offsets[i] + degrees[i], spreadNeighbours.begin() + spreadOffsets[i]);
+	}
+    };
+
+    Offsets outOffsets;
+    Neighbours outNeighbours;
+    Offsets inOffsets;
+    Neighbours inNeighbours;
+
+    spread(m_outOffsets, m_outDegree, m_outNeighbours, outOffsets, outNeighbours);
+    spread(m_inOffsets, m_inDegree, m_inNeighbours, inOffsets, inNeighbours);
+
+    // the degrees may still be in a snapshot
+    if(m_outDegree != m_outDegreeStorage.data())
+    {
+	m_outDegreeStorage.assign(m_outDegree, m_outDegree + m_nodecount);
+	m_inDegreeStorage.assign(m_inDegree, m_inDegree + m_nodecount);
+    }
+
+    m_outOffsetStorage.swap(outOffsets);
+    m_outNeighbourStorage.swap(outNeighbours);
+    m_inOffsetStorage.swap(inOffsets);
+    m_inNeighbourStorage.swap(inNeighbours);
+    useOwnedArrays();
 }
 
 // remove edge from graph
 void DirectedGraph::removeEdge(MatrixIndex i, MatrixIndex j)
 {
-    m_adjacencyMatrix[i][j] = false;
-}
+    if(m_dense)
+    {
+	if(m_dense->clearEdge(i, j))
+	{
+	    --m_outDegree[i];
+	    --m_inDegree[j];
+	    --m_edgecount;
+	}
+
+	return;
+    }
+
+    if(m_compressed)
+    {
+	if(m_compressed->eraseOutNeighbour(i, m_outDegree[i], j))
+	{
+	    m_compressed->eraseInNeighbour(j, m_inDegree[j], i);
+	    --m_edgecount;
+	}
 
+	return;
+    }
+
+    if(eraseNeighbour(m_outNeighbours + m_outOffsets[i], m_outDegree[i], j))
+    {
+	eraseNeighbour(m_inNeighbours + m_inOffsets[j], m_inDegree[j], i);
+	--m_edgecount;
+    }
+}
 
 // remove vertex from graph
 void DirectedGraph::removeVertex(MatrixIndex vertex)
 {
+    EdgeIndex removed = m_outDegree[vertex] + m_inDegree[vertex];
+
+    if(isEdge(vertex, vertex))
+    {
+	// a link to self appears in both lists but is a single edge
+	--removed;
+    }
+
+    if(m_dense)
+    {
+	forEachOutNeighbour(vertex, [this](MatrixIndex tonode)
+	{
+	    --m_inDegree[tonode];
+	});
+
+	forEachInNeighbour(vertex, [this](MatrixIndex fromnode)
+	{
+	    --m_outDegree[fromnode];
+	});
+
+	m_dense->clearVertex(vertex);
+	m_outDegree[vertex] = 0;
+	m_inDegree[vertex] = 0;
+	m_edgecount -= removed;
+	return;
+    }
+
+    if(m_compressed)
+    {
+	forEachOutNeighbour(vertex, [this, vertex](MatrixIndex tonode)
+	{
+	    m_compressed->eraseInNeighbour(tonode, m_inDegree[tonode], vertex);
+	});
+
+	forEachInNeighbour(vertex, [this, vertex](MatrixIndex fromnode)
+	{
+	    m_compressed->eraseOutNeighbour(fromnode, m_outDegree[fromnode], vertex);
+	});
+
+	m_outDegree[vertex] = 0;
+	m_inDegree[vertex] = 0;
+	m_edgecount -= removed;
+	return;
+    }
+
+    // drop the vertex from the in-lists of the nodes it links to
+    const MatrixIndex* outRow = m_outNeighbours + m_outOffsets[vertex];
+    for(MatrixIndex k = 0 ; k < m_outDegree[vertex] ; ++k)
+    {
+	MatrixIndex tonode = outRow[k];
+	eraseNeighbour(m_inNeighbours + m_inOffsets[tonode], m_inDegree[tonode], vertex);
+    }
+
+    // drop the vertex from the out-lists of the nodes linking to it
+    const MatrixIndex* inRow = m_inNeighbours + m_inOffsets[vertex];
+    for(MatrixIndex k = 0 ; k < m_inDegree[vertex] ; ++k)
+    {
+	MatrixIndex fromnode = inRow[k];
+	eraseNeighbour(m_outNeighbours + m_outOffsets[fromnode], m_outDegree[fromnode], vertex);
+    }
+
+    m_outDegree[vertex] = 0;
+    m_inDegree[vertex] = 0;
+    m_edgecount -= removed;
+}
+
+// Remove every vertex flagged true along with all its edges. Rather than
+// removing the vertices one at a time each row and column is filtered once,
+// so the cost is linear in the size of the graph however many are removed.
+void DirectedGraph::removeVertices(const bool* vertices)
+{
+    if(m_dense)
+    {
+	m_dense->clearVertices(vertices);
+	m_dense->countOutDegrees(m_outDegree);
+	m_dense->countInDegrees(m_inDegree);
+	m_edgecount = 0;
+
+	for(MatrixIndex i = 0 ; i < m_nodecount ; ++i)
+	{
+	    m_edgecount += m_outDegree[i];
+	}
+
+	return;
+    }
+
+    if(m_compressed)
+    {
+	m_edgecount = 0;
+
+	for(MatrixIndex i = 0 ; i < m_nodecount ; ++i)
+	{
+	    if(vertices[i])
+	    {
+		m_outDegree[i] = 0;
+		m_inDegree[i] = 0;
+		continue;
+	    }
+
+	    m_compressed->filterOutNeighbours(i, m_outDegree[i], vertices);
+	    m_compressed->filterInNeighbours(i, m_inDegree[i], vertices);
+	    m_edgecount += m_outDegree[i];
+	}
+
+	return;
+    }
+
+    // drop the removed vertices from a row, keeping the rest in order
+    auto filterRow = [vertices](MatrixIndex* row, MatrixIndex& degree)
+    {
+	MatrixIndex kept = 0;
+
+	for(MatrixIndex k = 0 ; k < degree ; ++k)
+	{
+	    if(!vertices[row[k]])
+	    {
+		row[kept++] = row[k];
+	    }
+	}
+
+	degree = kept;
+    };
+
+    m_edgecount = 0;
+
     for(MatrixIndex i = 0 ; i < m_nodecount ; ++i)
     {
-        m_adjacencyMatrix[vertex][i] = false;
-	m_adjacencyMatrix[i][vertex] = false;
+	if(vertices[i])
+	{
+	    m_outDegree[i] = 0;
+	    m_inDegree[i] = 0;
+	    continue;
+	}
+
+	filterRow(m_outNeighbours + m_outOffsets[i], m_outDegree[i]);
+	filterRow(m_inNeighbours + m_inOffsets[i], m_inDegree[i]);
+	m_edgecount += m_outDegree[i];
     }
 }
 
-// show the adjacency matrix
-void DirectedGraph::dumpGraph()
+// Merge the queued edges with the edges already in the graph and rebuild the
+// sparse row and column arrays. Rows are sorted and duplicate edges dropped.
+// The rebuilt arrays are always owned by the graph, even if the old ones were
+// in a snapshot. The graph is then moved into bit matrices or gap encoded
+// if the storage chosen with setStorage() calls for it. Returns the number
+// of duplicate edges dropped.
+EdgeIndex DirectedGraph::finalise()
 {
-    std::cout << "Adjacency matrix: " << std::endl;
+    useSparseStorage();
+
+    // count the outbound links of every node, live edges plus queued ones
+    Offsets offsets(m_nodecount + 1, 0);
+    Degrees degrees(m_nodecount);
+
+    for(MatrixIndex i = 0 ; i < m_nodecount ; ++i)
+    {
+	offsets[i + 1] = m_outDegree[i];
+    }
+
+    for(Edges::const_iterator iter = m_pendingEdges.begin() ; iter != m_pendingEdges.end() ; ++iter)
+    {
+	++offsets[iter->first + 1];
+    }
 
     for(MatrixIndex i = 0 ; i < m_nodecount ; ++i)
     {
-        for(MatrixIndex j = 0 ; j < m_nodecount ; ++j)
+	offsets[i + 1] += offsets[i];
+    }
+
+    // scatter the edges into their rows
+    Neighbours neighbours(offsets[m_nodecount]);
+    Offsets cursor(offsets.begin(), offsets.end() - 1);
+
+    for(MatrixIndex i = 0 ; i < m_nodecount ; ++i)
+    {
+	const MatrixIndex* row = m_outNeighbours + m_outOffsets[i];
+	std::copy(row, row + m_outDegree[i], neighbours.begin() + cursor[i]);
+	cursor[i] += m_outDegree[i];
+    }
+
+    for(Edges::const_iterator iter = m_pendingEdges.begin() ; iter != m_pendingEdges.end() ; ++iter)
+    {
+	neighbours[cursor[iter->first]++] = iter->second;
+    }
+
+    Edges().swap(m_pendingEdges);
+
+    // sort each row, drop duplicates and close the gaps between rows
+    EdgeIndex edgecount = 0;
+
+    for(MatrixIndex i = 0 ; i < m_nodecount ; ++i)
+    {
+	Neighbours::iterator rowBegin = neighbours.begin() + offsets[i];
+	Neighbours::iterator rowEnd = neighbours.begin() + offsets[i + 1];
+
+	std::sort(rowBegin, rowEnd);
+	rowEnd = std::unique(rowBegin, rowEnd);
+
+	if(rowBegin != neighbours.begin() + edgecount)
 	{
-	    std::cout << m_adjacencyMatrix[i][j] << " ";
+	    std::copy(rowBegin, rowEnd, neighbours.begin() + edgecount);
 	}
-    
-	std::cout << std::endl;
+
+	offsets[i] = edgecount;
+	degrees[i] = rowEnd - rowBegin;
+	edgecount += degrees[i];
+    }
+
+    EdgeIndex duplicates = neighbours.size() - edgecount;
+    offsets[m_nodecount] = edgecount;
+    neighbours.resize(edgecount);
+    neighbours.shrink_to_fit();
+
+    m_outOffsetStorage.swap(offsets);
+    m_outDegreeStorage.swap(degrees);
+    m_outNeighbourStorage.swap(neighbours);
+    m_edgecount = edgecount;
+    buildColumns();
+
+    if(shouldUseDenseStorage())
+    {
+	useDenseStorage();
     }
-    
-    std::cout << std::endl;
+    else if(m_storage == STORAGE_COMPRESSED)
+    {
+	useCompressedStorage();
+    }
+
+    return duplicates;
+}
+
+// Build the compressed sparse columns from the rows owned by the graph.
+// Visiting the rows in order keeps each column sorted.
+void DirectedGraph::buildColumns()
+{
+    m_inOffsetStorage.assign(m_nodecount + 1, 0);
+    m_inDegreeStorage.assign(m_nodecount, 0);
+    m_inNeighbourStorage.assign(m_edgecount, 0);
+    useOwnedArrays();
+
+    for(EdgeIndex k = 0 ; k < m_edgecount ; ++k)
+    {
+	++m_inOffsets[m_outNeighbours[k] + 1];
+    }
+
+    for(MatrixIndex i = 0 ; i < m_nodecount ; ++i)
+    {
+	m_inOffsets[i + 1] += m_inOffsets[i];
+    }
+
+    for(MatrixIndex fromnode = 0 ; fromnode < m_nodecount ; ++fromnode)
+    {
+	const MatrixIndex* row = m_outNeighbours + m_outOffsets[fromnode];
+
+	for(MatrixIndex k = 0 ; k < m_outDegree[fromnode] ; ++k)
+	{
+	    MatrixIndex tonode = row[k];
+	    m_inNeighbours[m_inOffsets[tonode] + m_inDegree[tonode]++] = fromnode;
+	}
+    }
+}
+
+// Renumber the nodes so node i becomes node newIndices[i], which must be a
+// permutation. Rows are rebuilt owned by the graph and sorted in the new
+// numbering, and the names move with their nodes. The graph remembers each
+// node's index before the first renumbering so results can be reported in
+// that order. Edges stored as bit matrices or gap encoded are stored the
+// same way again afterwards.
+void DirectedGraph::renumberNodes(const std::vector<MatrixIndex>& newIndices)
+{
+    bool dense = isDense();
+    bool compressed = isCompressed();
+    useSparseStorage();
+
+    // lay out the rows in the new order, closing up any slack
+    Offsets offsets(m_nodecount + 1, 0);
+    Degrees degrees(m_nodecount);
+
+    for(MatrixIndex i = 0 ; i < m_nodecount ; ++i)
+    {
+	degrees[newIndices[i]] = m_outDegree[i];
+    }
+
+    for(MatrixIndex i = 0 ; i < m_nodecount ; ++i)
+    {
+	offsets[i + 1] = offsets[i] + degrees[i];
+    }
+
+    Neighbours neighbours(offsets[m_nodecount]);
+
+    for(MatrixIndex i = 0 ; i < m_nodecount ; ++i)
+    {
+	const MatrixIndex* row = m_outNeighbours + m_outOffsets[i];
+	Neighbours::iterator rowBegin = neighbours.begin() + offsets[newIndices[i]];
+
+	for(MatrixIndex k = 0 ; k < m_outDegree[i] ; ++k)
+	{
+	    rowBegin[k] = newIndices[row[k]];
+	}
+
+	std::sort(rowBegin, rowBegin + m_outDegree[i]);
+    }
+
+    m_outOffsetStorage.swap(offsets);
+    m_outDegreeStorage.swap(degrees);
+    m_outNeighbourStorage.swap(neighbours);
+    m_edgecount = m_outOffsetStorage[m_nodecount];
+    buildColumns();
+
+    // node at each new index before this renumbering
+    std::vector<MatrixIndex> oldIndices(m_nodecount);
+
+    for(MatrixIndex i = 0 ; i < m_nodecount ; ++i)
+    {
+	oldIndices[newIndices[i]] = i;
+    }
+
+    // names only line up with nodes when every node has one
+    if(m_namecount == m_nodecount)
+    {
+	std::vector<uint64_t> nameOffsets(1, 0);
+	std::vector<char> names;
+	nameOffsets.reserve(m_namecount + 1);
+	names.reserve(m_nameOffsets[m_namecount]);
+
+	for(MatrixIndex i = 0 ; i < m_nodecount ; ++i)
+	{
+	    std::string_view name = getNodeName(oldIndices[i]);
+	    names.insert(names.end(), name.begin(), name.end());
+	    nameOffsets.push_back(names.size());
+	}
+
+	m_nameOffsetStorage.swap(nameOffsets);
+	m_nameStorage.swap(names);
+	m_nameOffsets = m_nameOffsetStorage.data();
+	m_names = m_nameStorage.data();
+    }
+
+    // compose with any earlier renumbering
+    std::vector<MatrixIndex> originalIndices(m_nodecount);
+
+    for(MatrixIndex i = 0 ; i < m_nodecount ; ++i)
+    {
+	originalIndices[i] = getOriginalIndex(oldIndices[i]);
+    }
+
+    m_originalIndices.swap(originalIndices);
+    m_currentIndices.resize(m_nodecount);
+
+    for(MatrixIndex i = 0 ; i < m_nodecount ; ++i)
+    {
+	m_currentIndices[m_originalIndices[i]] = i;
+    }
+
+    if(dense)
+    {
+	useDenseStorage();
+    }
+    else if(compressed)
+    {
+	useCompressedStorage();
+    }
+}
+
+// returns the index a node had before the nodes were first renumbered
+MatrixIndex DirectedGraph::getOriginalIndex(MatrixIndex node) const
+{
+    return m_originalIndices.empty() ? node : m_originalIndices[node];
+}
+
+// returns the current index of the node which had the given index before renumbering
+MatrixIndex DirectedGraph::getCurrentIndex(MatrixIndex originalIndex) const
+{
+    return m_currentIndices.empty() ? originalIndex : m_currentIndices[originalIndex];
+}
+
+// Choose how the next call to finalise() stores the edges. Automatic
+// storage picks bit matrices when they take no more memory than the
+// sparse arrays, which is when roughly one in 32 possible edges exists.
+// Compressed storage is only used when asked for.
+void DirectedGraph::setStorage(Storage storage)
+{
+    m_storage = storage;
+}
+
+// returns true if the edges are stored as bit matrices
+bool DirectedGraph::isDense() const
+{
+    return m_dense != NULL;
+}
+
+// returns true if the edges are stored gap encoded
+bool DirectedGraph::isCompressed() const
+{
+    return m_compressed != NULL;
+}
+
+// Returns the number of bytes the edges take, the sparse arrays counting
+// their offsets, degrees and neighbours whether they are owned or mapped
+uint64_t DirectedGraph::getEdgeStorageSize() const
+{
+    uint64_t degreeSize = 2 * (uint64_t)m_nodecount * sizeof(MatrixIndex);
+
+    if(m_dense)
+    {
+	return DenseAdjacency::getStorageSize(m_nodecount) + degreeSize;
+    }
+
+    if(m_compressed)
+    {
+	return m_compressed->getStorageSize() + degreeSize;
+    }
+
+    return 2 * ((m_nodecount + (uint64_t)1) * sizeof(EdgeIndex) + m_outOffsets[m_nodecount] * sizeof(MatrixIndex)) + degreeSize;
+}
+
+// returns true if finalise() should store the edges as bit matrices
+bool DirectedGraph::shouldUseDenseStorage() const
+{
+    if(m_storage != STORAGE_AUTOMATIC)
+    {
+	return m_storage == STORAGE_DENSE;
+    }
+
+    uint64_t sparseSize = 2*(m_edgecount*sizeof(MatrixIndex) + (m_nodecount + 1)*(uint64_t)sizeof(EdgeIndex));
+
+    return m_nodecount && m_nodecount <= DENSE_MAX_NODES && DenseAdjacency::getStorageSize(m_nodecount) <= sparseSize;
+}
+
+// Move the edges from the sparse arrays into bit matrices and free the
+// offset and neighbour arrays. The degree arrays are kept as they are.
+void DirectedGraph::useDenseStorage()
+{
+    m_dense.reset(new DenseAdjacency(m_nodecount));
+
+    for(MatrixIndex fromnode = 0 ; fromnode < m_nodecount ; ++fromnode)
+    {
+	const MatrixIndex* row = m_outNeighbours + m_outOffsets[fromnode];
+
+	for(MatrixIndex k = 0 ; k < m_outDegree[fromnode] ; ++k)
+	{
+	    m_dense->setEdge(fromnode, row[k]);
+	}
+    }
+
+    Offsets().swap(m_outOffsetStorage);
+    Neighbours().swap(m_outNeighbourStorage);
+    Offsets().swap(m_inOffsetStorage);
+    Neighbours().swap(m_inNeighbourStorage);
+    useOwnedArrays();
+}
+
+// Rebuild the sparse arrays from the bit matrices or the gap encoded rows,
+// if the edges are in either. Neighbours are visited in index order so the
+// rows come out sorted.
+void DirectedGraph::useSparseStorage()
+{
+    if(!m_dense && !m_compressed)
+    {
+	return;
+    }
+
+    // lay out one direction's rows back to back
+    auto buildLists = [this](Offsets& offsets, Neighbours& neighbours, const MatrixIndex* degrees, bool outbound)
+    {
+	offsets.assign(m_nodecount + 1, 0);
+	neighbours.clear();
+	neighbours.reserve(m_edgecount);
+
+	for(MatrixIndex i = 0 ; i < m_nodecount ; ++i)
+	{
+	    auto append = [&neighbours](MatrixIndex neighbour)
+	    {
+		neighbours.push_back(neighbour);
+	    };
+
+	    if(outbound)
+	    {
+		forEachOutNeighbour(i, append);
+	    }
+	    else
+	    {
+		forEachInNeighbour(i, append);
+	    }
+
+	    offsets[i + 1] = offsets[i] + degrees[i];
+	}
+    };
+
+    buildLists(m_outOffsetStorage, m_outNeighbourStorage, m_outDegree, true);
+    buildLists(m_inOffsetStorage, m_inNeighbourStorage, m_inDegree, false);
+    m_dense.reset();
+    m_compressed.reset();
+    useOwnedArrays();
+}
+
+// Gap encode the sparse arrays and free the offset and neighbour arrays.
+// The degree arrays are kept as they are.
+void DirectedGraph::useCompressedStorage()
+{
+    m_compressed.reset(new CompressedAdjacency(m_nodecount, m_outOffsets, m_outDegree, m_outNeighbours,
+					       m_inOffsets, m_inDegree, m_inNeighbours));
+
+    Offsets().swap(m_outOffsetStorage);
+    Neighbours().swap(m_outNeighbourStorage);
+    Offsets().swap(m_inOffsetStorage);
+    Neighbours().swap(m_inNeighbourStorage);
+    useOwnedArrays();
+}
+
+// Remove a neighbour from a sorted neighbour list, shifting the tail of
+// the list down. Returns false if the neighbour was not in the list.
+bool DirectedGraph::eraseNeighbour(MatrixIndex* neighbours, MatrixIndex& degree, MatrixIndex neighbour)
+{
+    MatrixIndex* end = neighbours + degree;
+    MatrixIndex* position = std::lower_bound(neighbours, end, neighbour);
+
+    if(position == end || *position != neighbour)
+    {
+	return false;
+    }
+
+    std::copy(position + 1, end, position);
+    --degree;
+
+    return true;
+}
+
+// Insert a neighbour into a sorted neighbour list with room for it,
+// shifting the tail of the list up
+void DirectedGraph::insertNeighbour(MatrixIndex* neighbours, MatrixIndex& degree, MatrixIndex neighbour)
+{
+    MatrixIndex* end = neighbours + degree;
+    MatrixIndex* position = std::lower_bound(neighbours, end, neighbour);
+
+    std::copy_backward(position, end, end + 1);
+    *position = neighbour;
+    ++degree;
+}
+
+// show the adjacency lists (debug output only)
+void DirectedGraph::dumpGraph()
+{
+    if(!Logger::isEnabled(Logger::VERBOSITY_DEBUG))
+    {
+	return;
+    }
+
+    std::ostream& out = Logger::getStream();
+
+    out << "Adjacency lists: \n";
+
+    for(MatrixIndex i = 0 ; i < m_nodecount ; ++i)
+    {
+	out << i << " ->";
+
+	forEachOutNeighbour(i, [&out](MatrixIndex tonode)
+	{
+	    out << " " << tonode;
+	});
+
+	out << "\n";
+    }
+
+    out << "\n";
 }
 
 // returns number of nodes in the graph
@@ -83,24 +783,78 @@ MatrixIndex DirectedGraph::getNodeCount() const
     return m_nodecount;
 }
 
-// add entry to map of index to node objects
-void DirectedGraph::addIndexToNodeLookup(MatrixIndex index, Node node)
+// returns number of edges in the graph
+EdgeIndex DirectedGraph::getEdgeCount() const
 {
-    m_indexToNodeLookUp.insert(std::pair<MatrixIndex,Node>(index,node));
+    return m_edgecount;
 }
 
-// returns the node with the given index
-DirectedGraph::Node DirectedGraph::getNodeByIndex(MatrixIndex index) const
+// returns number of outbound links of a node
+MatrixIndex DirectedGraph::getOutDegree(MatrixIndex node) const
+{
+    return m_outDegree[node];
+}
+
+// returns number of inbound links of a node
+MatrixIndex DirectedGraph::getInDegree(MatrixIndex node) const
+{
+    return m_inDegree[node];
+}
+
+// Point offsets, degrees and neighbours at the compressed sparse columns, so
+// the in-neighbours of node i are neighbours[offsets[i]] .. [offsets[i] + degrees[i]].
+// Returns false if the edges are stored as bit matrices or gap encoded, which have no such arrays.
+bool DirectedGraph::getInNeighbourArrays(const EdgeIndex*& offsets, const MatrixIndex*& degrees, const MatrixIndex*& neighbours) const
 {
-    IndexToNodeLookUp::const_iterator indexToNodeLookUpIter = m_indexToNodeLookUp.find(index);
+    if(m_dense || m_compressed)
+    {
+	return false;
+    }
+
+    offsets = m_inOffsets;
+    degrees = m_inDegree;
+    neighbours = m_inNeighbours;
+
+    return true;
+}
 
-    if(indexToNodeLookUpIter == m_indexToNodeLookUp.end())
+// Give the next unnamed node a name. Names are appended to the graph's own
+// string table, copying the names over first if they are in a snapshot.
+void DirectedGraph::addNodeName(std::string_view name)
+{
+    if(m_nameOffsets != m_nameOffsetStorage.data())
     {
-      return Node("NODE NAME NOT FOUND IN LOOKUP");
+	m_nameOffsetStorage.assign(m_nameOffsets, m_nameOffsets + m_namecount + 1);
+	m_nameStorage.assign(m_names, m_names + m_nameOffsets[m_namecount]);
     }
-    else
+
+    m_nameStorage.insert(m_nameStorage.end(), name.begin(), name.end());
+    m_nameOffsetStorage.push_back(m_nameStorage.size());
+    ++m_namecount;
+
+    m_nameOffsets = m_nameOffsetStorage.data();
+    m_names = m_nameStorage.data();
+}
+
+// returns the node with the given index
+DirectedGraph::Node DirectedGraph::getNodeByIndex(MatrixIndex index) const
+{
+    if(index >= m_namecount)
     {
-        return indexToNodeLookUpIter->second;
+	return Node("NODE NAME NOT FOUND IN LOOKUP");
     }
+
+    return Node(getNodeName(index));
 }
 
+// returns the name of the node with the given index, which must have a name
+std::string_view DirectedGraph::getNodeName(MatrixIndex index) const
+{
+    return std::string_view(m_names + m_nameOffsets[index], m_nameOffsets[index + 1] - m_nameOffsets[index]);
+}
+
+// returns how many nodes have been given a name
+MatrixIndex DirectedGraph::getNamedNodeCount() const
+{
+    return m_namecount;
+}
@@ -1,52 +1,256 @@
 /****************************************************************
-Class representing a directed graph. The graph is an adjacency
-matrix to which edges and vertices can be added. Nodes in the 
-graph also map to node objects.
+Class representing a directed graph. The graph is stored as
+compressed sparse rows (out-edges of each node) and compressed
+sparse columns (in-edges of each node) so memory and scan cost
+scale with the number of edges. Edges are queued with addEdge()
+and the sparse arrays are built by finalise(), or inserted one at
+a time with insertEdge() into slack left at the end of each row,
+which is made by laying the rows out again when it runs out. The arrays can
+also live in a memory mapped graph snapshot. Small graphs dense
+enough for it are instead stored as bit matrices, and large ones
+can be stored gap encoded to save memory. Nodes in the
+graph also map to node names held in a single string table.
 ****************************************************************/
 
 #ifndef DIRECTEDGRAPH_H
 #define DIRECTEDGRAPH_H
 
+#include "graphtypes.h"
+#include "denseadjacency.h"
+#include "compressedadjacency.h"
+
 #include <stdint.h>
-#include <map>
 #include <string>
+#include <string_view>
 #include <cstring>
+#include <vector>
+#include <utility>
+#include <memory>
+
+class MappedFile;
 
-typedef uint32_t MatrixIndex;
+// Graphs with more nodes than this are never stored densely
+#define DENSE_MAX_NODES 16384
+
+// Room for edges left after each sparse row and column when they are laid
+// out again for insertEdge(), at least this many edges
+#define EDGE_SLACK_MINIMUM 4
+// and a further share of the row's edges, one in this many
+#define EDGE_SLACK_DIVISOR 4
 
 class DirectedGraph
 {
-    public:  
-	DirectedGraph(){};
+    public:
+	// how finalise() stores the edges
+	enum Storage
+	{
+	    // dense if the bit matrices are no larger than the sparse arrays
+	    STORAGE_AUTOMATIC,
+	    STORAGE_SPARSE,
+	    STORAGE_DENSE,
+	    // sparse rows gap encoded as varints, decoded as they are walked
+	    STORAGE_COMPRESSED
+	};
+
+	DirectedGraph();
 	DirectedGraph(MatrixIndex nodecount);
 	virtual ~DirectedGraph();
-  
+
 	// returns true if there is an edge, false otherwise
 	bool isEdge(MatrixIndex i, MatrixIndex j) const;
+	// queue an edge, it is added to the graph by finalise()
 	void addEdge(MatrixIndex i, MatrixIndex j);
+	// add an edge straight away in whatever storage the graph is in,
+	// returns false if the edge was already there
+	bool insertEdge(MatrixIndex i, MatrixIndex j);
 	void removeEdge(MatrixIndex i, MatrixIndex j);
 	void removeVertex(MatrixIndex vertex);
-  
+	// remove every vertex flagged true, in one pass over the graph
+	void removeVertices(const bool* vertices);
+	// build the sparse row and column arrays from the queued edges,
+	// returns the number of duplicate edges that were dropped
+	EdgeIndex finalise();
+	// choose how the next call to finalise() stores the edges
+	void setStorage(Storage storage);
+	// returns true if the edges are stored as bit matrices
+	bool isDense() const;
+	// returns true if the edges are stored gap encoded
+	bool isCompressed() const;
+	// returns the number of bytes the edges take in their current storage
+	uint64_t getEdgeStorageSize() const;
+	// renumber the nodes so node i becomes node newIndices[i]
+	void renumberNodes(const std::vector<MatrixIndex>& newIndices);
+	// returns the index a node had before the nodes were renumbered
+	MatrixIndex getOriginalIndex(MatrixIndex node) const;
+	// returns the current index of the node with the given original index
+	MatrixIndex getCurrentIndex(MatrixIndex originalIndex) const;
+
 	// print the graph to standard out
 	void dumpGraph();
-    
+
 	// returns count of how many nodes in the graph
 	MatrixIndex getNodeCount() const;
-	
+	// returns count of how many edges in the graph
+	EdgeIndex getEdgeCount() const;
+	// returns number of outbound links of a node
+	MatrixIndex getOutDegree(MatrixIndex node) const;
+	// returns number of inbound links of a node
+	MatrixIndex getInDegree(MatrixIndex node) const;
+
+	// point at the compressed sparse columns, for kernels which walk them
+	// directly, returns false if the edges are stored as bit matrices or gap encoded
+	bool getInNeighbourArrays(const EdgeIndex*& offsets, const MatrixIndex*& degrees, const MatrixIndex*& neighbours) const;
+
+	// call visitor(tonode) for each node the given node links to,
+	// in increasing index order
+	template<typename Visitor>
+	void forEachOutNeighbour(MatrixIndex node, Visitor visitor) const;
+	// call visitor(fromnode) for each node linking to the given node,
+	// in increasing index order
+	template<typename Visitor>
+	void forEachInNeighbour(MatrixIndex node, Visitor visitor) const;
+
 	typedef std::string Node;
-	// add entry to map of index to node
-	void addIndexToNodeLookup(MatrixIndex index, Node node);
+	// give the next unnamed node (starting from index 0) a name
+	void addNodeName(std::string_view name);
 	// returns the node with the given index
 	Node getNodeByIndex(MatrixIndex index) const;
-  
+	// returns the name of the node with the given index without copying it
+	std::string_view getNodeName(MatrixIndex index) const;
+	// returns how many nodes have been given a name
+	MatrixIndex getNamedNodeCount() const;
+
     private:
-	bool** m_adjacencyMatrix;
+	DirectedGraph(const DirectedGraph&);
+	DirectedGraph& operator=(const DirectedGraph&);
+
+	// snapshots are written from and mapped straight into the arrays below
+	friend class GraphSnapshot;
+
+	typedef std::vector<EdgeIndex> Offsets;
+	typedef std::vector<MatrixIndex> Neighbours;
+	typedef std::vector<MatrixIndex> Degrees;
+	typedef std::vector<std::pair<MatrixIndex, MatrixIndex> > Edges;
+
+	// remove a single neighbour from a node's list keeping it sorted
+	static bool eraseNeighbour(MatrixIndex* neighbours, MatrixIndex& degree, MatrixIndex neighbour);
+	// add a neighbour to a node's list keeping it sorted, which must have room for it
+	static void insertNeighbour(MatrixIndex* neighbours, MatrixIndex& degree, MatrixIndex neighbour);
+	// lay the sparse rows and columns out again, owned by the graph, with room after each
+	void spreadRows();
+	// point the sparse arrays at the storage owned by the graph
+	void useOwnedArrays();
+	// move the edges out of the bit matrices or gap encoded rows into the sparse arrays
+	void useSparseStorage();
+	// move the edges out of the sparse arrays into bit matrices
+	void useDenseStorage();
+	// move the edges out of the sparse arrays into gap encoded rows
+	void useCompressedStorage();
+	// returns true if finalise() should store the edges as bit matrices
+	bool shouldUseDenseStorage() const;
+	// build the compressed sparse columns from the rows
+	void buildColumns();
+
+	// Compressed sparse rows. The out-neighbours of node i are
+	// m_outNeighbours[m_outOffsets[i]] .. [m_outOffsets[i] + m_outDegree[i]].
+	// Removing edges shrinks the degree and leaves slack at the end of the row,
+	// which insertEdge() fills.
+	// The arrays point either into the storage below or into a snapshot.
+	EdgeIndex* m_outOffsets;
+	MatrixIndex* m_outDegree;
+	MatrixIndex* m_outNeighbours;
+	// Compressed sparse columns, laid out the same way for in-neighbours
+	EdgeIndex* m_inOffsets;
+	MatrixIndex* m_inDegree;
+	MatrixIndex* m_inNeighbours;
+	// storage for the sparse arrays when they are not in a snapshot
+	Offsets m_outOffsetStorage;
+	Degrees m_outDegreeStorage;
+	Neighbours m_outNeighbourStorage;
+	Offsets m_inOffsetStorage;
+	Degrees m_inDegreeStorage;
+	Neighbours m_inNeighbourStorage;
+	// edges added since the last call to finalise()
+	Edges m_pendingEdges;
 	// count of nodes in graph
 	MatrixIndex m_nodecount;
-	
-	// given the index of a node get the node itself
-	typedef std::map<MatrixIndex, Node> IndexToNodeLookUp;
-	IndexToNodeLookUp m_indexToNodeLookUp;
+	// count of edges in graph
+	EdgeIndex m_edgecount;
+
+	// node names one after another, name i runs from m_nameOffsets[i] to
+	// m_nameOffsets[i + 1]. Like the sparse arrays these point either into
+	// the storage below or into a snapshot.
+	const uint64_t* m_nameOffsets;
+	const char* m_names;
+	MatrixIndex m_namecount;
+	std::vector<uint64_t> m_nameOffsetStorage;
+	std::vector<char> m_nameStorage;
+
+	// Index each node had before renumberNodes() and its inverse,
+	// both empty while the nodes are in their original order
+	std::vector<MatrixIndex> m_originalIndices;
+	std::vector<MatrixIndex> m_currentIndices;
+
+	// snapshot the arrays are mapped from, if any
+	std::unique_ptr<MappedFile> m_snapshot;
+	// true until the neighbours mapped from a snapshot have been checked
+	bool m_uncheckedNeighbours;
+
+	// The edges as bit matrices, or NULL when they are in the sparse arrays.
+	// The degree arrays are kept up to date either way.
+	std::unique_ptr<DenseAdjacency> m_dense;
+	// The edges gap encoded, or NULL when they are in the sparse arrays
+	// or bit matrices. The degree arrays are kept up to date here too.
+	std::unique_ptr<CompressedAdjacency> m_compressed;
+	Storage m_storage;
 };
 
+template<typename Visitor>
+inline void DirectedGraph::forEachOutNeighbour(MatrixIndex node, Visitor visitor) const
+{
+    if(m_dense)
+    {
+	m_dense->forEachOutNeighbour(node, visitor);
+	return;
+    }
+
+    if(m_compressed)
+    {
+	m_compressed->forEachOutNeighbour(node, m_outDegree[node], visitor);
+	return;
+    }
+
+    const MatrixIndex* neighbour = m_outNeighbours + m_outOffsets[node];
+    const MatrixIndex* end = neighbour + m_outDegree[node];
+
+    for( ; neighbour != end ; ++neighbour)
+    {
+	visitor(*neighbour);
+    }
+}
+
+template<typename Visitor>
+inline void DirectedGraph::forEachInNeighbour(MatrixIndex node, Visitor visitor) const
+{
+    if(m_dense)
+    {
+	m_dense->forEachInNeighbour(node, visitor);
+	return;
+    }
+
+    if(m_compressed)
+    {
+	m_compressed->forEachInNeighbour(node, m_inDegree[node], visitor);
+	return;
+    }
+
+    const MatrixIndex* neighbour = m_inNeighbours + m_inOffsets[node];
+    const MatrixIndex* end = neighbour + m_inDegree[node];
+
+    for( ; neighbour != end ; ++neighbour)
+    {
+	visitor(*neighbour);
+    }
+}
+
 #endif
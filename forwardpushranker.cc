@@ -0,0 +1,193 @@
+/****************************************************************
+Approximates the personalized page rank of one seed node by
+forward push (Andersen, Chung and Lang). All of the seed's rank
+starts as residual at the seed. Pushing a node's residual keeps
+1 - decay of it as the node's rank and passes the rest on, split
+evenly, along its outbound links, or back to the seed if it has
+none. Only nodes whose residual is at
+least epsilon times their outbound link count are pushed, so a
+query touches the seed's neighbourhood rather than the whole graph
+and costs O(1/(epsilon(1 - decay))) whatever the graph's size. The
+ranks and residuals are held in hash maps of the nodes touched.
+****************************************************************/
+
+#include "forwardpushranker.h"
+#include "graphsnapshot.h"
+#include "logger.h"
+#include "metrics.h"
+
+#include <algorithm>
+#include <deque>
+
+ForwardPushRanker::ForwardPushRanker():m_epsilon(FORWARD_PUSH_DEFAULT_EPSILON){}
+
+// push nodes whose residual is at least epsilon times their outbound link count
+void ForwardPushRanker::setEpsilon(PageRank epsilon)
+{
+    m_epsilon = epsilon;
+}
+
+// Approximate the personalized page rank of a seed node, the page rank
+// PersonalizedRanker gives a seed set of that one node. A node is queued
+// when its residual reaches epsilon times its outbound link count (epsilon
+// for a node with none), and as residuals only grow until they are pushed
+// each queued node is pushed once for each time it is queued. Like
+// PersonalizedRanker a node with no outbound links passes its rank back to
+// the seed, as a random jump would. Every push keeps at least
+// (1 - decay) epsilon of rank per link it walks, so at most
+// 1/(epsilon(1 - decay)) links are walked in all. The links of a graph
+// mapped from a snapshot are checked as each node is pushed, so only the
+// rows of the nodes reached are read.
+void ForwardPushRanker::rankFromSeed(const DirectedGraph& graph, MatrixIndex seed, float decayfactor)
+{
+    METRICS_PHASE("forward_push");
+
+    LOG_SUMMARY("###############################################\n");
+    LOG_SUMMARY("Approximating personalized page rank of " << graph.getNodeName(seed) << "...\n");
+    LOG_SUMMARY("###############################################\n");
+
+    m_pageRanks.clear();
+    m_residuals.clear();
+
+    // residual a node needs to be pushed
+    auto threshold = [this, &graph](MatrixIndex node)
+    {
+	return m_epsilon * std::max<MatrixIndex>(graph.getOutDegree(node), 1);
+    };
+
+    std::deque<MatrixIndex> queue;
+    uint64_t pushes = 0;
+    uint64_t edgesPushed = 0;
+
+    // add to a node's residual, queueing the node as its residual reaches the threshold
+    auto addResidual = [&](MatrixIndex node, PageRank share)
+    {
+	PageRank& residual = m_residuals[node];
+	PageRank nodeThreshold = threshold(node);
+
+	if(residual < nodeThreshold && residual + share >= nodeThreshold)
+	{
+	    queue.push_back(node);
+	}
+
+	residual += share;
+    };
+
+    addResidual(seed, 1);
+
+    while(!queue.empty())
+    {
+	MatrixIndex node = queue.front();
+	queue.pop_front();
+
+	PageRank& residual = m_residuals[node];
+	PageRank pushed = residual;
+	residual = 0;
+
+	m_pageRanks[node] += (1 - (PageRank)decayfactor) * pushed;
+	++pushes;
+
+	MatrixIndex outDegree = graph.getOutDegree(node);
+
+	if(!outDegree)
+	{
+	    addResidual(seed, decayfactor * pushed);
+	    continue;
+	}
+
+	PageRank share = decayfactor * pushed / outDegree;
+	GraphSnapshot::checkOutNeighbours(graph, node);
+
+	graph.forEachOutNeighbour(node, [&](MatrixIndex tonode)
+	{
+	    addResidual(tonode, share);
+	});
+
+	edgesPushed += outDegree;
+    }
+
+    METRICS_COUNT("pushes", pushes);
+    METRICS_COUNT("edges_pushed", edgesPushed);
+    METRICS_COUNT("nodes_touched", m_residuals.size());
+
+    LOG_SUMMARY("Pushed residuals from " << pushes << " nodes along " << edgesPushed << " links, ranking "
+		<< m_pageRanks.size() << " of " << graph.getNodeCount() << " nodes\n");
+    LOG_SUMMARY("Residual left unpushed " << getResidualMass() << "\n\n");
+}
+
+// returns the approximate rank of a node, 0 for nodes the query did not reach
+ForwardPushRanker::PageRank ForwardPushRanker::getRank(MatrixIndex node) const
+{
+    SparseVector::const_iterator found = m_pageRanks.find(node);
+
+    return found == m_pageRanks.end() ? 0 : found->second;
+}
+
+// returns the number of nodes given a rank by the last query
+MatrixIndex ForwardPushRanker::getRankedNodeCount() const
+{
+    return m_pageRanks.size();
+}
+
+// Returns the residual left unpushed. The exact rank of every node is at
+// least its approximate rank and the two differ by at most this in total.
+ForwardPushRanker::PageRank ForwardPushRanker::getResidualMass() const
+{
+    PageRank mass = 0;
+
+    for(SparseVector::const_iterator iter = m_residuals.begin() ; iter != m_residuals.end() ; ++iter)
+    {
+	mass += iter->second;
+    }
+
+    return mass;
+}
+
+// Returns the count highest ranked nodes, or every ranked node if count is
+// 0, highest first and nodes of equal rank in their original index order
+std::vector<ForwardPushRanker::RankedNode> ForwardPushRanker::getTopRankedNodes(const DirectedGraph& graph, MatrixIndex count) const
+{
+    std::vector<RankedNode> ranked;
+    ranked.reserve(m_pageRanks.size());
+
+    for(SparseVector::const_iterator iter = m_pageRanks.begin() ; iter != m_pageRanks.end() ; ++iter)
+    {
+	RankedNode rankedNode = {iter->first, std::string_view(), iter->second};
+	ranked.push_back(rankedNode);
+    }
+
+    // true if node a ranks above node b
+    auto ranksAbove = [&graph](const RankedNode& a, const RankedNode& b)
+    {
+	return a.rank > b.rank || (a.rank == b.rank && graph.getOriginalIndex(a.index) < graph.getOriginalIndex(b.index));
+    };
+
+    if(!count || count > ranked.size())
+    {
+	count = ranked.size();
+    }
+
+    std::partial_sort(ranked.begin(), ranked.begin() + count, ranked.end(), ranksAbove);
+    ranked.resize(count);
+
+    for(RankedNode& rankedNode : ranked)
+    {
+	rankedNode.name = graph.getNodeName(rankedNode.index);
+    }
+
+    return ranked;
+}
+
+// show the count highest ranked nodes, every ranked node if count is 0
+void ForwardPushRanker::dumpTopPageRank(const DirectedGraph& graph, MatrixIndex count) const
+{
+    std::vector<RankedNode> top = getTopRankedNodes(graph, count);
+    std::ostream& out = Logger::getStream();
+
+    // the page ranks are the result so are written at every verbosity
+    out << "Rank | Node | PageRank\n";
+    for(MatrixIndex k = 0 ; k < top.size() ; ++k)
+    {
+	out << k + 1 << " " << top[k].name << " " << top[k].rank << "\n";
+    }
+}
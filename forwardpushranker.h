@@ -0,0 +1,63 @@
+/****************************************************************
+Approximates the personalized page rank of one seed node by
+forward push (Andersen, Chung and Lang). All of the seed's rank
+starts as residual at the seed. Pushing a node's residual keeps
+1 - decay of it as the node's rank and passes the rest on, split
+evenly, along its outbound links, or back to the seed if it has
+none. Only nodes whose residual is at
+least epsilon times their outbound link count are pushed, so a
+query touches the seed's neighbourhood rather than the whole graph
+and costs O(1/(epsilon(1 - decay))) whatever the graph's size. The
+ranks and residuals are held in hash maps of the nodes touched.
+****************************************************************/
+
+#ifndef FORWARDPUSHRANKER_H
+#define FORWARDPUSHRANKER_H
+
+#include "directedgraph.h"
+#include "pageranker.h"
+
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+
+// Residual per outbound link below which a node is not pushed, when none is set
+#define FORWARD_PUSH_DEFAULT_EPSILON 1e-6
+
+class ForwardPushRanker
+{
+    public:
+      typedef double PageRank;
+      typedef PageRanker::RankedNode RankedNode;
+
+      ForwardPushRanker();
+      virtual ~ForwardPushRanker(){};
+      // push nodes whose residual is at least epsilon times their outbound link count
+      void setEpsilon(PageRank epsilon);
+      // approximate the personalized page rank of a seed node
+      void rankFromSeed(const DirectedGraph& graph, MatrixIndex seed, float decayfactor);
+
+      // returns the approximate rank of a node, 0 for nodes the query did not reach
+      PageRank getRank(MatrixIndex node) const;
+      // returns the number of nodes given a rank by the last query
+      MatrixIndex getRankedNodeCount() const;
+      // returns the residual left unpushed, which bounds the rank missing from the approximation
+      PageRank getResidualMass() const;
+      // the count highest ranked nodes (every ranked node if count is 0), highest first, ties in original index order
+      std::vector<RankedNode> getTopRankedNodes(const DirectedGraph& graph, MatrixIndex count) const;
+      // show the count highest ranked nodes
+      void dumpTopPageRank(const DirectedGraph& graph, MatrixIndex count) const;
+
+    private:
+      ForwardPushRanker(const ForwardPushRanker&);
+      ForwardPushRanker& operator=(const ForwardPushRanker&);
+
+      typedef std::unordered_map<MatrixIndex, PageRank> SparseVector;
+
+      // rank and unpushed residual of each node the last query touched
+      SparseVector m_pageRanks;
+      SparseVector m_residuals;
+      PageRank m_epsilon;
+};
+
+#endif
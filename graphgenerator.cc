@@ -0,0 +1,192 @@
+/****************************************************************
+Generates synthetic directed graphs for benchmarking: R-MAT
+(recursive matrix, a Kronecker graph), Erdos-Renyi G(n, m) and a
+web-like graph whose in- and out-degrees follow power laws. Any of
+them can be given a fraction of dangling nodes, which have no
+outbound links. Graphs are returned as edge lists and can be
+written out as links files named by node index.
+****************************************************************/
+
+#include "graphgenerator.h"
+
+#include <cstdio>
+#include <algorithm>
+#include <unordered_set>
+#include <math.h>
+
+GraphGenerator::GraphGenerator(uint64_t seed):m_random(seed),m_danglingFraction(0){}
+
+// Fraction of nodes generated with no outbound links. Edges the generator
+// would have started at a dangling node start at a random other node instead.
+void GraphGenerator::setDanglingFraction(double fraction)
+{
+    m_danglingFraction = fraction;
+}
+
+// pick the dangling nodes of a graph with the given number of nodes
+void GraphGenerator::chooseDanglingNodes(MatrixIndex nodecount)
+{
+    std::bernoulli_distribution isDangling(m_danglingFraction);
+
+    m_isDangling.assign(nodecount, false);
+    m_linkingNodes.clear();
+
+    for(MatrixIndex node = 0 ; node < nodecount ; ++node)
+    {
+	m_isDangling[node] = isDangling(m_random);
+
+	if(!m_isDangling[node])
+	{
+	    m_linkingNodes.push_back(node);
+	}
+    }
+
+    // keep at least one node with links so there are edges to generate
+    if(m_linkingNodes.empty() && nodecount)
+    {
+	m_isDangling[0] = false;
+	m_linkingNodes.push_back(0);
+    }
+}
+
+// add an edge, moving it to a node which is not dangling if need be
+void GraphGenerator::addEdge(MatrixIndex from, MatrixIndex to, Edges& edges)
+{
+    if(m_isDangling[from])
+    {
+	from = m_linkingNodes[std::uniform_int_distribution<size_t>(0, m_linkingNodes.size() - 1)(m_random)];
+    }
+
+    edges.push_back(std::make_pair(from, to));
+}
+
+// Generate an R-MAT graph. Each edge picks one quadrant of the adjacency
+// matrix with probabilities a, b, c and d, then a quadrant of that quadrant
+// and so on down to a single cell, giving the skewed degrees and community
+// structure of real graphs. Duplicate edges are left for the graph to drop.
+void GraphGenerator::generateRmat(unsigned scale, uint64_t edgecount, Edges& edges)
+{
+    MatrixIndex nodecount = (MatrixIndex)1 << scale;
+    std::uniform_real_distribution<double> uniform(0, 1);
+
+    chooseDanglingNodes(nodecount);
+    edges.clear();
+    edges.reserve(edgecount);
+
+    for(uint64_t edge = 0 ; edge < edgecount ; ++edge)
+    {
+	MatrixIndex from = 0;
+	MatrixIndex to = 0;
+
+	for(unsigned bit = 0 ; bit < scale ; ++bit)
+	{
+	    double quadrant = uniform(m_random);
+
+	    if(quadrant >= RMAT_A + RMAT_B + RMAT_C)
+	    {
+		from |= (MatrixIndex)1 << bit;
+		to |= (MatrixIndex)1 << bit;
+	    }
+	    else if(quadrant >= RMAT_A + RMAT_B)
+	    {
+		from |= (MatrixIndex)1 << bit;
+	    }
+	    else if(quadrant >= RMAT_A)
+	    {
+		to |= (MatrixIndex)1 << bit;
+	    }
+	}
+
+	addEdge(from, to, edges);
+    }
+}
+
+// generate an Erdos-Renyi graph with edges between nodes picked uniformly
+void GraphGenerator::generateErdosRenyi(MatrixIndex nodecount, uint64_t edgecount, Edges& edges)
+{
+    std::uniform_int_distribution<MatrixIndex> node(0, nodecount - 1);
+
+    chooseDanglingNodes(nodecount);
+    edges.clear();
+    edges.reserve(edgecount);
+
+    for(uint64_t edge = 0 ; edge < edgecount ; ++edge)
+    {
+	MatrixIndex from = node(m_random);
+	addEdge(from, node(m_random), edges);
+    }
+}
+
+// Generate a web-like graph. Each node not dangling draws its out-degree
+// from a power law scaled to give about edgecount edges in all. Each edge
+// then either copies the target of an earlier edge, so well linked nodes
+// attract more links, or links to a node picked uniformly. Self links and
+// duplicates are dropped and the nodes draw more out-degrees until there
+// are edgecount distinct edges, or as many as the linking nodes can have.
+void GraphGenerator::generateWebGraph(MatrixIndex nodecount, uint64_t edgecount, Edges& edges)
+{
+    std::uniform_real_distribution<double> uniform(0, 1);
+    std::uniform_int_distribution<MatrixIndex> node(0, nodecount - 1);
+
+    chooseDanglingNodes(nodecount);
+    edgecount = std::min(edgecount, (uint64_t)m_linkingNodes.size() * (nodecount - 1));
+    edges.clear();
+    edges.reserve(edgecount);
+
+    // every edge generated so far, as from << 32 | to
+    std::unordered_set<uint64_t> generated;
+    generated.reserve(edgecount);
+
+    // mean of the power law sampled below, before scaling
+    double exponent = WEB_OUT_DEGREE_EXPONENT;
+    double meanDegree = (exponent - 1) / (exponent - 2);
+    double scale = (double)edgecount / m_linkingNodes.size() / meanDegree;
+
+    while(edges.size() < edgecount)
+    {
+	for(MatrixIndex from : m_linkingNodes)
+	{
+	    // inverse transform sample of a Pareto distribution with minimum 1
+	    double degree = pow(1 - uniform(m_random), -1 / (exponent - 1)) * scale;
+	    uint64_t outDegree = std::min((uint64_t)llround(degree), (uint64_t)nodecount);
+
+	    for(uint64_t k = 0 ; k < outDegree && edges.size() < edgecount ; ++k)
+	    {
+		MatrixIndex to;
+
+		if(!edges.empty() && uniform(m_random) < WEB_COPY_PROBABILITY)
+		{
+		    to = edges[std::uniform_int_distribution<size_t>(0, edges.size() - 1)(m_random)].second;
+		}
+		else
+		{
+		    to = node(m_random);
+		}
+
+		if(to != from && generated.insert((uint64_t)from << 32 | to).second)
+		{
+		    addEdge(from, to, edges);
+		}
+	    }
+	}
+    }
+}
+
+// Write edges as a links file, one "from to" line per edge with nodes
+// named by index. Returns false if the file cannot be written.
+bool GraphGenerator::writeLinksFile(const Edges& edges, const char* filepath)
+{
+    FILE* file = fopen(filepath, "w");
+
+    if(!file)
+    {
+	return false;
+    }
+
+    for(Edges::const_iterator iter = edges.begin() ; iter != edges.end() ; ++iter)
+    {
+	fprintf(file, "%u %u\n", iter->first, iter->second);
+    }
+
+    return fclose(file) == 0;
+}
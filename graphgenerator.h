@@ -0,0 +1,69 @@
+/****************************************************************
+Generates synthetic directed graphs for benchmarking: R-MAT
+(recursive matrix, a Kronecker graph), Erdos-Renyi G(n, m) and a
+web-like graph whose in- and out-degrees follow power laws. Any of
+them can be given a fraction of dangling nodes, which have no
+outbound links. Graphs are returned as edge lists and can be
+written out as links files named by node index.
+****************************************************************/
+
+#ifndef GRAPHGENERATOR_H
+#define GRAPHGENERATOR_H
+
+#include "graphtypes.h"
+
+#include <stdint.h>
+#include <vector>
+#include <utility>
+#include <random>
+
+// R-MAT quadrant probabilities (the fourth is 1 - a - b - c),
+// as used by the Graph500 benchmark
+#define RMAT_A 0.57
+#define RMAT_B 0.19
+#define RMAT_C 0.19
+
+// Chance that a web-like graph's edge links to the target of an
+// earlier edge rather than a node picked uniformly, which gives
+// in-degrees a power law tail
+#define WEB_COPY_PROBABILITY 0.5
+
+// Exponent of the power law followed by web-like out-degrees
+#define WEB_OUT_DEGREE_EXPONENT 2.1
+
+class GraphGenerator
+{
+    public:
+	typedef std::vector<std::pair<MatrixIndex, MatrixIndex> > Edges;
+
+	GraphGenerator(uint64_t seed);
+	virtual ~GraphGenerator(){};
+
+	// fraction of nodes generated with no outbound links (0 by default)
+	void setDanglingFraction(double fraction);
+
+	// R-MAT graph of 2^scale nodes and edgecount edges
+	void generateRmat(unsigned scale, uint64_t edgecount, Edges& edges);
+	// Erdos-Renyi graph of nodecount nodes and edgecount edges picked uniformly
+	void generateErdosRenyi(MatrixIndex nodecount, uint64_t edgecount, Edges& edges);
+	// web-like graph of nodecount nodes and edgecount distinct edges (fewer if they cannot all fit)
+	void generateWebGraph(MatrixIndex nodecount, uint64_t edgecount, Edges& edges);
+
+	// write edges as a links file, node i is named i
+	static bool writeLinksFile(const Edges& edges, const char* filepath);
+
+    private:
+	// pick the dangling nodes of a graph with the given number of nodes
+	void chooseDanglingNodes(MatrixIndex nodecount);
+	// add an edge, moving it to a node which is not dangling if need be
+	void addEdge(MatrixIndex from, MatrixIndex to, Edges& edges);
+
+	std::mt19937_64 m_random;
+	double m_danglingFraction;
+	// whether each node of the graph being generated is dangling
+	std::vector<bool> m_isDangling;
+	// the nodes of the graph being generated which are not dangling
+	std::vector<MatrixIndex> m_linkingNodes;
+};
+
+#endif
@@ -0,0 +1,354 @@
+/****************************************************************
+Reads and writes graph snapshots. A snapshot is a binary file
+holding a graph's sparse row and column arrays and its node name
+string table, laid out exactly as the graph holds them in memory.
+Loading a snapshot maps the file copy-on-write and points the
+graph at the arrays in the mapping, so nothing is parsed or copied.
+Loading checks the row offsets, degrees and name table in a pass over
+the nodes; the neighbours, which are most of the file, are checked
+only when they are first read, so loading reads no neighbour pages.
+****************************************************************/
+
+#include "graphsnapshot.h"
+#include "mappedfile.h"
+#include "metrics.h"
+
+#include <fstream>
+#include <cstring>
+#include <vector>
+
+// returns true if the file starts like a snapshot
+bool GraphSnapshot::isSnapshot(const char* filepath)
+{
+    std::ifstream file(filepath, std::ios::binary);
+    char magic[sizeof(SNAPSHOT_MAGIC)];
+
+    return file.read(magic, sizeof(magic)) && !memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic));
+}
+
+// Size in bytes of each section for the counts in a header. The counts
+// must already be known to be no larger than the file, so none overflow.
+void GraphSnapshot::getSectionSizes(const Header& header, uint64_t sizes[SECTION_COUNT])
+{
+    sizes[OUT_OFFSETS] = (header.nodeCount + 1) * sizeof(EdgeIndex);
+    sizes[OUT_DEGREES] = header.nodeCount * sizeof(MatrixIndex);
+    sizes[OUT_NEIGHBOURS] = header.edgeCount * sizeof(MatrixIndex);
+    sizes[IN_OFFSETS] = sizes[OUT_OFFSETS];
+    sizes[IN_DEGREES] = sizes[OUT_DEGREES];
+    sizes[IN_NEIGHBOURS] = sizes[OUT_NEIGHBOURS];
+    sizes[NAME_OFFSETS] = (header.nameCount + 1) * sizeof(uint64_t);
+    sizes[NAMES] = header.nameBytes;
+}
+
+// Returns true if the rows of a sparse array are laid out as write() lays
+// them out: back to back from the start of the edgecount neighbours with no
+// slack. Only the offsets and degrees are read, not the neighbours.
+bool GraphSnapshot::isValidRowLayout(MatrixIndex nodecount, EdgeIndex edgecount, const EdgeIndex* offsets, const MatrixIndex* degrees)
+{
+    if(offsets[0] != 0 || offsets[nodecount] != edgecount)
+    {
+	return false;
+    }
+
+    for(MatrixIndex node = 0 ; node < nodecount ; ++node)
+    {
+	if(offsets[node + 1] < offsets[node] || offsets[node + 1] > edgecount || degrees[node] != offsets[node + 1] - offsets[node])
+	{
+	    return false;
+	}
+    }
+
+    return true;
+}
+
+// returns true if a row holds nodes of the graph in strictly increasing order
+bool GraphSnapshot::isValidRow(MatrixIndex nodecount, const MatrixIndex* row, MatrixIndex degree)
+{
+    for(MatrixIndex k = 0 ; k < degree ; ++k)
+    {
+	if(row[k] >= nodecount || (k && row[k] <= row[k - 1]))
+	{
+	    return false;
+	}
+    }
+
+    return true;
+}
+
+// returns true if the names lie one after another within the string table
+bool GraphSnapshot::isValidNameTable(MatrixIndex namecount, uint64_t namebytes, const uint64_t* nameOffsets)
+{
+    if(nameOffsets[0] != 0 || nameOffsets[namecount] != namebytes)
+    {
+	return false;
+    }
+
+    for(MatrixIndex name = 0 ; name < namecount ; ++name)
+    {
+	if(nameOffsets[name + 1] < nameOffsets[name])
+	{
+	    return false;
+	}
+    }
+
+    return true;
+}
+
+// Write the graph to a snapshot file. Rows and columns are written without
+// the slack left behind by removed edges, so the snapshot of a graph that
+// has had edges removed is the same as the snapshot of the smaller graph.
+// Graphs stored as bit matrices are written in the same sparse layout.
+void GraphSnapshot::write(const DirectedGraph& graph, const char* filepath)
+{
+    MatrixIndex nodecount = graph.m_nodecount;
+    Header header;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.byteOrder = SNAPSHOT_BYTE_ORDER;
+    header.nodeCount = nodecount;
+    header.edgeCount = graph.m_edgecount;
+    header.nameCount = graph.m_namecount;
+    header.nameBytes = graph.m_nameOffsets[graph.m_namecount];
+
+    uint64_t sizes[SECTION_COUNT];
+    getSectionSizes(header, sizes);
+
+    uint64_t position = sizeof(header);
+
+    for(int section = 0 ; section < SECTION_COUNT ; ++section)
+    {
+	position = (position + SNAPSHOT_SECTION_ALIGNMENT - 1) / SNAPSHOT_SECTION_ALIGNMENT * SNAPSHOT_SECTION_ALIGNMENT;
+	header.sectionOffsets[section] = position;
+	position += sizes[section];
+    }
+
+    std::ofstream file(filepath, std::ios::binary | std::ios::trunc);
+
+    if(!file)
+    {
+	throw GraphSnapshotException("Failed to create snapshot file");
+    }
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    position = sizeof(header);
+
+    // pad the file with zeros up to the start of a section
+    auto startSection = [&](int section)
+    {
+	static const char zeros[SNAPSHOT_SECTION_ALIGNMENT] = {0};
+
+	file.write(zeros, header.sectionOffsets[section] - position);
+	position = header.sectionOffsets[section] + sizes[section];
+    };
+
+    // neighbours of one row, collected so they can be written in one go
+    std::vector<MatrixIndex> row;
+    auto appendToRow = [&row](MatrixIndex neighbour)
+    {
+	row.push_back(neighbour);
+    };
+
+    // write one direction of the graph, closing up the slack in each row
+    auto writeLists = [&](int firstSection, const MatrixIndex* degrees, bool outbound)
+    {
+	startSection(firstSection);
+
+	EdgeIndex offset = 0;
+
+	for(MatrixIndex i = 0 ; i < nodecount ; ++i)
+	{
+	    file.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+	    offset += degrees[i];
+	}
+
+	file.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+
+	startSection(firstSection + 1);
+	file.write(reinterpret_cast<const char*>(degrees), sizes[firstSection + 1]);
+
+	startSection(firstSection + 2);
+
+	for(MatrixIndex i = 0 ; i < nodecount ; ++i)
+	{
+	    row.clear();
+
+	    if(outbound)
+	    {
+		graph.forEachOutNeighbour(i, appendToRow);
+	    }
+	    else
+	    {
+		graph.forEachInNeighbour(i, appendToRow);
+	    }
+
+	    file.write(reinterpret_cast<const char*>(row.data()), row.size() * sizeof(MatrixIndex));
+	}
+    };
+
+    writeLists(OUT_OFFSETS, graph.m_outDegree, true);
+    writeLists(IN_OFFSETS, graph.m_inDegree, false);
+
+    startSection(NAME_OFFSETS);
+    file.write(reinterpret_cast<const char*>(graph.m_nameOffsets), sizes[NAME_OFFSETS]);
+
+    startSection(NAMES);
+    file.write(graph.m_names, sizes[NAMES]);
+
+    if(!file.flush())
+    {
+	throw GraphSnapshotException("Failed to write snapshot file");
+    }
+}
+
+// Replace the contents of a graph with a snapshot. The file is mapped
+// copy-on-write and the graph's arrays point straight into the mapping,
+// so removing edges or vertices changes the graph in memory but never the
+// file. The mapping is kept until the graph is destroyed.
+void GraphSnapshot::load(const char* filepath, DirectedGraph& graph)
+{
+    METRICS_PHASE("load_snapshot");
+
+    std::unique_ptr<MappedFile> file(new MappedFile());
+
+    if(!file->open(filepath, MappedFile::COPY_ON_WRITE))
+    {
+	throw GraphSnapshotException("Failed to open snapshot file");
+    }
+
+    char* data = file->getWritableData();
+    Header header;
+
+    METRICS_COUNT("bytes_read", file->getSize());
+
+    if(file->getSize() < sizeof(header))
+    {
+	throw GraphSnapshotException("Snapshot file is truncated");
+    }
+
+    memcpy(&header, data, sizeof(header));
+
+    if(memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)))
+    {
+	throw GraphSnapshotException("File is not a graph snapshot");
+    }
+
+    if(header.version != SNAPSHOT_VERSION)
+    {
+	throw GraphSnapshotException("Unsupported snapshot version");
+    }
+
+    if(header.byteOrder != SNAPSHOT_BYTE_ORDER)
+    {
+	throw GraphSnapshotException("Snapshot was written on a machine with a different byte order");
+    }
+
+    if(header.nodeCount > 0xFFFFFFFFULL || header.nameCount > header.nodeCount)
+    {
+	throw GraphSnapshotException("Snapshot has an invalid node count");
+    }
+
+    // every section holds at least a byte per count, so a count larger
+    // than the file is corrupt, and checking first keeps the sizes from wrapping
+    if(header.nodeCount > file->getSize() || header.edgeCount > file->getSize() || header.nameBytes > file->getSize())
+    {
+	throw GraphSnapshotException("Snapshot file is truncated or corrupt");
+    }
+
+    uint64_t sizes[SECTION_COUNT];
+    getSectionSizes(header, sizes);
+
+    for(int section = 0 ; section < SECTION_COUNT ; ++section)
+    {
+	uint64_t offset = header.sectionOffsets[section];
+
+	if(offset % SNAPSHOT_SECTION_ALIGNMENT || offset > file->getSize() || sizes[section] > file->getSize() - offset)
+	{
+	    throw GraphSnapshotException("Snapshot file is truncated or corrupt");
+	}
+    }
+
+    MatrixIndex nodecount = header.nodeCount;
+    EdgeIndex* outOffsets = reinterpret_cast<EdgeIndex*>(data + header.sectionOffsets[OUT_OFFSETS]);
+    EdgeIndex* inOffsets = reinterpret_cast<EdgeIndex*>(data + header.sectionOffsets[IN_OFFSETS]);
+    const uint64_t* nameOffsets = reinterpret_cast<const uint64_t*>(data + header.sectionOffsets[NAME_OFFSETS]);
+
+    MatrixIndex* outDegrees = reinterpret_cast<MatrixIndex*>(data + header.sectionOffsets[OUT_DEGREES]);
+    MatrixIndex* outNeighbours = reinterpret_cast<MatrixIndex*>(data + header.sectionOffsets[OUT_NEIGHBOURS]);
+    MatrixIndex* inDegrees = reinterpret_cast<MatrixIndex*>(data + header.sectionOffsets[IN_DEGREES]);
+    MatrixIndex* inNeighbours = reinterpret_cast<MatrixIndex*>(data + header.sectionOffsets[IN_NEIGHBOURS]);
+
+    // One pass over the nodes, so every row and name is known to lie within
+    // the file. The neighbours are left for checkNeighbours() or, a row at a
+    // time, checkOutNeighbours(), as checking them reads every page of them.
+    if(!isValidRowLayout(nodecount, header.edgeCount, outOffsets, outDegrees)
+       || !isValidRowLayout(nodecount, header.edgeCount, inOffsets, inDegrees)
+       || !isValidNameTable(header.nameCount, header.nameBytes, nameOffsets))
+    {
+	throw GraphSnapshotException("Snapshot file is corrupt");
+    }
+
+    graph.m_outOffsets = outOffsets;
+    graph.m_outDegree = outDegrees;
+    graph.m_outNeighbours = outNeighbours;
+    graph.m_inOffsets = inOffsets;
+    graph.m_inDegree = inDegrees;
+    graph.m_inNeighbours = inNeighbours;
+    graph.m_nameOffsets = nameOffsets;
+    graph.m_names = data + header.sectionOffsets[NAMES];
+    graph.m_nodecount = nodecount;
+    graph.m_edgecount = header.edgeCount;
+    graph.m_namecount = header.nameCount;
+    graph.m_uncheckedNeighbours = true;
+
+    // drop anything the graph held before
+    DirectedGraph::Offsets().swap(graph.m_outOffsetStorage);
+    DirectedGraph::Degrees().swap(graph.m_outDegreeStorage);
+    DirectedGraph::Neighbours().swap(graph.m_outNeighbourStorage);
+    DirectedGraph::Offsets().swap(graph.m_inOffsetStorage);
+    DirectedGraph::Degrees().swap(graph.m_inDegreeStorage);
+    DirectedGraph::Neighbours().swap(graph.m_inNeighbourStorage);
+    DirectedGraph::Edges().swap(graph.m_pendingEdges);
+    graph.m_dense.reset();
+    graph.m_compressed.reset();
+    std::vector<uint64_t>().swap(graph.m_nameOffsetStorage);
+    std::vector<char>().swap(graph.m_nameStorage);
+
+    graph.m_snapshot = std::move(file);
+}
+
+// Check every neighbour of a graph loaded from a snapshot, in one pass over
+// the neighbour arrays. Callers about to read every edge anyway call this
+// straight after loading, so the pass only brings the page faults forward.
+void GraphSnapshot::checkNeighbours(DirectedGraph& graph)
+{
+    if(!graph.m_uncheckedNeighbours)
+    {
+	return;
+    }
+
+    METRICS_PHASE("check_snapshot");
+
+    for(MatrixIndex node = 0 ; node < graph.m_nodecount ; ++node)
+    {
+	if(!isValidRow(graph.m_nodecount, graph.m_outNeighbours + graph.m_outOffsets[node], graph.m_outDegree[node])
+	   || !isValidRow(graph.m_nodecount, graph.m_inNeighbours + graph.m_inOffsets[node], graph.m_inDegree[node]))
+	{
+	    throw GraphSnapshotException("Snapshot file is corrupt");
+	}
+    }
+
+    graph.m_uncheckedNeighbours = false;
+}
+
+// Check the outbound neighbours of one node of a graph loaded from a
+// snapshot, for callers that only read the rows of a few nodes
+void GraphSnapshot::checkOutNeighbours(const DirectedGraph& graph, MatrixIndex node)
+{
+    if(graph.m_uncheckedNeighbours &&
+       !isValidRow(graph.m_nodecount, graph.m_outNeighbours + graph.m_outOffsets[node], graph.m_outDegree[node]))
+    {
+	throw GraphSnapshotException("Snapshot file is corrupt");
+    }
+}
@@ -0,0 +1,100 @@
+/****************************************************************
+Reads and writes graph snapshots. A snapshot is a binary file
+holding a graph's sparse row and column arrays and its node name
+string table, laid out exactly as the graph holds them in memory.
+Loading a snapshot maps the file copy-on-write and points the
+graph at the arrays in the mapping, so nothing is parsed or copied.
+Loading checks the row offsets, degrees and name table in a pass over
+the nodes; the neighbours, which are most of the file, are checked
+only when they are first read, so loading reads no neighbour pages.
+****************************************************************/
+
+#ifndef GRAPHSNAPSHOT_H
+#define GRAPHSNAPSHOT_H
+
+#include "directedgraph.h"
+
+#include <stdint.h>
+#include <string>
+#include <exception>
+
+// the first 8 bytes of every snapshot
+#define SNAPSHOT_MAGIC "PRGRAPH"
+// bumped whenever the layout of a snapshot changes
+#define SNAPSHOT_VERSION 1
+// written in native byte order to detect snapshots from other machines
+#define SNAPSHOT_BYTE_ORDER 0x01020304
+// every section starts on a multiple of this many bytes
+#define SNAPSHOT_SECTION_ALIGNMENT 64
+
+// Exception class for unreadable or invalid snapshots
+class GraphSnapshotException : public std::exception
+{
+    public:
+	GraphSnapshotException():std::exception(){}
+	GraphSnapshotException(const char* message):std::exception(),m_message(message){}
+	virtual ~GraphSnapshotException() throw(){}
+	virtual const char* what() const throw()
+	{
+	    return m_message.c_str();
+	}
+
+    private:
+	std::string m_message;
+};
+
+// class for saving graphs to and loading graphs from snapshot files
+class GraphSnapshot
+{
+    public:
+	// returns true if the file starts like a snapshot
+	static bool isSnapshot(const char* filepath);
+	// write the graph to a snapshot file
+	static void write(const DirectedGraph& graph, const char* filepath);
+	// replace the contents of a graph with a mapped snapshot, leaving its neighbours unchecked
+	static void load(const char* filepath, DirectedGraph& graph);
+	// check every neighbour of a graph loaded from a snapshot, if they are not yet checked
+	static void checkNeighbours(DirectedGraph& graph);
+	// check the outbound neighbours of one node of a graph loaded from a snapshot
+	static void checkOutNeighbours(const DirectedGraph& graph, MatrixIndex node);
+
+    private:
+	// the sections of a snapshot, in the order they appear in the file
+	enum Section
+	{
+	    OUT_OFFSETS,
+	    OUT_DEGREES,
+	    OUT_NEIGHBOURS,
+	    IN_OFFSETS,
+	    IN_DEGREES,
+	    IN_NEIGHBOURS,
+	    NAME_OFFSETS,
+	    NAMES,
+	    SECTION_COUNT
+	};
+
+	// start of every snapshot, followed by the sections
+	struct Header
+	{
+	    char magic[8];
+	    uint32_t version;
+	    uint32_t byteOrder;
+	    uint64_t nodeCount;
+	    uint64_t edgeCount;
+	    uint64_t nameCount;
+	    uint64_t nameBytes;
+	    // byte offset of each section from the start of the file
+	    uint64_t sectionOffsets[SECTION_COUNT];
+	};
+
+	// size in bytes of each section for the counts in a header
+	static void getSectionSizes(const Header& header, uint64_t sizes[SECTION_COUNT]);
+	// returns true if the rows lie back to back in a neighbour array of edgecount entries
+	static bool isValidRowLayout(MatrixIndex nodecount, EdgeIndex edgecount, const EdgeIndex* offsets, const MatrixIndex* degrees);
+	// returns true if a row holds nodes of the graph in increasing order
+	static bool isValidRow(MatrixIndex nodecount, const MatrixIndex* row, MatrixIndex degree);
+	// returns true if the names lie one after another within the string table
+	static bool isValidNameTable(MatrixIndex namecount, uint64_t namebytes, const uint64_t* nameOffsets);
+};
+
+#endif
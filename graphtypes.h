@@ -0,0 +1,14 @@
+/****************************************************************
+Index types shared by the graph classes.
+****************************************************************/
+
+#ifndef GRAPHTYPES_H
+#define GRAPHTYPES_H
+
+#include <stdint.h>
+
+typedef uint32_t MatrixIndex;
+// index into the neighbour arrays (may exceed 32 bits on large graphs)
+typedef uint64_t EdgeIndex;
+
+#endif
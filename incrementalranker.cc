@@ -0,0 +1,528 @@
+/****************************************************************
+Keeps the page rank of a graph up to date as edges are added and
+removed, without ranking it again from scratch. Alongside the rank
+of every node it keeps the node's residual, how far the rank is
+from satisfying the page rank equation, which a change to a node's
+outbound links moves for the nodes it linked to and now links to.
+Only nodes whose residual is then too large push it on to their
+out-neighbours, so the work follows the rank mass the change moved
+rather than the size of the graph. Once the mass moved since the
+last full ranking passes a bound the graph is ranked in full again,
+starting from the current ranks.
+****************************************************************/
+
+#include "incrementalranker.h"
+#include "logger.h"
+#include "metrics.h"
+
+#include <algorithm>
+#include <math.h>
+
+IncrementalRanker::IncrementalRanker():m_rankedNodeCount(0),m_decayFactor(0),m_iterations(0),m_teleport(0),m_rankScale(1),m_pushThreshold(0),
+				       m_tolerance(INCREMENTAL_DEFAULT_TOLERANCE),m_drift(0),m_maxDrift(INCREMENTAL_DEFAULT_MAX_DRIFT),
+				       m_threadPool(NULL){}
+
+// Set the pool of threads used for full rankings. The pool must outlive
+// the ranker. If no pool is set ranking runs on the calling thread.
+void IncrementalRanker::setThreadPool(ThreadPool* threadpool)
+{
+    m_threadPool = threadpool;
+}
+
+// Full rankings stop once the L1 residual is below the tolerance and
+// updates push residuals until every node's is below its share of it
+void IncrementalRanker::setTolerance(PageRank tolerance)
+{
+    m_tolerance = tolerance;
+}
+
+// rank the graph in full again once updates have added this much residual mass
+void IncrementalRanker::setMaxDrift(PageRank maxdrift)
+{
+    m_maxDrift = maxdrift;
+}
+
+// returns true if a node has any link, isolated nodes are not ranked
+bool IncrementalRanker::isRanked(const DirectedGraph& graph, MatrixIndex node)
+{
+    return graph.getOutDegree(node) || graph.getInDegree(node);
+}
+
+// Calculate the page rank of every node as PageRanker does, nodes with no
+// links at all are ignored and the rank of nodes with no outbound links is
+// lost, iterating until the L1 residual is below tolerance or for at most
+// the given number of iterations. Later full rankings run the same way.
+void IncrementalRanker::rankGraphNodes(const DirectedGraph& graph, float decayfactor, uint32_t iterations)
+{
+    METRICS_PHASE("rank");
+
+    LOG_SUMMARY("########################\n");
+    LOG_SUMMARY("Calculating page rank...\n");
+    LOG_SUMMARY("########################\n");
+
+    MatrixIndex numberOfNodes = graph.getNodeCount();
+    ThreadPool serialThreadPool(1);
+
+    m_decayFactor = decayfactor;
+    m_iterations = iterations;
+    m_ranked.assign(numberOfNodes, false);
+    m_rankedNodeCount = 0;
+
+    for(MatrixIndex node = 0 ; node < numberOfNodes ; ++node)
+    {
+	m_ranked[node] = isRanked(graph, node);
+	m_rankedNodeCount += m_ranked[node];
+    }
+
+    LOG_SUMMARY(numberOfNodes - m_rankedNodeCount << " isolated nodes will be ignored\n\n");
+
+    m_teleport = m_rankedNodeCount ? (1 - (PageRank)decayfactor) / m_rankedNodeCount : 0;
+    m_pushThreshold = m_rankedNodeCount ? m_tolerance / m_rankedNodeCount : 0;
+    m_rankScale = 1;
+    m_pageRanks.assign(numberOfNodes, 0);
+    m_residuals.assign(numberOfNodes, 0);
+    m_queue.clear();
+    m_queued.assign(numberOfNodes, false);
+    m_drift = 0;
+
+    for(MatrixIndex node = 0 ; node < numberOfNodes ; ++node)
+    {
+	m_pageRanks[node] = m_ranked[node] ? (PageRank)1 / m_rankedNodeCount : 0;
+    }
+
+    uint32_t iterationsRun = iterate(graph, m_threadPool ? *m_threadPool : serialThreadPool);
+
+    METRICS_COUNT("iterations", iterationsRun);
+    METRICS_COUNT("edges_processed", graph.getEdgeCount() * iterationsRun);
+
+    LOG_SUMMARY("Ranked in " << iterationsRun << " iterations, L1 residual " << getResidualMass() << "\n\n");
+}
+
+// Iterate x = decay * (rank passed along inbound links) + teleport from the
+// current ranks. The residual of x is the next iterate less x, so each
+// iteration leaves every node's exact residual and the next iterate is
+// only taken while the residual is above tolerance. Returns the number
+// of iterations run, at least one.
+uint32_t IncrementalRanker::iterate(const DirectedGraph& graph, ThreadPool& threadPool)
+{
+    MatrixIndex numberOfNodes = graph.getNodeCount();
+    unsigned threadCount = threadPool.getThreadCount();
+
+    applyRankScale();
+
+    // rank each node passes along every one of its outbound links
+    std::vector<PageRank> contributions(numberOfNodes);
+    std::vector<PageRank> nextPageRanks(numberOfNodes);
+    std::vector<double> partialResiduals(threadCount);
+    std::vector<MatrixIndex> partitions;
+    PageRanker::partitionNodesByInboundLinks(graph, threadCount, partitions);
+
+    for(uint32_t iteration = 1 ; ; ++iteration)
+    {
+	threadPool.run([&](unsigned threadindex)
+	{
+	    MatrixIndex begin = (uint64_t)numberOfNodes * threadindex / threadCount;
+	    MatrixIndex end = (uint64_t)numberOfNodes * (threadindex + 1) / threadCount;
+
+	    for(MatrixIndex node = begin ; node < end ; ++node)
+	    {
+		MatrixIndex outDegree = graph.getOutDegree(node);
+		contributions[node] = outDegree ? m_pageRanks[node] / outDegree : 0;
+	    }
+	});
+
+	threadPool.run([&](unsigned threadindex)
+	{
+	    double residual = 0;
+
+	    for(MatrixIndex node = partitions[threadindex] ; node < partitions[threadindex + 1] ; ++node)
+	    {
+		PageRank rank = 0;
+
+		if(m_ranked[node])
+		{
+		    PageRank sum = 0;
+
+		    graph.forEachInNeighbour(node, [&sum, &contributions](MatrixIndex fromnode)
+		    {
+			sum += contributions[fromnode];
+		    });
+
+		    rank = m_decayFactor * sum + m_teleport;
+		}
+
+		nextPageRanks[node] = rank;
+		m_residuals[node] = rank - m_pageRanks[node];
+		residual += fabs(m_residuals[node]);
+	    }
+
+	    partialResiduals[threadindex] = residual;
+	});
+
+	double residual = 0;
+
+	for(unsigned threadindex = 0 ; threadindex < threadCount ; ++threadindex)
+	{
+	    residual += partialResiduals[threadindex];
+	}
+
+	if(residual <= m_tolerance || iteration >= m_iterations)
+	{
+	    return iteration;
+	}
+
+	m_pageRanks.swap(nextPageRanks);
+    }
+}
+
+// Multiply the stored ranks and residuals by the rank scale and reset it
+// to 1, before they are used unscaled by a full ranking
+void IncrementalRanker::applyRankScale()
+{
+    if(m_rankScale == 1)
+    {
+	return;
+    }
+
+    for(MatrixIndex node = 0 ; node < m_pageRanks.size() ; ++node)
+    {
+	m_pageRanks[node] *= m_rankScale;
+	m_residuals[node] *= m_rankScale;
+    }
+
+    m_rankScale = 1;
+}
+
+// Add delta to a node's stored residual, queueing the node if it needs
+// pushing. Like the stored ranks delta is in units of the rank scale.
+void IncrementalRanker::addResidual(MatrixIndex node, PageRank delta)
+{
+    m_residuals[node] += delta;
+
+    if(!m_queued[node] && fabs(m_residuals[node]) * m_rankScale > m_pushThreshold)
+    {
+	m_queued[node] = true;
+	m_queue.push_back(node);
+    }
+}
+
+// Add (sign 1) or take away (sign -1) the rank a node passes along each of
+// its outbound links from the residuals of the nodes it links to, noting
+// each residual changed and what it was before.
+void IncrementalRanker::moveOutboundRank(const DirectedGraph& graph, MatrixIndex node, PageRank sign, Residuals& changed)
+{
+    MatrixIndex outDegree = graph.getOutDegree(node);
+
+    if(!outDegree || m_pageRanks[node] == 0)
+    {
+	return;
+    }
+
+    PageRank share = sign * m_decayFactor * m_pageRanks[node] / outDegree;
+
+    graph.forEachOutNeighbour(node, [this, share, &changed](MatrixIndex tonode)
+    {
+	changed.push_back(std::make_pair(tonode, m_residuals[tonode]));
+	addResidual(tonode, share);
+    });
+}
+
+// Push residuals until no node's is above the threshold. Pushing a node's
+// residual adds it to the node's rank and passes decay times it on, split
+// evenly, to the nodes it links to, which keeps every residual exact. Each
+// push passes on at most decay times what it takes, so the total residual
+// shrinks geometrically and pushing stops.
+void IncrementalRanker::pushResiduals(const DirectedGraph& graph)
+{
+    uint64_t pushes = 0;
+    uint64_t edgesPushed = 0;
+
+    while(!m_queue.empty())
+    {
+	MatrixIndex node = m_queue.front();
+	m_queue.pop_front();
+	m_queued[node] = false;
+
+	PageRank residual = m_residuals[node];
+
+	// the residual may have shrunk again since the node was queued
+	if(fabs(residual) * m_rankScale <= m_pushThreshold)
+	{
+	    continue;
+	}
+
+	m_pageRanks[node] += residual;
+	m_residuals[node] = 0;
+	++pushes;
+
+	MatrixIndex outDegree = graph.getOutDegree(node);
+
+	if(outDegree)
+	{
+	    PageRank share = m_decayFactor * residual / outDegree;
+
+	    graph.forEachOutNeighbour(node, [this, share](MatrixIndex tonode)
+	    {
+		addResidual(tonode, share);
+	    });
+
+	    edgesPushed += outDegree;
+	}
+    }
+
+    METRICS_COUNT("pushes", pushes);
+    METRICS_COUNT("edges_pushed", edgesPushed);
+
+    LOG_SUMMARY("Pushed residuals from " << pushes << " nodes along " << edgesPushed << " links\n");
+}
+
+// Make a batch of edge changes to the graph and bring the ranks up to date.
+// The rank each changed source node passes along its outbound links is taken
+// out of the residuals of the nodes it linked to and, once the edges have
+// changed, added to those of the nodes it now links to; the net change of
+// those residuals is the drift the batch adds. Inserted edges go straight
+// into the graph's rows, which only occasionally need laying out again.
+// Nodes gaining their first link or losing their last change the number of
+// ranked nodes, and with it the teleport rank of every node. As the page
+// rank equation is linear in the teleport rank, scaling every rank and
+// residual by the new teleport rank over the old keeps each residual exact,
+// so rather than visiting every node the change multiplies the rank scale
+// the stored values are in. The residuals are then pushed
+// until each is small again, unless updates have added more residual mass
+// than the drift bound since the last full ranking, when the graph is ranked
+// in full again from the current ranks. Edges must join nodes already in
+// the graph.
+void IncrementalRanker::applyEdgeChanges(DirectedGraph& graph, const EdgeChanges& changes)
+{
+    METRICS_PHASE("incremental_update");
+
+    if(m_pageRanks.size() != graph.getNodeCount())
+    {
+	LOG_SUMMARY("Page rank has not yet been calculated\n");
+	return;
+    }
+
+    std::vector<MatrixIndex> sources;
+    std::vector<MatrixIndex> endpoints;
+
+    for(const Edges* edges : {&changes.deletions, &changes.insertions})
+    {
+	for(Edges::const_iterator iter = edges->begin() ; iter != edges->end() ; ++iter)
+	{
+	    sources.push_back(iter->first);
+	    endpoints.push_back(iter->first);
+	    endpoints.push_back(iter->second);
+	}
+    }
+
+    std::sort(sources.begin(), sources.end());
+    sources.erase(std::unique(sources.begin(), sources.end()), sources.end());
+    std::sort(endpoints.begin(), endpoints.end());
+    endpoints.erase(std::unique(endpoints.begin(), endpoints.end()), endpoints.end());
+
+    // residuals changed by moving rank, with what they were before
+    Residuals changed;
+
+    for(MatrixIndex node : sources)
+    {
+	moveOutboundRank(graph, node, -1, changed);
+    }
+
+    for(Edges::const_iterator iter = changes.deletions.begin() ; iter != changes.deletions.end() ; ++iter)
+    {
+	graph.removeEdge(iter->first, iter->second);
+    }
+
+    for(Edges::const_iterator iter = changes.insertions.begin() ; iter != changes.insertions.end() ; ++iter)
+    {
+	graph.insertEdge(iter->first, iter->second);
+    }
+
+    for(MatrixIndex node : sources)
+    {
+	moveOutboundRank(graph, node, 1, changed);
+    }
+
+    // A source keeping most of its links takes rank from and gives it back
+    // to the same nodes, so the drift is the net change of each residual.
+    // The first note of a node holds its residual before any change.
+    std::stable_sort(changed.begin(), changed.end(), [](const Residuals::value_type& a, const Residuals::value_type& b)
+    {
+	return a.first < b.first;
+    });
+
+    PageRank drift = 0;
+
+    for(Residuals::const_iterator iter = changed.begin() ; iter != changed.end() ; ++iter)
+    {
+	if(iter == changed.begin() || iter->first != (iter - 1)->first)
+	{
+	    drift += fabs(m_residuals[iter->first] - iter->second);
+	}
+    }
+
+    drift *= m_rankScale;
+
+    MatrixIndex rankedNodeCount = m_rankedNodeCount;
+
+    for(MatrixIndex node : endpoints)
+    {
+	if(isRanked(graph, node) != m_ranked[node])
+	{
+	    rankedNodeCount += m_ranked[node] ? -1 : 1;
+	}
+    }
+
+    PageRank teleport = rankedNodeCount ? (1 - (PageRank)m_decayFactor) / rankedNodeCount : 0;
+
+    if(teleport != m_teleport)
+    {
+	m_pushThreshold = rankedNodeCount ? m_tolerance / rankedNodeCount : 0;
+
+	// scaling leaves every residual exact, so adds no drift
+	if(m_teleport && teleport)
+	{
+	    m_rankScale *= teleport / m_teleport;
+	}
+    }
+
+    for(MatrixIndex node : endpoints)
+    {
+	bool ranked = isRanked(graph, node);
+
+	if(ranked == m_ranked[node])
+	{
+	    continue;
+	}
+
+	// a node which has lost its last link has a rank of exactly 0
+	if(ranked)
+	{
+	    addResidual(node, teleport / m_rankScale);
+	}
+	else
+	{
+	    m_pageRanks[node] = 0;
+	    m_residuals[node] = 0;
+	}
+
+	drift += teleport;
+	m_ranked[node] = ranked;
+    }
+
+    m_rankedNodeCount = rankedNodeCount;
+    m_teleport = teleport;
+    m_drift += drift;
+
+    LOG_SUMMARY("Applied " << changes.insertions.size() << " edge insertions and " << changes.deletions.size()
+		<< " deletions, moving " << drift << " of residual mass\n");
+
+    if(m_drift > m_maxDrift)
+    {
+	LOG_SUMMARY("Residual mass added since the last full ranking is above " << m_maxDrift << ", ranking in full again\n");
+
+	ThreadPool serialThreadPool(1);
+	uint32_t iterationsRun = iterate(graph, m_threadPool ? *m_threadPool : serialThreadPool);
+
+	// every residual is exact again, so nothing is waiting to be pushed
+	for(MatrixIndex node : m_queue)
+	{
+	    m_queued[node] = false;
+	}
+
+	m_queue.clear();
+	m_drift = 0;
+
+	METRICS_COUNT("full_rankings", 1);
+	METRICS_COUNT("iterations", iterationsRun);
+	LOG_SUMMARY("Ranked in " << iterationsRun << " iterations\n");
+    }
+    else
+    {
+	pushResiduals(graph);
+    }
+
+    LOG_SUMMARY("L1 residual " << getResidualMass() << "\n\n");
+}
+
+// returns the rank of a node
+IncrementalRanker::PageRank IncrementalRanker::getRank(MatrixIndex node) const
+{
+    return m_pageRanks[node] * m_rankScale;
+}
+
+// Returns the L1 norm of the residuals. The ranks are within it times
+// 1/(1 - decay) of the exact page rank, in L1 norm.
+IncrementalRanker::PageRank IncrementalRanker::getResidualMass() const
+{
+    PageRank mass = 0;
+
+    for(MatrixIndex node = 0 ; node < m_residuals.size() ; ++node)
+    {
+	mass += fabs(m_residuals[node]);
+    }
+
+    return mass * m_rankScale;
+}
+
+// Returns the count highest ranked nodes, highest first and nodes of
+// equal rank in their original index order
+std::vector<IncrementalRanker::RankedNode> IncrementalRanker::getTopRankedNodes(const DirectedGraph& graph, MatrixIndex count)
+{
+    if(m_pageRanks.empty())
+    {
+	return std::vector<RankedNode>();
+    }
+
+    ThreadPool serialThreadPool(1);
+    std::vector<RankedNode> top = PageRanker::selectTopRankedNodes(graph, m_pageRanks.data(), 1, count, m_threadPool ? *m_threadPool : serialThreadPool);
+
+    // scaling every rank alike leaves their order as it is
+    for(RankedNode& rankedNode : top)
+    {
+	rankedNode.rank *= m_rankScale;
+    }
+
+    return top;
+}
+
+// show the count highest ranked nodes
+void IncrementalRanker::dumpTopPageRank(const DirectedGraph& graph, MatrixIndex count)
+{
+    if(m_pageRanks.empty())
+    {
+	LOG_SUMMARY("Page rank has not yet been calculated\n");
+	return;
+    }
+
+    std::vector<RankedNode> top = getTopRankedNodes(graph, count);
+    std::ostream& out = Logger::getStream();
+
+    // the page ranks are the result so are written at every verbosity
+    out << "Rank | Node | PageRank\n";
+    for(MatrixIndex k = 0 ; k < top.size() ; ++k)
+    {
+	out << k + 1 << " " << top[k].name << " " << top[k].rank << "\n";
+    }
+}
+
+// print the page rank of every node with its name
+void IncrementalRanker::dumpPageRank(const DirectedGraph& graph)
+{
+    if(m_pageRanks.empty())
+    {
+	LOG_SUMMARY("Page rank has not yet been calculated\n");
+	return;
+    }
+
+    std::ostream& out = Logger::getStream();
+
+    // the page ranks are the result so are written at every verbosity,
+    // in the order the nodes had before any renumbering
+    out << "Node | PageRank\n";
+    for(MatrixIndex i = 0 ; i < graph.getNodeCount() ; ++i)
+    {
+	MatrixIndex node = graph.getCurrentIndex(i);
+	out << graph.getNodeName(node) << " " << getRank(node) << "\n";
+    }
+}
@@ -0,0 +1,119 @@
+/****************************************************************
+Keeps the page rank of a graph up to date as edges are added and
+removed, without ranking it again from scratch. Alongside the rank
+of every node it keeps the node's residual, how far the rank is
+from satisfying the page rank equation, which a change to a node's
+outbound links moves for the nodes it linked to and now links to.
+Only nodes whose residual is then too large push it on to their
+out-neighbours, so the work follows the rank mass the change moved
+rather than the size of the graph. Once the mass moved since the
+last full ranking passes a bound the graph is ranked in full again,
+starting from the current ranks.
+****************************************************************/
+
+#ifndef INCREMENTALRANKER_H
+#define INCREMENTALRANKER_H
+
+#include "directedgraph.h"
+#include "pageranker.h"
+#include "threadpool.h"
+
+#include <stdint.h>
+#include <vector>
+#include <utility>
+#include <deque>
+
+// L1 residual left by ranking when no tolerance is set
+#define INCREMENTAL_DEFAULT_TOLERANCE 1e-6
+
+// Residual mass updates may add, in total, before the graph is ranked in full again
+#define INCREMENTAL_DEFAULT_MAX_DRIFT 0.1
+
+class IncrementalRanker
+{
+    public:
+      typedef double PageRank;
+      typedef PageRanker::RankedNode RankedNode;
+      typedef std::vector<std::pair<MatrixIndex, MatrixIndex> > Edges;
+
+      // one batch of edge changes, the deletions are made before the insertions
+      struct EdgeChanges
+      {
+	  Edges insertions;
+	  Edges deletions;
+      };
+
+      IncrementalRanker();
+      virtual ~IncrementalRanker(){};
+      // rank using the threads of the given pool (NULL ranks on the calling thread only)
+      void setThreadPool(ThreadPool* threadpool);
+      // keep the L1 residual of the ranks below tolerance
+      void setTolerance(PageRank tolerance);
+      // rank the graph in full again once updates have moved this much residual mass
+      void setMaxDrift(PageRank maxdrift);
+      // calculate the page rank of every node from scratch
+      void rankGraphNodes(const DirectedGraph& graph, float decayfactor, uint32_t iterations);
+      // apply a batch of edge changes to the graph and bring the ranks up to date
+      void applyEdgeChanges(DirectedGraph& graph, const EdgeChanges& changes);
+
+      // returns the rank of a node
+      PageRank getRank(MatrixIndex node) const;
+      // returns the L1 norm of the residuals, which bounds the error of the ranks times 1/(1 - decay)
+      PageRank getResidualMass() const;
+      // the count highest ranked nodes, highest first, ties in original index order
+      std::vector<RankedNode> getTopRankedNodes(const DirectedGraph& graph, MatrixIndex count);
+      // show the count highest ranked nodes
+      void dumpTopPageRank(const DirectedGraph& graph, MatrixIndex count);
+      // print the page rank of every node with its name
+      void dumpPageRank(const DirectedGraph& graph);
+
+    private:
+      IncrementalRanker(const IncrementalRanker&);
+      IncrementalRanker& operator=(const IncrementalRanker&);
+
+      typedef std::vector<std::pair<MatrixIndex, PageRank> > Residuals;
+
+      // iterate from the current ranks until the residual is below tolerance,
+      // leaving every node's exact residual, returns the iterations run
+      uint32_t iterate(const DirectedGraph& graph, ThreadPool& threadPool);
+      // fold the rank scale into the stored ranks and residuals
+      void applyRankScale();
+      // add delta to a node's residual, queueing the node if it needs pushing
+      void addResidual(MatrixIndex node, PageRank delta);
+      // push queued residuals along outbound links until none is above the threshold
+      void pushResiduals(const DirectedGraph& graph);
+      // add or take away the rank a node passes along each of its outbound links,
+      // noting each residual changed and what it was before
+      void moveOutboundRank(const DirectedGraph& graph, MatrixIndex node, PageRank sign, Residuals& changed);
+      // returns true if a node has any link, isolated nodes are not ranked
+      static bool isRanked(const DirectedGraph& graph, MatrixIndex node);
+
+      // rank of each node, and how much less it is than the page rank equation
+      // gives it, both to be multiplied by m_rankScale
+      std::vector<PageRank> m_pageRanks;
+      std::vector<PageRank> m_residuals;
+      // whether each node has any links, and how many do
+      std::vector<bool> m_ranked;
+      MatrixIndex m_rankedNodeCount;
+      // nodes waiting to push their residual, and whether each node is waiting
+      std::deque<MatrixIndex> m_queue;
+      std::vector<bool> m_queued;
+
+      float m_decayFactor;
+      uint32_t m_iterations;
+      // (1 - decay)/(ranked node count), the rank each ranked node gets from random jumps
+      PageRank m_teleport;
+      // what the stored ranks and residuals are multiplied by, changed in place of
+      // every rank when the teleport rank changes and folded in by full rankings
+      PageRank m_rankScale;
+      // residual a node may keep without pushing it, tolerance over the ranked node count
+      PageRank m_pushThreshold;
+      PageRank m_tolerance;
+      // residual mass added by updates since the last full ranking, and its bound
+      PageRank m_drift;
+      PageRank m_maxDrift;
+      // threads used for full rankings, not owned by the ranker
+      ThreadPool* m_threadPool;
+};
+
+#endif
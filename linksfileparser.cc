@@ -1,165 +1,312 @@
 /****************************************************************
-Parses a text file with two strings per line where each string 
-represents a node in a directed graph with an edge (link) from 
-the first node to the second node. The nodes and their edges can 
-then be added to an instance of a graph class.
+Parses a text file with two strings per line where each string
+represents a node in a directed graph with an edge (link) from
+the first node to the second node. The nodes and their edges can
+then be added to an instance of a graph class. The file is memory
+mapped and tokenised in place, in parallel chunks when a thread
+pool is given. Nodes are given indices in the order they are first
+seen, optionally renumbered into name order.
 ****************************************************************/
 
 #include "linksfileparser.h"
+#include "logger.h"
+#include "metrics.h"
 
-#include <fstream>
 #include <string>
-#include <iostream>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
 #include <sstream>
 
-LinksFileParser::LinksFileParser(){}
+LinksFileParser::LinksFileParser():m_sortNodesByName(false),m_threadPool(NULL){}
+
+// Number nodes in lexicographic order of name, as older versions did,
+// rather than the order they are first seen in the file
+void LinksFileParser::setSortNodesByName(bool sort)
+{
+    m_sortNodesByName = sort;
+}
+
+// Set the pool of threads used by parseFile(). The pool must outlive
+// the parser. If no pool is set parsing runs on the calling thread.
+void LinksFileParser::setThreadPool(ThreadPool* threadpool)
+{
+    m_threadPool = threadpool;
+}
 
 // parses file and stores links and unique nodes
 void LinksFileParser::parseFile(char* filepath)
 {
+    METRICS_PHASE("parse");
+
     m_links.clear();
     m_nodes.clear();
-    m_nodeLookUp.clear();
 
-    std::cout << "####################" << std::endl;
-    std::cout << "Parsing file " << filepath << std::endl;
-    std::cout << "####################" << std::endl << std::endl;
+    LOG_SUMMARY("####################\n");
+    LOG_SUMMARY("Parsing file " << filepath << "\n");
+    LOG_SUMMARY("####################\n\n");
 
-    std::ifstream ifs(filepath, std::ifstream::in);
-    
-    if(ifs.fail())
+    MappedFile file;
+
+    if(!file.open(filepath))
     {
-	ifs.close();
 	throw LinksFileParserException("Failed to open file");
     }
 
-    std::string linkstring;
+    const char* position = file.getData();
+    const char* end = position + file.getSize();
+    uint64_t ignoredLines;
+
+    METRICS_COUNT("bytes_read", file.getSize());
 
-    // check eof,fail and bad bits are not set
-    while(ifs.good())
+    if(m_threadPool && m_threadPool->getThreadCount() > 1)
+    {
+	ignoredLines = parseChunksInParallel(position, end);
+    }
+    else
     {
-	getline(ifs,linkstring);
+	ignoredLines = parseChunk(position, end, m_nodes, m_links, Logger::getStream());
+    }
 
-        if(!linkstring.empty())
-        {
-	    std::stringstream linkss;
-	    linkss << linkstring;
+    if(ignoredLines)
+    {
+	LOG_SUMMARY("WARNING: Ignored " << ignoredLines << " lines without a link between two nodes\n");
+    }
 
-	    // std::cout << "linkstring " << linkstring << std::endl;
+    if(m_links.empty())
+    {
+	throw LinksFileParserException("No valid nodes read from file");
+    }
 
-	    std::string fromnode;
-	    std::string tonode;
+    if(m_sortNodesByName)
+    {
+	std::vector<NodeIndex> oldToNew;
+	m_nodes.renumberLexicographically(oldToNew);
 
-	    linkss >> fromnode;
-	    linkss >> tonode;
+	for(Links::iterator iter = m_links.begin() ; iter != m_links.end() ; ++iter)
+	{
+	    iter->from = oldToNew[iter->from];
+	    iter->to = oldToNew[iter->to];
+	}
+    }
 
-	    // std::cout << "From " << fromnode << std::endl;
-	    // std::cout << "To " << tonode << std::endl;
+    if(Logger::isEnabled(Logger::VERBOSITY_DEBUG))
+    {
+	for(NodeIndex index = 0 ; index < m_nodes.getNodeCount() ; ++index)
+	{
+	    LOG_DEBUG("Assigned node " << m_nodes.getName(index) << " index " << index << "\n");
+	}
+    }
 
-	    if(!fromnode.compare(tonode))
+    LOG_SUMMARY("\n");
+}
+
+// Parse the lines between begin and end (which must be the start of a line).
+// Nodes are given indices in nodes as they are first seen and the links are
+// appended to links. Returns the number of lines ignored, which are listed in
+// messages when debug output is on.
+uint64_t LinksFileParser::parseChunk(const char* begin, const char* end, NodeInterner& nodes, Links& links, std::ostream& messages)
+{
+    const char* position = begin;
+    bool listIgnoredLines = Logger::isEnabled(Logger::VERBOSITY_DEBUG);
+    uint64_t ignoredLines = 0;
+
+    while(position < end)
+    {
+	const char* lineEnd = static_cast<const char*>(memchr(position, '\n', end - position));
+
+	if(!lineEnd)
+	{
+	    lineEnd = end;
+	}
+
+	Node fromnode = nextToken(position, lineEnd);
+	Node tonode = nextToken(position, lineEnd);
+
+	// skip blank lines
+	if(!fromnode.empty())
+	{
+	    if(fromnode == tonode)
 	    {
-		std::cout << "Ignoring link to self for node " << fromnode << std::endl;
+		++ignoredLines;
+
+		if(listIgnoredLines)
+		{
+		    messages << "Ignoring link to self for node " << fromnode << "\n";
+		}
 	    }
 	    else if(tonode.empty())
 	    {
-		std::cout << "Ignoring node with no link " << fromnode << std::endl;
+		++ignoredLines;
+
+		if(listIgnoredLines)
+		{
+		    messages << "Ignoring node with no link " << fromnode << "\n";
+		}
 	    }
 	    else
 	    {
-		Link link = {fromnode, tonode};
-		m_links.push_back(link);
-		m_nodes.push_back(fromnode);
-		m_nodes.push_back(tonode);
+		Link link = {nodes.intern(fromnode), nodes.intern(tonode)};
+		links.push_back(link);
 	    }
 	}
+
+	position = lineEnd + 1;
     }
 
-    if(m_nodes.empty())
+    return ignoredLines;
+}
+
+// Split the file into one chunk of whole lines per thread and parse the chunks
+// in parallel, each thread numbering the nodes it sees in its own interner.
+// The interners are then merged in chunk order and each chunk's links are
+// renumbered into the merged indices, so nodes get the same indices and
+// links are in the same order as when the file is parsed on one thread.
+// Returns the number of lines ignored.
+uint64_t LinksFileParser::parseChunksInParallel(const char* begin, const char* end)
+{
+    unsigned threadCount = m_threadPool->getThreadCount();
+    std::vector<const char*> boundaries(threadCount + 1, end);
+
+    boundaries[0] = begin;
+
+    for(unsigned chunk = 1 ; chunk < threadCount ; ++chunk)
     {
-	ifs.close();
-	throw LinksFileParserException("No valid nodes read from file");
+	const char* position = std::max(begin + (end - begin) / threadCount * chunk, boundaries[chunk - 1]);
+	const char* lineEnd = static_cast<const char*>(memchr(position, '\n', end - position));
+
+	boundaries[chunk] = lineEnd ? lineEnd + 1 : end;
     }
-  
-    m_nodes.sort();
-    m_nodes.unique();
 
-    Nodes::const_iterator iter = m_nodes.begin();
+    // chunk 0 is parsed straight into the parser's own nodes and links
+    std::vector<NodeInterner> chunkNodes(threadCount);
+    std::vector<Links> chunkLinks(threadCount);
+    std::vector<std::ostringstream> chunkMessages(threadCount);
+    std::vector<uint64_t> chunkIgnoredLines(threadCount);
+
+    m_threadPool->run([&](unsigned threadindex)
+    {
+	NodeInterner& nodes = threadindex ? chunkNodes[threadindex] : m_nodes;
+	Links& links = threadindex ? chunkLinks[threadindex] : m_links;
+
+	chunkIgnoredLines[threadindex] = parseChunk(boundaries[threadindex], boundaries[threadindex + 1], nodes, links, chunkMessages[threadindex]);
+    });
+
+    uint64_t ignoredLines = 0;
 
-    // Assign each node a unique index. This will be used to look the node
-    // up in the adjacency matrix
-    for(NodeIndex index = 0 ; iter != m_nodes.end() ; ++iter, ++index)
+    for(unsigned chunk = 0 ; chunk < threadCount ; ++chunk)
     {
-        m_nodeLookUp.insert(std::pair<Node, NodeIndex>(*iter, index));
-        std::cout << "Assigned node " << *iter << " index " << index << std::endl;
+	LOG_DEBUG(chunkMessages[chunk].str());
+	ignoredLines += chunkIgnoredLines[chunk];
     }
-    
-    std::cout << std::endl;
 
-    ifs.close();
+    // give each chunk's nodes their index in the merged interner
+    std::vector<std::vector<NodeIndex> > localToGlobal(threadCount);
+    std::vector<size_t> linkOffsets(threadCount + 1, 0);
+
+    linkOffsets[1] = m_links.size();
+
+    for(unsigned chunk = 1 ; chunk < threadCount ; ++chunk)
+    {
+	NodeIndex nodecount = chunkNodes[chunk].getNodeCount();
+	localToGlobal[chunk].resize(nodecount);
+
+	for(NodeIndex index = 0 ; index < nodecount ; ++index)
+	{
+	    localToGlobal[chunk][index] = m_nodes.intern(chunkNodes[chunk].getName(index));
+	}
+
+	linkOffsets[chunk + 1] = linkOffsets[chunk] + chunkLinks[chunk].size();
+    }
+
+    // renumber and append the other chunks' links in parallel
+    m_links.resize(linkOffsets[threadCount]);
+
+    m_threadPool->run([&](unsigned threadindex)
+    {
+	if(threadindex)
+	{
+	    const std::vector<NodeIndex>& remap = localToGlobal[threadindex];
+	    Links::iterator output = m_links.begin() + linkOffsets[threadindex];
+
+	    for(Links::const_iterator iter = chunkLinks[threadindex].begin() ; iter != chunkLinks[threadindex].end() ; ++iter, ++output)
+	    {
+		output->from = remap[iter->from];
+		output->to = remap[iter->to];
+	    }
+
+	    Links().swap(chunkLinks[threadindex]);
+	}
+    });
+
+    return ignoredLines;
+}
+
+// Returns the next whitespace separated token before end, or an empty token
+// if there is none. position is moved past the token.
+LinksFileParser::Node LinksFileParser::nextToken(const char*& position, const char* end)
+{
+    while(position < end && isspace(static_cast<unsigned char>(*position)))
+    {
+	++position;
+    }
+
+    const char* tokenStart = position;
+
+    while(position < end && !isspace(static_cast<unsigned char>(*position)))
+    {
+	++position;
+    }
+
+    return Node(tokenStart, position - tokenStart);
 }
 
 // Returns the number of unique nodes read in from file
 uint32_t LinksFileParser::getNodeCount()
 {
-    return m_nodes.size();
+    return m_nodes.getNodeCount();
 }
 
-// Adds nodes read from a text file to a directed graph and populates a lookup 
+// Adds nodes read from a text file to a directed graph and populates a lookup
 // table stored in the graph
 void LinksFileParser::addNodesToGraph(DirectedGraph& graph)
-{    
-    // need to get indexes into the adjacency matrix for the nodes in each link
-    NodeLookUp::const_iterator fromNodeLookUpIter;
-    NodeLookUp::const_iterator toNodeLookUpIter;
+{
+    METRICS_PHASE("build");
 
     for(Links::const_iterator linksIter = m_links.begin() ; linksIter != m_links.end() ; ++linksIter)
     {
-	// find the index of the 'from' node into the adjacency matrix
-        fromNodeLookUpIter = m_nodeLookUp.find(linksIter->from);
-	// find the index of the 'to' node into the adjacency matrix
-	toNodeLookUpIter = m_nodeLookUp.find(linksIter->to);
-	
-	if(fromNodeLookUpIter != m_nodeLookUp.end() && toNodeLookUpIter != m_nodeLookUp.end())
-	{
-	    NodeIndex fromNodeIndex = fromNodeLookUpIter->second;
-	    NodeIndex toNodeIndex = toNodeLookUpIter->second;
+	LOG_DEBUG("Adding edge " << linksIter->from << " (" << m_nodes.getName(linksIter->from) << ")"
+		  << " -> " << linksIter->to << " (" << m_nodes.getName(linksIter->to) << ") \n");
 
-	    // ignore duplicate edges
-	    if(graph.isEdge(fromNodeIndex, toNodeIndex))
-	    {
-		std::cout << "WARNING: There is already an edge " << fromNodeIndex << " (" << linksIter->from << ")"
-		          << " -> " << toNodeIndex << " (" << linksIter->to << ") " << std::endl;
-	    }
-	    else
-	    {
-		std::cout << "Adding edge " << fromNodeIndex << " (" << linksIter->from << ")"
-		          << " -> " << toNodeIndex << " (" << linksIter->to << ") " << std::endl;
-		
-		// add edge to graph
-		graph.addEdge(fromNodeIndex, toNodeIndex);
-	    }
-	}
-	else
-	{
-	    if(fromNodeLookUpIter == m_nodeLookUp.end())
-	    {
-	        std::cout << "WARNING: Unable to find adjacency matrix index for node " << linksIter->from << std::endl;
-		std::cout << "Node will not be added to the graph" << std::endl;
-	    }
+	// add edge to graph (duplicates are dropped when the graph is finalised)
+	graph.addEdge(linksIter->from, linksIter->to);
+    }
 
-	    if(toNodeLookUpIter == m_nodeLookUp.end())
-	    {
-	        std::cout << "WARNING: Unable to find adjacency matrix index for node " << linksIter->to << std::endl;
-		std::cout << "Node will not be added to the graph" << std::endl;
-	    }
-	}
+    // build the graph from the edges added above
+    EdgeIndex duplicates = graph.finalise();
+
+    if(duplicates)
+    {
+	LOG_SUMMARY("WARNING: Ignored " << duplicates << " duplicate edges\n");
+    }
+
+    METRICS_COUNT("links_parsed", m_links.size());
+    METRICS_COUNT("edges", graph.getEdgeCount());
+
+    if(graph.isCompressed())
+    {
+	LOG_SUMMARY("Graph edges are stored gap encoded in " << graph.getEdgeStorageSize() << " bytes\n");
+    }
+    else
+    {
+	LOG_SUMMARY("Graph edges are stored " << (graph.isDense() ? "as a dense bit matrix" : "as sparse rows and columns") << "\n");
     }
 
-    std::cout << std::endl;
+    LOG_SUMMARY("\n");
 
-    // Add the index of each node and the node name to a lookup table (index->node) in the graph.
-    for(NodeLookUp::const_iterator nodeToIndexIter =  m_nodeLookUp.begin() ; nodeToIndexIter !=  m_nodeLookUp.end() ; ++nodeToIndexIter)
+    // Add the name of each node, in index order, to the graph's string table
+    for(NodeIndex index = 0 ; index < m_nodes.getNodeCount() ; ++index)
     {
-        graph.addIndexToNodeLookup(nodeToIndexIter->second, nodeToIndexIter->first);
+	graph.addNodeName(m_nodes.getName(index));
     }
 }
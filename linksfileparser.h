@@ -2,18 +2,25 @@
 Parses a text file with two strings per line where each string 
 represents a node in a directed graph with an edge (link) from 
 the first node to the second node. The nodes and their edges can 
-then be added to an instance of a graph class.
+then be added to an instance of a graph class. The file is memory
+mapped and tokenised in place, in parallel chunks when a thread
+pool is given. Nodes are given indices in the order they are first
+seen, optionally renumbered into name order.
 ****************************************************************/
 
 #ifndef LINKSFILEPARSER_H
 #define LINKSFILEPARSER_H
 
 #include "directedgraph.h"
+#include "mappedfile.h"
+#include "nodeinterner.h"
+#include "threadpool.h"
 
-#include <list>
+#include <vector>
 #include <string>
-#include <map>
+#include <string_view>
 #include <exception>
+#include <ostream>
 
 // Exception class for errors in file parsing
 class LinksFileParserException : public std::exception
@@ -38,6 +45,10 @@ class LinksFileParser
     public:
 	LinksFileParser();
 	virtual ~LinksFileParser(){};
+	// number nodes in lexicographic order of name rather than the order they are first seen
+	void setSortNodesByName(bool sort);
+	// parse using the threads of the given pool (NULL parses on the calling thread only)
+	void setThreadPool(ThreadPool* threadpool);
 	// parses file and stores links and unique nodes
         void parseFile(char* filepath);
 	// add nodes to the graph
@@ -46,25 +57,36 @@ class LinksFileParser
 	uint32_t getNodeCount();
 
     private:
-        typedef std::string Node;
+	// shards are built by tokenising links files the same way
+	friend class ShardedGraph;
 
+	typedef std::string_view Node;
+	typedef NodeInterner::NodeIndex NodeIndex;
+
+	// a link as the indices of the nodes at each end
 	struct Link
 	{
-	    Node from;
-	    Node to;
+	    NodeIndex from;
+	    NodeIndex to;
 	};
 
-	typedef uint32_t NodeIndex;
-	typedef std::list<Link> Links;
-	typedef std::list<Node> Nodes;
-	typedef std::map<Node, NodeIndex> NodeLookUp;
+	typedef std::vector<Link> Links;
+
+	// returns the next whitespace separated token before end and moves position past it
+	static Node nextToken(const char*& position, const char* end);
+	// parse the whole lines between begin and end, returns how many were ignored
+	static uint64_t parseChunk(const char* begin, const char* end, NodeInterner& nodes, Links& links, std::ostream& messages);
+	// parse chunks of the file on each thread of the pool and merge the results
+	uint64_t parseChunksInParallel(const char* begin, const char* end);
 
-	// list of links from file
+	// links from file
 	Links m_links;
-	// list of unique nodes from file
-	Nodes m_nodes;
-	// map a node to it's assigned index
-	NodeLookUp m_nodeLookUp;
+	// unique nodes from file and their indices
+	NodeInterner m_nodes;
+	// renumber nodes into name order after parsing
+	bool m_sortNodesByName;
+	// threads used for parsing, not owned by the parser
+	ThreadPool* m_threadPool;
 };
       
 
@@ -0,0 +1,90 @@
+/****************************************************************
+Leveled, buffered program output. Messages are written through
+the LOG_ macros, which test the verbosity before evaluating any of
+the message, so a suppressed message costs one comparison and no
+formatting. Output collects in a large buffer which is written to
+standard out a block at a time rather than a line at a time.
+****************************************************************/
+
+#include "logger.h"
+
+#include <streambuf>
+#include <vector>
+#include <cstdio>
+
+Logger::Verbosity Logger::s_verbosity = Logger::VERBOSITY_SUMMARY;
+
+// Stream buffer which writes to standard out only when it is full or
+// flushed. Messages should end in "\n" rather than std::endl, which
+// flushes the stream.
+class BufferedSink : public std::streambuf
+{
+    public:
+	BufferedSink():m_buffer(LOG_BUFFER_SIZE)
+	{
+	    setp(m_buffer.data(), m_buffer.data() + m_buffer.size());
+	}
+
+	virtual ~BufferedSink()
+	{
+	    sync();
+	}
+
+    protected:
+	// the buffer is full, write it out and store the character
+	virtual int_type overflow(int_type character)
+	{
+	    if(sync() != 0)
+	    {
+		return traits_type::eof();
+	    }
+
+	    if(!traits_type::eq_int_type(character, traits_type::eof()))
+	    {
+		*pptr() = traits_type::to_char_type(character);
+		pbump(1);
+	    }
+
+	    return traits_type::not_eof(character);
+	}
+
+	// write out the buffer
+	virtual int sync()
+	{
+	    size_t size = pptr() - pbase();
+
+	    if(size && fwrite(pbase(), 1, size, stdout) != size)
+	    {
+		return -1;
+	    }
+
+	    setp(m_buffer.data(), m_buffer.data() + m_buffer.size());
+
+	    return fflush(stdout);
+	}
+
+    private:
+	std::vector<char> m_buffer;
+};
+
+// set how much is written
+void Logger::setVerbosity(Verbosity verbosity)
+{
+    s_verbosity = verbosity;
+}
+
+// Stream messages are written to. The buffer is flushed when the
+// program exits.
+std::ostream& Logger::getStream()
+{
+    static BufferedSink sink;
+    static std::ostream stream(&sink);
+
+    return stream;
+}
+
+// write out anything in the buffer
+void Logger::flush()
+{
+    getStream().flush();
+}
@@ -0,0 +1,63 @@
+/****************************************************************
+Leveled, buffered program output. Messages are written through
+the LOG_ macros, which test the verbosity before evaluating any of
+the message, so a suppressed message costs one comparison and no
+formatting. Output collects in a large buffer which is written to
+standard out a block at a time rather than a line at a time.
+****************************************************************/
+
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <ostream>
+
+// Size in bytes of the output buffer
+#define LOG_BUFFER_SIZE (1 << 16)
+
+// write a message to the log if the verbosity is at least the given level,
+// e.g. LOG_AT(Logger::VERBOSITY_DEBUG, "node " << name << "\n")
+#define LOG_AT(verbosity, message) \
+    do \
+    { \
+	if(Logger::isEnabled(verbosity)) \
+	{ \
+	    Logger::getStream() << message; \
+	} \
+    } \
+    while(0)
+
+// results and errors, always written
+#define LOG_RESULT(message) LOG_AT(Logger::VERBOSITY_QUIET, message)
+// progress and totals
+#define LOG_SUMMARY(message) LOG_AT(Logger::VERBOSITY_SUMMARY, message)
+// a line per node, edge or iteration
+#define LOG_DEBUG(message) LOG_AT(Logger::VERBOSITY_DEBUG, message)
+
+class Logger
+{
+    public:
+	// how much is written, each level includes everything below it
+	enum Verbosity
+	{
+	    VERBOSITY_QUIET,
+	    VERBOSITY_SUMMARY,
+	    VERBOSITY_DEBUG
+	};
+
+	// set how much is written (summary by default)
+	static void setVerbosity(Verbosity verbosity);
+	// returns true if messages of the given verbosity are written
+	static bool isEnabled(Verbosity verbosity)
+	{
+	    return verbosity <= s_verbosity;
+	}
+	// stream messages are written to, use the LOG_ macros rather than this
+	static std::ostream& getStream();
+	// write out anything in the buffer
+	static void flush();
+
+    private:
+	static Verbosity s_verbosity;
+};
+
+#endif
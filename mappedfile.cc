@@ -0,0 +1,110 @@
+/****************************************************************
+Memory mapping of a whole file, either read-only or copy-on-write
+so the contents can be changed in memory without touching the file.
+The mapping is released when the object is destroyed or another
+file is opened.
+****************************************************************/
+
+#include "mappedfile.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+MappedFile::MappedFile():m_data(NULL),m_size(0),m_access(SEQUENTIAL_READ){}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+// Map a file into memory. For sequential reads the kernel is told to read
+// ahead aggressively. A copy-on-write mapping is private, pages written to
+// are copied and the file itself is never changed, and the kernel is asked
+// to start reading the whole file in. Returns false if the file cannot be
+// opened or mapped.
+bool MappedFile::open(const char* filepath, Access access)
+{
+    close();
+    m_access = access;
+
+    int fd = ::open(filepath, O_RDONLY);
+
+    if(fd < 0)
+    {
+	return false;
+    }
+
+    struct stat filestat;
+
+    if(fstat(fd, &filestat) != 0)
+    {
+	::close(fd);
+	return false;
+    }
+
+    m_size = filestat.st_size;
+
+    if(m_size)
+    {
+	int protection = access == COPY_ON_WRITE ? PROT_READ | PROT_WRITE : PROT_READ;
+
+	m_data = mmap(NULL, m_size, protection, MAP_PRIVATE, fd, 0);
+
+	if(m_data == MAP_FAILED)
+	{
+	    m_data = NULL;
+	    m_size = 0;
+	    ::close(fd);
+	    return false;
+	}
+
+	madvise(m_data, m_size, access == COPY_ON_WRITE ? MADV_WILLNEED : MADV_SEQUENTIAL);
+    }
+
+    // the mapping stays valid after the descriptor is closed
+    ::close(fd);
+
+    return true;
+}
+
+// unmap the file
+void MappedFile::close()
+{
+    if(m_data)
+    {
+	munmap(m_data, m_size);
+    }
+
+    m_data = NULL;
+    m_size = 0;
+}
+
+// Ask the kernel to start reading the whole file in without waiting for
+// it, so a file mapped ahead of use is read while other work is done
+void MappedFile::prefetch()
+{
+    if(m_data)
+    {
+	madvise(m_data, m_size, MADV_WILLNEED);
+    }
+}
+
+// start of the file contents (NULL for an empty or unopened file)
+const char* MappedFile::getData() const
+{
+    return static_cast<const char*>(m_data);
+}
+
+// writable start of the file contents (NULL unless mapped copy-on-write)
+char* MappedFile::getWritableData()
+{
+    return m_access == COPY_ON_WRITE ? static_cast<char*>(m_data) : NULL;
+}
+
+// size of the file in bytes
+size_t MappedFile::getSize() const
+{
+    return m_size;
+}
@@ -0,0 +1,52 @@
+/****************************************************************
+Memory mapping of a whole file, either read-only or copy-on-write
+so the contents can be changed in memory without touching the file.
+The mapping is released when the object is destroyed or another
+file is opened.
+****************************************************************/
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <stdint.h>
+#include <cstddef>
+
+class MappedFile
+{
+    public:
+	// how the mapping will be used
+	enum Access
+	{
+	    // read once from start to end
+	    SEQUENTIAL_READ,
+	    // read in any order and written to privately
+	    COPY_ON_WRITE
+	};
+
+	MappedFile();
+	virtual ~MappedFile();
+
+	// map a file into memory, returns false if it cannot be opened or mapped
+	bool open(const char* filepath, Access access = SEQUENTIAL_READ);
+	// unmap the file
+	void close();
+	// ask the kernel to start reading the whole file in
+	void prefetch();
+
+	// start of the file contents (NULL for an empty or unopened file)
+	const char* getData() const;
+	// writable start of the file contents (NULL unless mapped copy-on-write)
+	char* getWritableData();
+	// size of the file in bytes
+	size_t getSize() const;
+
+    private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	void* m_data;
+	size_t m_size;
+	Access m_access;
+};
+
+#endif
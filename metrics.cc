@@ -0,0 +1,111 @@
+/****************************************************************
+Low overhead instrumentation of a run. Phases are timed with a
+monotonic clock and counters record work done, such as edges
+processed, iterations run and bytes read. Everything is written
+as a JSON report at the end of the run along with the residual of
+each ranking iteration and the peak memory used. Metrics are only
+gathered once enabled, and the METRICS_ macros compile to nothing
+unless PAGERANK_METRICS is defined.
+****************************************************************/
+
+#include "metrics.h"
+
+#include <fstream>
+#include <sys/resource.h>
+
+bool Metrics::s_enabled = false;
+std::vector<std::pair<std::string, double> > Metrics::s_phases;
+std::vector<std::pair<std::string, uint64_t> > Metrics::s_counters;
+std::vector<double> Metrics::s_residuals;
+
+// start or stop gathering metrics
+void Metrics::setEnabled(bool enabled)
+{
+    s_enabled = enabled;
+}
+
+// returns true if the METRICS_ macros were compiled in
+bool Metrics::isCompiledIn()
+{
+#ifdef PAGERANK_METRICS
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Add to the value with the given name. There are only a handful of names,
+// so a linear search keeps them in the order they were first seen.
+template<typename Value>
+void Metrics::addTo(std::vector<std::pair<std::string, Value> >& values, const char* name, Value value)
+{
+    for(typename std::vector<std::pair<std::string, Value> >::iterator iter = values.begin() ; iter != values.end() ; ++iter)
+    {
+	if(iter->first == name)
+	{
+	    iter->second += value;
+	    return;
+	}
+    }
+
+    values.push_back(std::make_pair(std::string(name), value));
+}
+
+// add time spent in the named phase, a phase run more than once accumulates
+void Metrics::addToPhase(const char* name, double seconds)
+{
+    addTo(s_phases, name, seconds);
+}
+
+// add a value to the named counter
+void Metrics::addToCounter(const char* name, uint64_t value)
+{
+    addTo(s_counters, name, value);
+}
+
+// record the residual of each iteration of the last ranking
+void Metrics::setResiduals(const std::vector<double>& residuals)
+{
+    s_residuals = residuals;
+}
+
+// Write the metrics gathered as a JSON object with the seconds spent in each
+// phase, the counters, the residual of each iteration and the peak resident
+// set size of the process. Returns false if the file cannot be written.
+bool Metrics::write(const char* filepath)
+{
+    std::ofstream file(filepath, std::ios::trunc);
+
+    if(!file)
+    {
+	return false;
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    file << "{\n  \"phases\": {";
+
+    for(size_t phase = 0 ; phase < s_phases.size() ; ++phase)
+    {
+	file << (phase ? ", " : "") << "\"" << s_phases[phase].first << "\": " << s_phases[phase].second;
+    }
+
+    file << "},\n  \"counters\": {";
+
+    for(size_t counter = 0 ; counter < s_counters.size() ; ++counter)
+    {
+	file << (counter ? ", " : "") << "\"" << s_counters[counter].first << "\": " << s_counters[counter].second;
+    }
+
+    file << "},\n  \"residuals\": [";
+
+    for(size_t iteration = 0 ; iteration < s_residuals.size() ; ++iteration)
+    {
+	file << (iteration ? ", " : "") << s_residuals[iteration];
+    }
+
+    file << "],\n  \"peak_rss_kb\": " << usage.ru_maxrss << "\n}\n";
+
+    return (bool)file.flush();
+}
@@ -0,0 +1,117 @@
+/****************************************************************
+Low overhead instrumentation of a run. Phases are timed with a
+monotonic clock and counters record work done, such as edges
+processed, iterations run and bytes read. Everything is written
+as a JSON report at the end of the run along with the residual of
+each ranking iteration and the peak memory used. Metrics are only
+gathered once enabled, and the METRICS_ macros compile to nothing
+unless PAGERANK_METRICS is defined.
+****************************************************************/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <utility>
+#include <chrono>
+
+#ifdef PAGERANK_METRICS
+
+// time the rest of the enclosing scope as the named phase, e.g. METRICS_PHASE("parse")
+#define METRICS_PHASE(name) MetricsPhaseTimer metricsPhaseTimer(name)
+// add a value to the named counter
+#define METRICS_COUNT(name, value) \
+    do \
+    { \
+	if(Metrics::isEnabled()) \
+	{ \
+	    Metrics::addToCounter(name, value); \
+	} \
+    } \
+    while(0)
+// record the residual of each iteration of a ranking
+#define METRICS_RESIDUALS(residuals) \
+    do \
+    { \
+	if(Metrics::isEnabled()) \
+	{ \
+	    Metrics::setResiduals(residuals); \
+	} \
+    } \
+    while(0)
+
+#else
+
+#define METRICS_PHASE(name) do {} while(0)
+#define METRICS_COUNT(name, value) do {} while(0)
+#define METRICS_RESIDUALS(residuals) do {} while(0)
+
+#endif
+
+class Metrics
+{
+    public:
+	// start gathering metrics (they are not gathered by default)
+	static void setEnabled(bool enabled);
+	// returns true if metrics are being gathered
+	static bool isEnabled()
+	{
+	    return s_enabled;
+	}
+	// returns true if the METRICS_ macros were compiled in
+	static bool isCompiledIn();
+
+	// add time spent in the named phase, use METRICS_PHASE rather than this
+	static void addToPhase(const char* name, double seconds);
+	// add a value to the named counter, use METRICS_COUNT rather than this
+	static void addToCounter(const char* name, uint64_t value);
+	// record ranking residuals, use METRICS_RESIDUALS rather than this
+	static void setResiduals(const std::vector<double>& residuals);
+
+	// write the metrics gathered as JSON, returns false if the file cannot be written
+	static bool write(const char* filepath);
+
+    private:
+	// add to the value with the given name, adding the name if it is new
+	template<typename Value>
+	static void addTo(std::vector<std::pair<std::string, Value> >& values, const char* name, Value value);
+
+	static bool s_enabled;
+	// seconds spent in each phase and the value of each counter, in the order first seen
+	static std::vector<std::pair<std::string, double> > s_phases;
+	static std::vector<std::pair<std::string, uint64_t> > s_counters;
+	// residual of each iteration of the last ranking
+	static std::vector<double> s_residuals;
+};
+
+// Times the scope it is declared in as a phase, when metrics are enabled
+class MetricsPhaseTimer
+{
+    public:
+	MetricsPhaseTimer(const char* name):m_name(Metrics::isEnabled() ? name : NULL)
+	{
+	    if(m_name)
+	    {
+		m_start = std::chrono::steady_clock::now();
+	    }
+	}
+
+	~MetricsPhaseTimer()
+	{
+	    if(m_name)
+	    {
+		Metrics::addToPhase(m_name, std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count());
+	    }
+	}
+
+    private:
+	MetricsPhaseTimer(const MetricsPhaseTimer&);
+	MetricsPhaseTimer& operator=(const MetricsPhaseTimer&);
+
+	const char* m_name;
+	std::chrono::steady_clock::time_point m_start;
+};
+
+#endif
@@ -0,0 +1,179 @@
+/****************************************************************
+Assigns dense indices to node names in the order the names are
+first seen. Names are copied once into a single block of memory
+and found again through an open addressing hash table, so there
+is no allocation per node.
+****************************************************************/
+
+#include "nodeinterner.h"
+
+#include <algorithm>
+#include <cstring>
+
+// marks an unused slot in the hash table
+static const NodeInterner::NodeIndex EMPTY_SLOT = 0xFFFFFFFF;
+
+NodeInterner::NodeInterner()
+{
+    clear();
+}
+
+// forget all names
+void NodeInterner::clear()
+{
+    m_names.clear();
+    m_nameOffsets.assign(1, 0);
+    m_hashes.clear();
+    m_slots.assign(INTERNER_INITIAL_SLOTS, EMPTY_SLOT);
+    m_slotMask = INTERNER_INITIAL_SLOTS - 1;
+}
+
+// Returns the index of a name. A name not seen before is copied into
+// the name block and given the next free index.
+NodeInterner::NodeIndex NodeInterner::intern(std::string_view name)
+{
+    uint64_t hash = hashName(name);
+
+    // linear probing, the table is never more than half full
+    for(uint64_t slot = hash & m_slotMask ; ; slot = (slot + 1) & m_slotMask)
+    {
+	NodeIndex index = m_slots[slot];
+
+	if(index == EMPTY_SLOT)
+	{
+	    break;
+	}
+
+	if(m_hashes[index] == hash && getName(index) == name)
+	{
+	    return index;
+	}
+    }
+
+    NodeIndex index = getNodeCount();
+
+    m_names.insert(m_names.end(), name.begin(), name.end());
+    m_nameOffsets.push_back(m_names.size());
+    m_hashes.push_back(hash);
+
+    if(2*(uint64_t)getNodeCount() > m_slots.size())
+    {
+	grow();
+    }
+    else
+    {
+	insertSlot(index);
+    }
+
+    return index;
+}
+
+// returns the name with the given index
+std::string_view NodeInterner::getName(NodeIndex index) const
+{
+    return std::string_view(m_names.data() + m_nameOffsets[index], m_nameOffsets[index + 1] - m_nameOffsets[index]);
+}
+
+// returns how many unique names have been interned
+NodeInterner::NodeIndex NodeInterner::getNodeCount() const
+{
+    return m_hashes.size();
+}
+
+// Renumber the names so their indices are in lexicographic order of name.
+// oldToNew is filled with the new index of each old index so callers can
+// renumber anything holding the old indices.
+void NodeInterner::renumberLexicographically(std::vector<NodeIndex>& oldToNew)
+{
+    NodeIndex nodecount = getNodeCount();
+    std::vector<NodeIndex> newToOld(nodecount);
+
+    for(NodeIndex index = 0 ; index < nodecount ; ++index)
+    {
+	newToOld[index] = index;
+    }
+
+    std::sort(newToOld.begin(), newToOld.end(), [this](NodeIndex a, NodeIndex b)
+    {
+	return getName(a) < getName(b);
+    });
+
+    std::vector<char> names;
+    std::vector<uint64_t> nameOffsets(1, 0);
+    std::vector<uint64_t> hashes(nodecount);
+
+    names.reserve(m_names.size());
+    nameOffsets.reserve(nodecount + 1);
+    oldToNew.resize(nodecount);
+
+    for(NodeIndex index = 0 ; index < nodecount ; ++index)
+    {
+	std::string_view name = getName(newToOld[index]);
+
+	names.insert(names.end(), name.begin(), name.end());
+	nameOffsets.push_back(names.size());
+	hashes[index] = m_hashes[newToOld[index]];
+	oldToNew[newToOld[index]] = index;
+    }
+
+    m_names.swap(names);
+    m_nameOffsets.swap(nameOffsets);
+    m_hashes.swap(hashes);
+
+    std::fill(m_slots.begin(), m_slots.end(), EMPTY_SLOT);
+
+    for(NodeIndex index = 0 ; index < nodecount ; ++index)
+    {
+	insertSlot(index);
+    }
+}
+
+// Hash a name eight bytes at a time with a multiply and xor-shift mix
+uint64_t NodeInterner::hashName(std::string_view name)
+{
+    const char* position = name.data();
+    size_t remaining = name.size();
+    uint64_t hash = 0x9E3779B97F4A7C15ULL ^ remaining;
+
+    while(remaining >= 8)
+    {
+	uint64_t word;
+	memcpy(&word, position, 8);
+	hash = (hash ^ word) * 0xBF58476D1CE4E5B9ULL;
+	hash ^= hash >> 31;
+	position += 8;
+	remaining -= 8;
+    }
+
+    uint64_t word = 0;
+    memcpy(&word, position, remaining);
+    hash = (hash ^ word) * 0x94D049BB133111EBULL;
+    hash ^= hash >> 29;
+
+    return hash;
+}
+
+// insert an index into the hash table, the name must not already be present
+void NodeInterner::insertSlot(NodeIndex index)
+{
+    uint64_t slot = m_hashes[index] & m_slotMask;
+
+    while(m_slots[slot] != EMPTY_SLOT)
+    {
+	slot = (slot + 1) & m_slotMask;
+    }
+
+    m_slots[slot] = index;
+}
+
+// double the size of the hash table and reinsert every index
+void NodeInterner::grow()
+{
+    m_slots.assign(2*m_slots.size(), EMPTY_SLOT);
+    m_slotMask = m_slots.size() - 1;
+
+    for(NodeIndex index = 0 ; index < getNodeCount() ; ++index)
+    {
+	insertSlot(index);
+    }
+}
@@ -0,0 +1,58 @@
+/****************************************************************
+Assigns dense indices to node names in the order the names are
+first seen. Names are copied once into a single block of memory
+and found again through an open addressing hash table, so there
+is no allocation per node.
+****************************************************************/
+
+#ifndef NODEINTERNER_H
+#define NODEINTERNER_H
+
+#include <stdint.h>
+#include <vector>
+#include <string_view>
+
+// Initial number of slots in the hash table (must be a power of 2)
+#define INTERNER_INITIAL_SLOTS 1024
+
+class NodeInterner
+{
+    public:
+	typedef uint32_t NodeIndex;
+
+	NodeInterner();
+	virtual ~NodeInterner(){};
+
+	// returns the index of a name, assigning the next free index if it is new
+	NodeIndex intern(std::string_view name);
+	// returns the name with the given index
+	std::string_view getName(NodeIndex index) const;
+	// returns how many unique names have been interned
+	NodeIndex getNodeCount() const;
+	// forget all names
+	void clear();
+
+	// Renumber the names in lexicographic order. oldToNew is filled with
+	// the new index of each old index.
+	void renumberLexicographically(std::vector<NodeIndex>& oldToNew);
+
+    private:
+	// hash a name
+	static uint64_t hashName(std::string_view name);
+	// insert an index into the hash table without checking for duplicates
+	void insertSlot(NodeIndex index);
+	// double the size of the hash table
+	void grow();
+
+	// names one after another, name i runs from m_nameOffsets[i] to m_nameOffsets[i + 1]
+	std::vector<char> m_names;
+	std::vector<uint64_t> m_nameOffsets;
+	// hash of each name, kept so the table can grow without rehashing names
+	std::vector<uint64_t> m_hashes;
+	// open addressing hash table of name indices
+	std::vector<NodeIndex> m_slots;
+	// m_slots.size() - 1
+	uint64_t m_slotMask;
+};
+
+#endif
@@ -7,66 +7,642 @@ in the graph with an edge from the first node to the second node. The applicatio
 can be run in "check" mode to identify rank leaks and sinks; and in "run" mode to 
 calculate the page rank of nodes in the graph. In "run mode" orphan nodes with no 
 inbound links and all nodes pointed to only by orphan nodes will first be removed; 
-rank leaks, with no outbound links will also be removed (although not recursively).
+rank leaks, with no outbound links, and nodes only linking to rank leaks will also
+be removed.
+"convert" mode saves the graph read from a links file as a binary snapshot which
+"check" and "run" can load in place of the links file without parsing it.
+Given a file of seed sets "run" instead calculates a personalized page rank
+for every set together in one batch. Given a file of edge changes "run"
+keeps the page rank up to date through each batch of them in turn.
+For graphs too large to hold in memory "shard" splits a links file into
+shards on disk, which "stream" ranks holding only the rank vectors in memory.
+"stream" removes no nodes, so rank reaching rank leaks is lost and the ranks
+sum to less than 1.
+"ppr" approximates the personalized page rank of a single seed node by
+pushing rank out from it, touching only the seed's neighbourhood.
 **********************************************************************************/
 
 #include "pagerank.h"
 #include "linksfileparser.h"
 #include "directedgraph.h"
+#include "graphsnapshot.h"
 #include "pageranker.h"
+#include "personalizedranker.h"
+#include "shardedgraph.h"
+#include "streamingranker.h"
+#include "incrementalranker.h"
+#include "forwardpushranker.h"
+#include "threadpool.h"
+#include "logger.h"
+#include "metrics.h"
 
-#include <iostream>
 #include <sstream>
 #include <iomanip>
+#include <fstream>
+#include <unordered_map>
 
 int main(int argc, char* argv[])
 {   
+    int result = 0;
+
     try
     {
         parseArguments(argc,argv);
     }
-    catch (LinksFileParserException e)
+    catch (const LinksFileParserException& e)
     {
-	std::cout << "EXCEPTION THROWN: " << e.what() << std::endl;
+	LOG_RESULT("EXCEPTION THROWN: " << e.what() << "\n");
 	showUsage();
-	return 1;
+	result = 1;
     }
-    catch (InputArgumentException e)
+    catch (const InputArgumentException& e)
     {
-	std::cout << "EXCEPTION THROWN: " << e.what() << std::endl;
+	LOG_RESULT("EXCEPTION THROWN: " << e.what() << "\n");
 	showUsage();
-	return 1;
+	result = 1;
+    }
+    catch (const GraphSnapshotException& e)
+    {
+	LOG_RESULT("EXCEPTION THROWN: " << e.what() << "\n");
+	result = 1;
+    }
+    catch (const ShardedGraphException& e)
+    {
+	LOG_RESULT("EXCEPTION THROWN: " << e.what() << "\n");
+	result = 1;
     }
     catch(...)
     {
-	std::cout << "Caught default exception" << std::endl;
-	return 1;
+	LOG_RESULT("Caught default exception\n");
+	result = 1;
     }
 
-    return 0;
+    // write out any buffered output
+    Logger::flush();
+
+    return result;
 }
 
 
 // show program usage
 void showUsage()
 {
-    std::cout << "Run mode usage: pagerank run <filename> <iterations> <decay factor (0 < d <= 1)>" << std::endl;
-    std::cout << "Check mode usage: pagerank check <filename>" << std::endl;
-    std::cout << std::endl;
+    LOG_RESULT("Run mode usage: pagerank run <filename> <iterations> <decay factor (0 < d <= 1)> [options]\n");
+    LOG_RESULT("Check mode usage: pagerank check <filename> [options]\n");
+    LOG_RESULT("Convert mode usage: pagerank convert <links filename> <snapshot filename> [options]\n");
+    LOG_RESULT("Shard mode usage: pagerank shard <links filename> <shard directory> [options]\n");
+    LOG_RESULT("Stream mode usage: pagerank stream <shard directory> <iterations> <decay factor (0 < d <= 1)> [options]\n");
+    LOG_RESULT("PPR mode usage: pagerank ppr <filename> <seed node> <decay factor (0 < d < 1)> [options]\n");
+    LOG_RESULT("The <filename> given to run, check and ppr may be a links file or a snapshot.\n");
+    LOG_RESULT("Stream mode peels no nodes, so rank reaching nodes with no outbound links is lost and the ranks sum to less than 1.\n");
+    LOG_RESULT("Options:\n");
+    LOG_RESULT("  --threads <count>   number of threads used for parsing and ranking (default 1)\n");
+    LOG_RESULT("  --sort-nodes        number nodes in name order rather than the order first seen\n");
+    LOG_RESULT("  --metrics <filename>  write phase timings, counters and residuals to the file as JSON\n");
+    LOG_RESULT("  --huge-pages        back the vectors used for ranking with transparent huge pages\n");
+    LOG_RESULT("  --precision <float|double>      what ranks are stored as in run mode (default float)\n");
+    LOG_RESULT("  --sum-precision <float|double>  what each node's inbound rank is summed as in run mode (default the storage precision)\n");
+    LOG_RESULT("  --compensated-sum   sum inbound rank with compensated (Kahan) summation in run mode\n");
+    LOG_RESULT("  --simd <auto|portable|avx2|avx512>  vector kernels used in run mode (default auto, the best the CPU supports)\n");
+    LOG_RESULT("  --propagation <auto|pull|blocked>   how rank is passed along links in run mode, auto blocks it in bins\n");
+    LOG_RESULT("                      once the rank vector is larger than the last level cache\n");
+    LOG_RESULT("  --bin-width <nodes> destination nodes per propagation bin, a power of two (default sized to L2 cache)\n");
+    LOG_RESULT("  --reorder <none|degree|rcm|community>  renumber nodes for locality before ranking in run mode (default none),\n");
+    LOG_RESULT("                      results are still written in the original node order\n");
+    LOG_RESULT("  --tol <tolerance>   stop once the L1 residual of an iteration is below tolerance\n");
+    LOG_RESULT("  --extrapolate <k>   quadratically extrapolate the page rank vector every k iterations (k >= 3)\n");
+    LOG_RESULT("  --peel <orphans|leaks|both|none>    nodes removed before ranking in run mode (default both, never with --seeds or in stream mode)\n");
+    LOG_RESULT("  --storage <auto|sparse|dense|compressed>  how graph edges are stored, auto picks dense bit matrices for dense graphs\n");
+    LOG_RESULT("                      and compressed gap encodes them, using less memory but decoding them as they are read\n");
+    LOG_RESULT("  --shard-size <MB>   megabytes of links in each shard written in shard mode (default 64)\n");
+    LOG_RESULT("  --top <count>       show only the count highest ranked nodes in run, stream and ppr modes\n");
+    LOG_RESULT("  --epsilon <epsilon> in ppr mode push nodes with at least epsilon rank per outbound link (default 1e-6)\n");
+    LOG_RESULT("  --seeds <filename>  in run mode calculate personalized page rank for each line of node names in the file,\n");
+    LOG_RESULT("                      on the graph as it is with no nodes peeled, rank reaching nodes with no outbound\n");
+    LOG_RESULT("                      links jumps back to the seeds\n");
+    LOG_RESULT("  --updates <filename>  in run mode update the page rank for each batch of edge changes in the file, lines of\n");
+    LOG_RESULT("                      + <from> <to> or - <from> <to> with batches separated by blank lines, the graph\n");
+    LOG_RESULT("                      is peeled before the first batch and not again, so the ranks can differ from run\n");
+    LOG_RESULT("                      on the edited links file\n");
+    LOG_RESULT("  --max-drift <mass>  residual mass updates may add before the graph is ranked in full again (default 0.1)\n");
+    LOG_RESULT("  --verbosity <quiet|summary|debug>   quiet writes only results, debug lists every node and edge (default summary)\n");
+    LOG_RESULT("\n");
+}
+
+// Parses the options following a mode's arguments, starting at argv[first]
+void parseOptions(int argc, char* argv[], int first, RunOptions& options)
+{
+    for(int index = first ; index < argc ; ++index)
+    {
+	std::string option(argv[index]);
+
+	// options without a value
+	if(option == "--sort-nodes")
+	{
+	    options.sortNodesByName = true;
+	    continue;
+	}
+
+	if(option == "--huge-pages")
+	{
+	    options.hugePages = true;
+	    continue;
+	}
+
+	if(option == "--compensated-sum")
+	{
+	    options.compensatedSum = true;
+	    continue;
+	}
+
+	if(index + 1 == argc)
+	{
+	    throw InputArgumentException("option given without a value");
+	}
+
+	std::stringstream ss;
+	ss << argv[++index];
+
+	if(option == "--threads")
+	{
+	    if(!(ss >> options.threads) || options.threads == 0)
+	    {
+		throw InputArgumentException("failed to parse threads argument");
+	    }
+	}
+	else if(option == "--tol")
+	{
+	    if(!(ss >> options.tolerance) || options.tolerance <= 0)
+	    {
+		throw InputArgumentException("failed to parse tolerance argument");
+	    }
+	}
+	else if(option == "--extrapolate")
+	{
+	    if(!(ss >> options.extrapolationInterval) || options.extrapolationInterval < 3)
+	    {
+		throw InputArgumentException("extrapolation interval must be at least 3");
+	    }
+	}
+	else if(option == "--top")
+	{
+	    if(!(ss >> options.top) || options.top == 0)
+	    {
+		throw InputArgumentException("failed to parse top argument");
+	    }
+	}
+	else if(option == "--storage")
+	{
+	    if(ss.str() == "auto")
+	    {
+		options.storage = DirectedGraph::STORAGE_AUTOMATIC;
+	    }
+	    else if(ss.str() == "sparse")
+	    {
+		options.storage = DirectedGraph::STORAGE_SPARSE;
+	    }
+	    else if(ss.str() == "dense")
+	    {
+		options.storage = DirectedGraph::STORAGE_DENSE;
+	    }
+	    else if(ss.str() == "compressed")
+	    {
+		options.storage = DirectedGraph::STORAGE_COMPRESSED;
+	    }
+	    else
+	    {
+		throw InputArgumentException("storage must be auto, sparse, dense or compressed");
+	    }
+	}
+	else if(option == "--precision" || option == "--sum-precision")
+	{
+	    PageRanker::RankPrecision precision;
+
+	    if(ss.str() == "float")
+	    {
+		precision = PageRanker::PRECISION_FLOAT;
+	    }
+	    else if(ss.str() == "double")
+	    {
+		precision = PageRanker::PRECISION_DOUBLE;
+	    }
+	    else
+	    {
+		throw InputArgumentException("precision must be float or double");
+	    }
+
+	    if(option == "--precision")
+	    {
+		options.rankPrecision = precision;
+	    }
+	    else
+	    {
+		options.sumPrecision = precision;
+		options.sumPrecisionGiven = true;
+	    }
+	}
+	else if(option == "--simd")
+	{
+	    if(ss.str() == "auto")
+	    {
+		options.instructionSet = VectorKernels::getSupportedInstructionSet();
+	    }
+	    else if(ss.str() == "portable")
+	    {
+		options.instructionSet = VectorKernels::INSTRUCTIONS_PORTABLE;
+	    }
+	    else if(ss.str() == "avx2")
+	    {
+		options.instructionSet = VectorKernels::INSTRUCTIONS_AVX2;
+	    }
+	    else if(ss.str() == "avx512")
+	    {
+		options.instructionSet = VectorKernels::INSTRUCTIONS_AVX512;
+	    }
+	    else
+	    {
+		throw InputArgumentException("simd must be auto, portable, avx2 or avx512");
+	    }
+
+	    if(options.instructionSet > VectorKernels::getSupportedInstructionSet())
+	    {
+		throw InputArgumentException("the CPU does not support the simd instruction set given");
+	    }
+	}
+	else if(option == "--propagation")
+	{
+	    if(ss.str() == "auto")
+	    {
+		options.propagation = PageRanker::PROPAGATION_AUTOMATIC;
+	    }
+	    else if(ss.str() == "pull")
+	    {
+		options.propagation = PageRanker::PROPAGATION_PULL;
+	    }
+	    else if(ss.str() == "blocked")
+	    {
+		options.propagation = PageRanker::PROPAGATION_BLOCKED;
+	    }
+	    else
+	    {
+		throw InputArgumentException("propagation must be auto, pull or blocked");
+	    }
+	}
+	else if(option == "--bin-width")
+	{
+	    uint64_t width;
+
+	    if(!(ss >> width) || width < 2 || width > ((uint64_t)1 << 31) || (width & (width - 1)))
+	    {
+		throw InputArgumentException("bin width must be a power of two from 2 to 2^31");
+	    }
+
+	    for(options.binShift = 0 ; ((uint64_t)1 << options.binShift) < width ; ++options.binShift);
+	}
+	else if(option == "--metrics")
+	{
+	    if(!Metrics::isCompiledIn())
+	    {
+		throw InputArgumentException("metrics were not compiled in, build with METRICS=1");
+	    }
+
+	    options.metricsFile = argv[index];
+	}
+	else if(option == "--seeds")
+	{
+	    options.seedsFile = argv[index];
+	}
+	else if(option == "--updates")
+	{
+	    options.updatesFile = argv[index];
+	}
+	else if(option == "--max-drift")
+	{
+	    if(!(ss >> options.maxDrift) || options.maxDrift <= 0)
+	    {
+		throw InputArgumentException("failed to parse max drift argument");
+	    }
+	}
+	else if(option == "--verbosity")
+	{
+	    if(ss.str() == "quiet")
+	    {
+		options.verbosity = Logger::VERBOSITY_QUIET;
+	    }
+	    else if(ss.str() == "summary")
+	    {
+		options.verbosity = Logger::VERBOSITY_SUMMARY;
+	    }
+	    else if(ss.str() == "debug")
+	    {
+		options.verbosity = Logger::VERBOSITY_DEBUG;
+	    }
+	    else
+	    {
+		throw InputArgumentException("verbosity must be quiet, summary or debug");
+	    }
+	}
+	else if(option == "--epsilon")
+	{
+	    if(!(ss >> options.epsilon) || options.epsilon <= 0)
+	    {
+		throw InputArgumentException("failed to parse epsilon argument");
+	    }
+	}
+	else if(option == "--shard-size")
+	{
+	    uint64_t megabytes;
+
+	    if(!(ss >> megabytes) || megabytes == 0)
+	    {
+		throw InputArgumentException("failed to parse shard size argument");
+	    }
+
+	    options.shardBytes = megabytes << 20;
+	}
+	else if(option == "--reorder")
+	{
+	    if(ss.str() == "none")
+	    {
+		options.ordering = NodeReorderer::ORDERING_NONE;
+	    }
+	    else if(ss.str() == "degree")
+	    {
+		options.ordering = NodeReorderer::ORDERING_DEGREE;
+	    }
+	    else if(ss.str() == "rcm")
+	    {
+		options.ordering = NodeReorderer::ORDERING_REVERSE_CUTHILL_MCKEE;
+	    }
+	    else if(ss.str() == "community")
+	    {
+		options.ordering = NodeReorderer::ORDERING_COMMUNITY;
+	    }
+	    else
+	    {
+		throw InputArgumentException("reorder must be none, degree, rcm or community");
+	    }
+	}
+	else if(option == "--peel")
+	{
+	    if(ss.str() == "orphans" || ss.str() == "leaks" || ss.str() == "both" || ss.str() == "none")
+	    {
+		options.peelOrphans = ss.str() == "orphans" || ss.str() == "both";
+		options.peelLeaks = ss.str() == "leaks" || ss.str() == "both";
+	    }
+	    else
+	    {
+		throw InputArgumentException("peel must be orphans, leaks, both or none");
+	    }
+	}
+	else
+	{
+	    throw InputArgumentException("unknown option");
+	}
+    }
+
+    // without --sum-precision ranks are summed as they are stored
+    if(!options.sumPrecisionGiven)
+    {
+	options.sumPrecision = options.rankPrecision;
+    }
+}
+
+// Loads a graph from a snapshot if the file is one, otherwise parses
+// the file as a links file and builds the graph from it. A snapshot is
+// left mapped as sparse arrays unless dense or compressed storage is asked for.
+// Its neighbours are checked straight away when every edge will be read,
+// otherwise the caller checks the rows it reads.
+std::unique_ptr<DirectedGraph> loadGraph(char* filepath, const RunOptions& options, ThreadPool& threadPool, bool readsEveryEdge)
+{
+    if(GraphSnapshot::isSnapshot(filepath))
+    {
+	std::unique_ptr<DirectedGraph> graph(new DirectedGraph());
+	GraphSnapshot::load(filepath, *graph);
+
+	if(readsEveryEdge || options.storage == DirectedGraph::STORAGE_DENSE || options.storage == DirectedGraph::STORAGE_COMPRESSED)
+	{
+	    GraphSnapshot::checkNeighbours(*graph);
+	}
+
+	if(options.storage == DirectedGraph::STORAGE_DENSE || options.storage == DirectedGraph::STORAGE_COMPRESSED)
+	{
+	    graph->setStorage(options.storage);
+	    graph->finalise();
+	}
+
+	LOG_SUMMARY("Mapped snapshot " << filepath << " with " << graph->getNodeCount() << " nodes and "
+		    << graph->getEdgeCount() << " edges\n\n");
+	return graph;
+    }
+
+    LinksFileParser linksFileParser;
+    linksFileParser.setThreadPool(&threadPool);
+    linksFileParser.setSortNodesByName(options.sortNodesByName);
+    linksFileParser.parseFile(filepath);
+    std::unique_ptr<DirectedGraph> graph(new DirectedGraph(linksFileParser.getNodeCount()));
+    graph->setStorage(options.storage);
+    linksFileParser.addNodesToGraph(*graph);
+    return graph;
+}
+
+// Maps the name of every named node of the graph to its index
+void mapNodeNames(const DirectedGraph& graph, std::unordered_map<std::string_view, MatrixIndex>& nodeIndices)
+{
+    nodeIndices.clear();
+
+    for(MatrixIndex node = 0 ; node < graph.getNamedNodeCount() ; ++node)
+    {
+	nodeIndices[graph.getNodeName(node)] = node;
+    }
+}
+
+// Reads a file with one seed set per line, each a list of node names separated
+// by whitespace. Blank lines are skipped, as are names not in the graph.
+void loadSeedSets(const char* filepath, const DirectedGraph& graph, std::vector<std::vector<MatrixIndex> >& seedSets)
+{
+    std::ifstream file(filepath);
+
+    if(!file)
+    {
+	throw InputArgumentException("failed to open seeds file");
+    }
+
+    std::unordered_map<std::string_view, MatrixIndex> nodeIndices;
+    mapNodeNames(graph, nodeIndices);
+
+    seedSets.clear();
+    std::string line;
+
+    while(std::getline(file, line))
+    {
+	std::stringstream ss(line);
+	std::string name;
+	std::vector<MatrixIndex> seeds;
+	bool blank = true;
+
+	while(ss >> name)
+	{
+	    blank = false;
+	    std::unordered_map<std::string_view, MatrixIndex>::const_iterator found = nodeIndices.find(name);
+
+	    if(found == nodeIndices.end())
+	    {
+		LOG_SUMMARY("WARNING: Ignored seed " << name << " which is not a node in the graph\n");
+	    }
+	    else
+	    {
+		seeds.push_back(found->second);
+	    }
+	}
+
+	if(blank)
+	{
+	    continue;
+	}
+
+	if(seeds.empty())
+	{
+	    throw InputArgumentException("seed set has no nodes in the graph");
+	}
+
+	seedSets.push_back(seeds);
+    }
+
+    if(seedSets.empty())
+    {
+	throw InputArgumentException("no seed sets read from seeds file");
+    }
+}
+
+// Reads a file of batches of edge changes, one change per line: "+ from to"
+// inserts the edge and "- from to" deletes it. Blank lines end a batch.
+// Changes naming nodes not in the graph are skipped, as the graph's nodes
+// are fixed once it is built. Links from a node to itself are skipped too.
+void loadEdgeChanges(const char* filepath, const DirectedGraph& graph, std::vector<IncrementalRanker::EdgeChanges>& batches)
+{
+    std::ifstream file(filepath);
+
+    if(!file)
+    {
+	throw InputArgumentException("failed to open updates file");
+    }
+
+    std::unordered_map<std::string_view, MatrixIndex> nodeIndices;
+    mapNodeNames(graph, nodeIndices);
+
+    batches.assign(1, IncrementalRanker::EdgeChanges());
+    std::string line;
+
+    while(std::getline(file, line))
+    {
+	std::stringstream ss(line);
+	std::string change;
+	std::string from;
+	std::string to;
+
+	if(!(ss >> change))
+	{
+	    if(!batches.back().insertions.empty() || !batches.back().deletions.empty())
+	    {
+		batches.push_back(IncrementalRanker::EdgeChanges());
+	    }
+
+	    continue;
+	}
+
+	if((change != "+" && change != "-") || !(ss >> from >> to))
+	{
+	    throw InputArgumentException("edge changes must be + <from> <to> or - <from> <to>");
+	}
+
+	// as in a links file, a link to self is ignored
+	if(from == to)
+	{
+	    LOG_SUMMARY("WARNING: Ignoring link to self for node " << from << "\n");
+	    continue;
+	}
+
+	std::unordered_map<std::string_view, MatrixIndex>::const_iterator fromNode = nodeIndices.find(from);
+	std::unordered_map<std::string_view, MatrixIndex>::const_iterator toNode = nodeIndices.find(to);
+
+	if(fromNode == nodeIndices.end() || toNode == nodeIndices.end())
+	{
+	    LOG_SUMMARY("WARNING: Ignored edge change " << from << " " << to << " with a node not in the graph\n");
+	    continue;
+	}
+
+	IncrementalRanker::Edges& edges = change == "+" ? batches.back().insertions : batches.back().deletions;
+	edges.push_back(std::make_pair(fromNode->second, toNode->second));
+    }
+
+    if(batches.back().insertions.empty() && batches.back().deletions.empty())
+    {
+	batches.pop_back();
+    }
+}
+
+// Warns about run mode options which only apply to global page rank when
+// the given option has it calculate something else instead, as
+// PersonalizedRanker always stores and sums float ranks with its own loops
+// and IncrementalRanker double ranks with its own
+void warnIgnoredRankOptions(const RunOptions& options, const char* option)
+{
+    RunOptions defaults;
+
+    if(options.rankPrecision != defaults.rankPrecision || options.sumPrecisionGiven || options.compensatedSum)
+    {
+	LOG_RESULT("WARNING: --precision, --sum-precision and --compensated-sum are ignored with " << option << "\n");
+    }
+
+    if(options.instructionSet != defaults.instructionSet)
+    {
+	LOG_RESULT("WARNING: --simd is ignored with " << option << "\n");
+    }
+
+    if(options.propagation != defaults.propagation || options.binShift != defaults.binShift)
+    {
+	LOG_RESULT("WARNING: --propagation and --bin-width are ignored with " << option << "\n");
+    }
+
+    if(options.extrapolationInterval != defaults.extrapolationInterval)
+    {
+	LOG_RESULT("WARNING: --extrapolate is ignored with " << option << "\n");
+    }
+}
+
+// Writes the metrics report if one was asked for
+void writeMetrics(const RunOptions& options)
+{
+    if(options.metricsFile && !Metrics::write(options.metricsFile))
+    {
+	LOG_RESULT("WARNING: Failed to write metrics file " << options.metricsFile << "\n");
+    }
 }
 
 // Parses command line arguments
 void parseArguments(int argc, char* argv[])
 {
+    if(argc < 2)
+    {
+	throw InputArgumentException("Arguments not understood/incomplete");
+    }
+
     // "check" mode
-    if(!strcmp(argv[1], "check") && argc == 3)
+    if(!strcmp(argv[1], "check") && argc >= 3)
     {
-	LinksFileParser linksFileParser;
-	linksFileParser.parseFile(argv[2]);
-	DirectedGraph directedGraph(linksFileParser.getNodeCount());
-	linksFileParser.addNodesToGraph(directedGraph);
+	RunOptions options;
+	parseOptions(argc, argv, 3, options);
+	Logger::setVerbosity(options.verbosity);
+	Metrics::setEnabled(options.metricsFile != NULL);
+
+	ThreadPool threadPool(options.threads);
+	std::unique_ptr<DirectedGraph> graph = loadGraph(argv[2], options, threadPool, true);
+	DirectedGraph& directedGraph = *graph;
 	directedGraph.dumpGraph();
-	PageRanker pageRanker;	  
+	PageRanker pageRanker;
+	pageRanker.setThreadPool(&threadPool);
+	pageRanker.getWorkspace().setHugePages(options.hugePages);
 	// remove orphans and nodes only pointed to by orphans first
 	pageRanker.removeOrphanNodes(directedGraph);
 	directedGraph.dumpGraph();
@@ -76,13 +652,13 @@ void parseArguments(int argc, char* argv[])
 	pageRanker.removeLeakNodes(directedGraph);
 	directedGraph.dumpGraph();
 	pageRanker.dumpRankSinks(directedGraph);
-	pageRanker.dumpPageRank(directedGraph);
+	writeMetrics(options);
     } 
     else if(!strcmp(argv[1], "check"))
     {
        throw InputArgumentException("Checking graph incorrect arguments provided");
     }
-    else if(!strcmp(argv[1], "run") && argc == 5)
+    else if(!strcmp(argv[1], "run") && argc >= 5)
     {
 	// "run" mode
         uint32_t iterations;
@@ -114,22 +690,282 @@ void parseArguments(int argc, char* argv[])
 	    throw InputArgumentException("decay factor not in range 0 < d <= 1");
 	}
 
-	LinksFileParser linksFileParser;
-	linksFileParser.parseFile(argv[2]);
-	DirectedGraph directedGraph(linksFileParser.getNodeCount());
-	linksFileParser.addNodesToGraph(directedGraph);
+	RunOptions options;
+	parseOptions(argc, argv, 5, options);
+	Logger::setVerbosity(options.verbosity);
+	Metrics::setEnabled(options.metricsFile != NULL);
+
+	if(options.seedsFile && options.updatesFile)
+	{
+	    throw InputArgumentException("seeds and updates cannot be given together");
+	}
+
+	if(options.seedsFile)
+	{
+	    warnIgnoredRankOptions(options, "--seeds");
+	}
+	else if(options.updatesFile)
+	{
+	    warnIgnoredRankOptions(options, "--updates");
+	}
+
+	ThreadPool threadPool(options.threads);
+	std::unique_ptr<DirectedGraph> graph = loadGraph(argv[2], options, threadPool, true);
+	DirectedGraph& directedGraph = *graph;
 	directedGraph.dumpGraph();
 	    
 	PageRanker pageRanker;
-	pageRanker.removeOrphanNodes(directedGraph);
-	pageRanker.removeLeakNodes(directedGraph);
-	pageRanker.rankGraphNodes(directedGraph, decayfactor, iterations);
-	pageRanker.dumpPageRank(directedGraph);
+	pageRanker.setThreadPool(&threadPool);
+	pageRanker.getWorkspace().setHugePages(options.hugePages);
+	pageRanker.setTolerance(options.tolerance);
+	pageRanker.setPrecision(options.rankPrecision, options.sumPrecision, options.compensatedSum);
+	VectorKernels::setInstructionSet(options.instructionSet);
+	pageRanker.setPropagation(options.propagation, options.binShift);
+	pageRanker.setExtrapolation(options.extrapolationInterval);
+	// Peeling would strip the links of a seed nothing links to, so
+	// personalized page rank is calculated on the graph as it is, with
+	// the rank reaching nodes with no outbound links sent back to the seeds
+	if(!options.seedsFile && (options.peelOrphans || options.peelLeaks))
+	{
+	    pageRanker.peelGraph(directedGraph, options.peelOrphans ? (options.peelLeaks ? PageRanker::PEEL_ORPHANS_AND_LEAKS : PageRanker::PEEL_ORPHANS)
+							      : PageRanker::PEEL_LEAKS);
+	}
+
+	NodeReorderer nodeReorderer;
+	nodeReorderer.reorderGraph(directedGraph, options.ordering);
+
+	// The graph is peeled once, before the updates. Nodes the updates leave
+	// as orphans or leaks stay in it, so the ranks can differ from ranking
+	// the edited links file, which would be peeled as a whole.
+	if(options.updatesFile)
+	{
+	    std::vector<IncrementalRanker::EdgeChanges> batches;
+	    loadEdgeChanges(options.updatesFile, directedGraph, batches);
+
+	    IncrementalRanker incrementalRanker;
+	    incrementalRanker.setThreadPool(&threadPool);
+	    incrementalRanker.setMaxDrift(options.maxDrift);
+
+	    if(options.tolerance > 0)
+	    {
+		incrementalRanker.setTolerance(options.tolerance);
+	    }
+
+	    incrementalRanker.rankGraphNodes(directedGraph, decayfactor, iterations);
+
+	    for(size_t batch = 0 ; batch < batches.size() ; ++batch)
+	    {
+		incrementalRanker.applyEdgeChanges(directedGraph, batches[batch]);
+	    }
+
+	    METRICS_PHASE("output");
+
+	    if(options.top)
+	    {
+		incrementalRanker.dumpTopPageRank(directedGraph, options.top);
+	    }
+	    else
+	    {
+		incrementalRanker.dumpPageRank(directedGraph);
+	    }
+	}
+	else if(options.seedsFile)
+	{
+	    std::vector<std::vector<MatrixIndex> > seedSets;
+	    loadSeedSets(options.seedsFile, directedGraph, seedSets);
+
+	    std::vector<PersonalizedRanker::PageRank> teleports;
+	    PersonalizedRanker::makeSeedTeleports(directedGraph, seedSets, teleports);
+
+	    PersonalizedRanker personalizedRanker;
+	    personalizedRanker.setThreadPool(&threadPool);
+	    personalizedRanker.setTolerance(options.tolerance);
+	    personalizedRanker.rankGraphNodes(directedGraph, decayfactor, iterations, teleports.data(), seedSets.size());
+
+	    METRICS_PHASE("output");
+	    personalizedRanker.dumpTopPageRank(directedGraph, options.top);
+	}
+	else
+	{
+	    pageRanker.rankGraphNodes(directedGraph, decayfactor, iterations);
+	    pageRanker.dumpResidualHistory();
+
+	    METRICS_PHASE("output");
+
+	    if(options.top)
+	    {
+		pageRanker.dumpTopPageRank(directedGraph, options.top);
+	    }
+	    else
+	    {
+		pageRanker.dumpPageRank(directedGraph);
+	    }
+	}
+
+	writeMetrics(options);
     }
     else if(!strcmp(argv[1], "run"))
     {
 	throw InputArgumentException("Run mode incorrect arguments provided");
     }
+    else if(!strcmp(argv[1], "convert") && argc >= 4)
+    {
+	// "convert" mode
+	RunOptions options;
+	parseOptions(argc, argv, 4, options);
+	Logger::setVerbosity(options.verbosity);
+	Metrics::setEnabled(options.metricsFile != NULL);
+
+	ThreadPool threadPool(options.threads);
+	std::unique_ptr<DirectedGraph> graph = loadGraph(argv[2], options, threadPool, true);
+	GraphSnapshot::write(*graph, argv[3]);
+	LOG_SUMMARY("Wrote snapshot " << argv[3] << " with " << graph->getNodeCount() << " nodes and "
+		    << graph->getEdgeCount() << " edges\n");
+	writeMetrics(options);
+    }
+    else if(!strcmp(argv[1], "convert"))
+    {
+	throw InputArgumentException("Convert mode incorrect arguments provided");
+    }
+    else if(!strcmp(argv[1], "shard") && argc >= 4)
+    {
+	// "shard" mode
+	RunOptions options;
+	parseOptions(argc, argv, 4, options);
+	Logger::setVerbosity(options.verbosity);
+	Metrics::setEnabled(options.metricsFile != NULL);
+
+	ShardedGraph::create(argv[2], argv[3], options.shardBytes, options.sortNodesByName);
+	writeMetrics(options);
+    }
+    else if(!strcmp(argv[1], "shard"))
+    {
+	throw InputArgumentException("Shard mode incorrect arguments provided");
+    }
+    else if(!strcmp(argv[1], "stream") && argc >= 5)
+    {
+	// "stream" mode
+	uint32_t iterations;
+	float decayfactor;
+	std::stringstream ss;
+
+	ss << argv[3];
+
+	if(!(ss >> iterations))
+	{
+	    throw InputArgumentException("failed to parse iterations argument");
+	}
+
+	ss.clear();
+	ss.str("");
+	ss << argv[4];
+
+	if(!(ss >> decayfactor))
+	{
+	    throw InputArgumentException("failed to parse decay factor argument");
+	}
+
+	if(decayfactor <= 0 || decayfactor > 1)
+	{
+	    throw InputArgumentException("decay factor not in range 0 < d <= 1");
+	}
+
+	RunOptions options;
+	parseOptions(argc, argv, 5, options);
+	Logger::setVerbosity(options.verbosity);
+	Metrics::setEnabled(options.metricsFile != NULL);
+
+	if(!ShardedGraph::isShardedGraph(argv[2]))
+	{
+	    throw InputArgumentException("stream mode needs a directory written by shard mode");
+	}
+
+	RunOptions defaults;
+
+	if(options.peelOrphans != defaults.peelOrphans || options.peelLeaks != defaults.peelLeaks)
+	{
+	    LOG_RESULT("WARNING: --peel is ignored in stream mode, no nodes are peeled\n");
+	}
+
+	ThreadPool threadPool(options.threads);
+	ShardedGraph graph;
+	graph.open(argv[2]);
+
+	StreamingRanker streamingRanker;
+	streamingRanker.setThreadPool(&threadPool);
+	streamingRanker.setTolerance(options.tolerance);
+	streamingRanker.rankGraphNodes(graph, decayfactor, iterations);
+	streamingRanker.dumpResidualHistory();
+
+	METRICS_PHASE("output");
+
+	if(options.top)
+	{
+	    streamingRanker.dumpTopPageRank(graph, options.top);
+	}
+	else
+	{
+	    streamingRanker.dumpPageRank(graph);
+	}
+
+	writeMetrics(options);
+    }
+    else if(!strcmp(argv[1], "stream"))
+    {
+	throw InputArgumentException("Stream mode incorrect arguments provided");
+    }
+    else if(!strcmp(argv[1], "ppr") && argc >= 5)
+    {
+	// "ppr" mode
+	float decayfactor;
+	std::stringstream ss;
+
+	ss << argv[4];
+
+	if(!(ss >> decayfactor))
+	{
+	    throw InputArgumentException("failed to parse decay factor argument");
+	}
+
+	// with a decay factor of 1 no rank is ever kept and pushing never ends
+	if(decayfactor <= 0 || decayfactor >= 1)
+	{
+	    throw InputArgumentException("decay factor not in range 0 < d < 1");
+	}
+
+	RunOptions options;
+	parseOptions(argc, argv, 5, options);
+	Logger::setVerbosity(options.verbosity);
+	Metrics::setEnabled(options.metricsFile != NULL);
+
+	ThreadPool threadPool(options.threads);
+	std::unique_ptr<DirectedGraph> graph = loadGraph(argv[2], options, threadPool, false);
+	DirectedGraph& directedGraph = *graph;
+	std::string_view seedName(argv[3]);
+	MatrixIndex seed = 0;
+
+	while(seed < directedGraph.getNamedNodeCount() && directedGraph.getNodeName(seed) != seedName)
+	{
+	    ++seed;
+	}
+
+	if(seed == directedGraph.getNamedNodeCount())
+	{
+	    throw InputArgumentException("seed is not a node in the graph");
+	}
+
+	ForwardPushRanker forwardPushRanker;
+	forwardPushRanker.setEpsilon(options.epsilon);
+	forwardPushRanker.rankFromSeed(directedGraph, seed, decayfactor);
+
+	METRICS_PHASE("output");
+	forwardPushRanker.dumpTopPageRank(directedGraph, options.top);
+	writeMetrics(options);
+    }
+    else if(!strcmp(argv[1], "ppr"))
+    {
+	throw InputArgumentException("PPR mode incorrect arguments provided");
+    }
     else
     {
 	throw InputArgumentException("Arguments not understood/incomplete");
@@ -7,13 +7,104 @@ in the graph with an edge from the first node to the second node. The applicatio
 can be run in "check" mode to identify rank leaks and sinks; and in "run" mode to 
 calculate the page rank of nodes in the graph. In "run mode" orphan nodes with no 
 inbound links and all nodes pointed to only by orphan nodes will first be removed; 
-rank leaks, with no outbound links will also be removed (although not recursively).
+rank leaks, with no outbound links, and nodes only linking to rank leaks will also
+be removed.
+"convert" mode saves the graph read from a links file as a binary snapshot which
+"check" and "run" can load in place of the links file without parsing it.
+Given a file of seed sets "run" instead calculates a personalized page rank
+for every set together in one batch. Given a file of edge changes "run"
+keeps the page rank up to date through each batch of them in turn.
+For graphs too large to hold in memory "shard" splits a links file into
+shards on disk, which "stream" ranks holding only the rank vectors in memory.
+"stream" removes no nodes, so rank reaching rank leaks is lost and the ranks
+sum to less than 1.
+"ppr" approximates the personalized page rank of a single seed node by
+pushing rank out from it, touching only the seed's neighbourhood.
 **********************************************************************************/
 
+#include "logger.h"
+#include "directedgraph.h"
+#include "pageranker.h"
+#include "vectorkernels.h"
+#include "nodereorderer.h"
+#include "shardedgraph.h"
+#include "incrementalranker.h"
+#include "forwardpushranker.h"
+
 #include <exception>
 #include <string>
+#include <stdint.h>
+#include <memory>
+#include <vector>
+#include <string_view>
+#include <unordered_map>
+
+class ThreadPool;
+
+// Optional settings given on the command line after a mode's arguments
+struct RunOptions
+{
+    RunOptions():threads(1),tolerance(0),extrapolationInterval(0),sortNodesByName(false),
+		 peelOrphans(true),peelLeaks(true),verbosity(Logger::VERBOSITY_SUMMARY),top(0),seedsFile(NULL),
+		 storage(DirectedGraph::STORAGE_AUTOMATIC),hugePages(false),metricsFile(NULL),
+		 rankPrecision(PageRanker::PRECISION_FLOAT),sumPrecision(PageRanker::PRECISION_FLOAT),sumPrecisionGiven(false),compensatedSum(false),
+		 instructionSet(VectorKernels::getSupportedInstructionSet()),propagation(PageRanker::PROPAGATION_AUTOMATIC),binShift(0),
+		 ordering(NodeReorderer::ORDERING_NONE),shardBytes(SHARDS_DEFAULT_SHARD_BYTES),updatesFile(NULL),
+		 maxDrift(INCREMENTAL_DEFAULT_MAX_DRIFT),epsilon(FORWARD_PUSH_DEFAULT_EPSILON){}
+    // number of threads used to rank the graph
+    unsigned threads;
+    // stop ranking once the L1 residual is below this, 0 runs every iteration
+    float tolerance;
+    // iterations between quadratic extrapolations, 0 for none
+    uint32_t extrapolationInterval;
+    // number nodes in name order rather than the order they are first seen
+    bool sortNodesByName;
+    // recursively remove orphans and rank leaks before ranking
+    bool peelOrphans;
+    bool peelLeaks;
+    // how much output is written
+    Logger::Verbosity verbosity;
+    // show only this many of the highest ranked nodes, 0 shows every node
+    uint32_t top;
+    // file of seed sets to calculate personalized page rank for, NULL for global page rank
+    const char* seedsFile;
+    // how the graph's edges are stored
+    DirectedGraph::Storage storage;
+    // back the ranking vectors with huge pages
+    bool hugePages;
+    // file the metrics report is written to, NULL for none
+    const char* metricsFile;
+    // what global page ranks are stored and summed as, and whether sums are compensated
+    PageRanker::RankPrecision rankPrecision;
+    PageRanker::RankPrecision sumPrecision;
+    // sums are in the storage precision unless --sum-precision is given
+    bool sumPrecisionGiven;
+    bool compensatedSum;
+    // instruction set of the vector kernels used for ranking
+    VectorKernels::InstructionSet instructionSet;
+    // how rank is passed along links, and log2 of the nodes per bin when blocked (0 to size them to L2 cache)
+    PageRanker::Propagation propagation;
+    unsigned binShift;
+    // how the nodes are renumbered before ranking
+    NodeReorderer::Ordering ordering;
+    // bytes of links sorted into each shard in shard mode
+    uint64_t shardBytes;
+    // file of batches of edge changes to keep the page rank up to date through, NULL for none
+    const char* updatesFile;
+    // residual mass updates may add before the graph is ranked in full again
+    double maxDrift;
+    // residual per outbound link below which ppr mode stops pushing a node
+    double epsilon;
+};
 
 void parseArguments(int argc, char* argv[]);
+void parseOptions(int argc, char* argv[], int first, RunOptions& options);
+std::unique_ptr<DirectedGraph> loadGraph(char* filepath, const RunOptions& options, ThreadPool& threadPool, bool readsEveryEdge);
+void mapNodeNames(const DirectedGraph& graph, std::unordered_map<std::string_view, uint32_t>& nodeIndices);
+void loadSeedSets(const char* filepath, const DirectedGraph& graph, std::vector<std::vector<uint32_t> >& seedSets);
+void loadEdgeChanges(const char* filepath, const DirectedGraph& graph, std::vector<IncrementalRanker::EdgeChanges>& batches);
+void warnIgnoredRankOptions(const RunOptions& options, const char* option);
+void writeMetrics(const RunOptions& options);
 void showUsage();
 
 // Exception class for command line arg parsing
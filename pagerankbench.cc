@@ -0,0 +1,232 @@
+/*******************************************************************************
+Benchmarks each phase of ranking a graph on synthetic graphs of several sizes.
+For every graph model and scale a graph is generated and written to a links
+file, which is then parsed, built into a graph, peeled of orphans and leaks,
+checked for rank sinks and ranked, exactly as "pagerank run" does. Each phase
+is reported as one JSON object per line with its time, the edges it processed
+per second and the peak resident set size of the process so far, so results
+can be compared between builds by a script.
+**********************************************************************************/
+
+#include "graphgenerator.h"
+#include "linksfileparser.h"
+#include "directedgraph.h"
+#include "componentfinder.h"
+#include "pageranker.h"
+#include "threadpool.h"
+#include "logger.h"
+
+#include <chrono>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/resource.h>
+
+// Settings given on the command line
+struct BenchOptions
+{
+    BenchOptions():edgeFactor(16),threads(1),iterations(20),danglingFraction(0.1),seed(1){}
+    // log2 of the node count of each graph
+    std::vector<unsigned> scales;
+    // edges per node
+    unsigned edgeFactor;
+    // number of threads used for parsing and ranking
+    unsigned threads;
+    // ranking iterations, run in full
+    uint32_t iterations;
+    // fraction of nodes with no outbound links
+    double danglingFraction;
+    // seed for the graph generator
+    uint64_t seed;
+};
+
+// Returns the peak resident set size of the process in kilobytes
+static long getPeakRss()
+{
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+
+    return usage.ru_maxrss;
+}
+
+// Returns seconds since a start time
+static double getSecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// write one phase's result as a line of JSON
+static void reportPhase(const char* model, unsigned scale, const DirectedGraph& graph, uint64_t edges,
+			const char* phase, double seconds, uint64_t edgesProcessed)
+{
+    LOG_RESULT("{\"model\": \"" << model << "\", \"scale\": " << scale << ", \"nodes\": " << graph.getNodeCount()
+	       << ", \"edges\": " << edges << ", \"phase\": \"" << phase << "\", \"seconds\": " << seconds
+	       << ", \"edges_per_second\": " << (seconds > 0 ? edgesProcessed / seconds : 0)
+	       << ", \"peak_rss_kb\": " << getPeakRss() << "}\n");
+}
+
+// Times each phase of ranking one generated graph
+static void benchmarkGraph(const char* model, unsigned scale, const GraphGenerator::Edges& generated,
+			   const BenchOptions& options, ThreadPool& threadPool)
+{
+    char filepath[] = "/tmp/pagerankbenchXXXXXX";
+    int descriptor = mkstemp(filepath);
+
+    if(descriptor < 0 || !GraphGenerator::writeLinksFile(generated, filepath))
+    {
+	LOG_RESULT("Failed to write links file for " << model << " scale " << scale << "\n");
+	exit(1);
+    }
+
+    close(descriptor);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    LinksFileParser linksFileParser;
+    linksFileParser.setThreadPool(&threadPool);
+    linksFileParser.parseFile(filepath);
+    double parseSeconds = getSecondsSince(start);
+
+    unlink(filepath);
+
+    start = std::chrono::steady_clock::now();
+    DirectedGraph graph(linksFileParser.getNodeCount());
+    linksFileParser.addNodesToGraph(graph);
+    double buildSeconds = getSecondsSince(start);
+    uint64_t edges = graph.getEdgeCount();
+
+    reportPhase(model, scale, graph, edges, "parse", parseSeconds, generated.size());
+    reportPhase(model, scale, graph, edges, "build", buildSeconds, generated.size());
+
+    PageRanker pageRanker;
+    pageRanker.setThreadPool(&threadPool);
+
+    start = std::chrono::steady_clock::now();
+    pageRanker.peelGraph(graph, PageRanker::PEEL_ORPHANS_AND_LEAKS);
+    reportPhase(model, scale, graph, edges, "peel", getSecondsSince(start), edges);
+
+    start = std::chrono::steady_clock::now();
+    ComponentFinder components;
+    components.findComponents(graph);
+    reportPhase(model, scale, graph, edges, "sinks", getSecondsSince(start), graph.getEdgeCount());
+
+    start = std::chrono::steady_clock::now();
+    pageRanker.rankGraphNodes(graph, 0.85f, options.iterations);
+    reportPhase(model, scale, graph, edges, "rank", getSecondsSince(start), graph.getEdgeCount() * options.iterations);
+}
+
+// show program usage
+static void showUsage()
+{
+    LOG_RESULT("Usage: pagerankbench [options]\n");
+    LOG_RESULT("Options:\n");
+    LOG_RESULT("  --scales <s1,s2,...>  log2 of the node count of each graph (default 12,14,16)\n");
+    LOG_RESULT("  --edge-factor <k>     edges per node (default 16)\n");
+    LOG_RESULT("  --threads <count>     number of threads used for parsing and ranking (default 1)\n");
+    LOG_RESULT("  --iterations <count>  ranking iterations (default 20)\n");
+    LOG_RESULT("  --dangling <fraction> fraction of nodes with no outbound links (default 0.1)\n");
+    LOG_RESULT("  --seed <seed>         seed for the graph generator (default 1)\n");
+}
+
+// Parses command line options, returns false if they are not understood
+static bool parseOptions(int argc, char* argv[], BenchOptions& options)
+{
+    for(int index = 1 ; index + 1 < argc ; index += 2)
+    {
+	std::string option(argv[index]);
+	std::stringstream ss(argv[index + 1]);
+	bool parsed;
+
+	if(option == "--scales")
+	{
+	    options.scales.clear();
+	    std::string scale;
+
+	    while(std::getline(ss, scale, ','))
+	    {
+		options.scales.push_back(atoi(scale.c_str()));
+	    }
+
+	    parsed = !options.scales.empty();
+	}
+	else if(option == "--edge-factor")
+	{
+	    parsed = ss >> options.edgeFactor && options.edgeFactor;
+	}
+	else if(option == "--threads")
+	{
+	    parsed = ss >> options.threads && options.threads;
+	}
+	else if(option == "--iterations")
+	{
+	    parsed = ss >> options.iterations && options.iterations;
+	}
+	else if(option == "--dangling")
+	{
+	    parsed = ss >> options.danglingFraction && options.danglingFraction >= 0 && options.danglingFraction < 1;
+	}
+	else if(option == "--seed")
+	{
+	    parsed = (bool)(ss >> options.seed);
+	}
+	else
+	{
+	    parsed = false;
+	}
+
+	if(!parsed)
+	{
+	    return false;
+	}
+    }
+
+    // options come in pairs
+    return argc % 2 == 1;
+}
+
+int main(int argc, char* argv[])
+{
+    BenchOptions options;
+
+    options.scales.push_back(12);
+    options.scales.push_back(14);
+    options.scales.push_back(16);
+
+    if(!parseOptions(argc, argv, options))
+    {
+	showUsage();
+	Logger::flush();
+	return 1;
+    }
+
+    // only the results are written
+    Logger::setVerbosity(Logger::VERBOSITY_QUIET);
+
+    ThreadPool threadPool(options.threads);
+    GraphGenerator generator(options.seed);
+    GraphGenerator::Edges edges;
+
+    generator.setDanglingFraction(options.danglingFraction);
+
+    for(unsigned scale : options.scales)
+    {
+	MatrixIndex nodecount = (MatrixIndex)1 << scale;
+	uint64_t edgecount = (uint64_t)nodecount * options.edgeFactor;
+
+	generator.generateRmat(scale, edgecount, edges);
+	benchmarkGraph("rmat", scale, edges, options, threadPool);
+
+	generator.generateErdosRenyi(nodecount, edgecount, edges);
+	benchmarkGraph("erdos-renyi", scale, edges, options, threadPool);
+
+	generator.generateWebGraph(nodecount, edgecount, edges);
+	benchmarkGraph("web", scale, edges, options, threadPool);
+    }
+
+    Logger::flush();
+
+    return 0;
+}
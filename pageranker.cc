@@ -3,79 +3,173 @@ This class finds page rank leaks, page rank sinks and calculates
 the page rank of the nodes in a given directed graph. It can remove
 orphan nodes (no inbound links) and nodes pointed to only by orphan
 nodes. It can also remove nodes with no outgoing links (rank leaks)
-although this is not done in a recursive fashion.
+and nodes which only link to rank leaks.
 
 ****************************************************************/
 
 #include "pageranker.h"
+#include "componentfinder.h"
+#include "logger.h"
+#include "metrics.h"
+#include "ranksum.h"
+#include "vectorkernels.h"
 
 #include <iostream>
-#include <list>
+#include <string>
+#include <cstring>
+#include <algorithm>
 #include <math.h>
 
-PageRanker::PageRanker():m_pageRankVector(NULL),m_outboundLinkCount(NULL),m_inboundLinkCount(NULL),m_atLeastOneInboundLink(NULL),m_atLeastOneOutboundLink(NULL){}
+PageRanker::PageRanker():m_pageRankVector(NULL),m_outboundLinkCount(NULL),m_inboundLinkCount(NULL),m_workspace(&m_ownedWorkspace),m_threadPool(NULL),m_tolerance(0),m_extrapolationInterval(0),m_rankPrecision(PRECISION_FLOAT),m_sumPrecision(PRECISION_FLOAT),m_compensatedSum(false),m_propagation(PROPAGATION_AUTOMATIC),m_binShift(0){}
 
 PageRanker::~PageRanker()
 {
-    delete[] m_pageRankVector;
-    delete[] m_outboundLinkCount;
-    delete[] m_inboundLinkCount;
-    delete[] m_atLeastOneInboundLink;
-    delete[] m_atLeastOneOutboundLink;
+}
+
+// Draw the degree, flag and rank vectors from the given workspace, which
+// must outlive the ranker. Rankers used one after another can share a
+// workspace, but the page ranks live in it so only the last ranking's are
+// kept. Any page ranks already calculated are dropped.
+void PageRanker::setWorkspace(RankWorkspace* workspace)
+{
+    m_workspace = workspace ? workspace : &m_ownedWorkspace;
+    m_pageRankVector = NULL;
+    m_outboundLinkCount = NULL;
+    m_inboundLinkCount = NULL;
+}
+
+// returns the workspace vectors are drawn from
+RankWorkspace& PageRanker::getWorkspace()
+{
+    return *m_workspace;
+}
+
+// Set the pool of threads used by rankGraphNodes(). The pool must outlive
+// the ranker. If no pool is set ranking runs on the calling thread.
+void PageRanker::setThreadPool(ThreadPool* threadpool)
+{
+    m_threadPool = threadpool;
+}
+
+// Stop ranking as soon as the L1 norm of the difference between the page rank
+// vectors of two consecutive iterations is below the tolerance. The number of
+// iterations passed to rankGraphNodes() is then the most that will be run.
+void PageRanker::setTolerance(PageRank tolerance)
+{
+    m_tolerance = tolerance;
+}
+
+// Extrapolate the page rank vector every interval iterations to speed up
+// convergence. An interval of 0 disables extrapolation.
+void PageRanker::setExtrapolation(uint32_t interval)
+{
+    m_extrapolationInterval = interval;
+}
+
+// Store ranks as float or double and sum each node's inbound contributions in
+// float or double, optionally with compensated summation. Float storage halves
+// the memory traffic of every iteration, while a double or compensated sum
+// keeps accuracy on nodes with many inbound links. Each combination is its
+// own instantiation of the ranking kernel.
+void PageRanker::setPrecision(RankPrecision storage, RankPrecision accumulator, bool compensated)
+{
+    m_rankPrecision = storage;
+    m_sumPrecision = accumulator;
+    m_compensatedSum = compensated;
+}
+
+// Pull rank along inbound links, or scatter it into bins of 2^binshift
+// destination nodes and add up each bin in turn (propagation blocking), which
+// keeps random accesses in cache once the rank vector outgrows the last level
+// cache. Automatic propagation blocks exactly then. A binshift of 0 sizes
+// bins to the L2 cache.
+void PageRanker::setPropagation(Propagation propagation, unsigned binshift)
+{
+    m_propagation = propagation;
+    m_binShift = binshift;
 }
 
 
-// Rank sinks are detected by the presence of nodes which have page rank along with
-// nodes which do not. Writes rank sinks to standard out.
+// Rank sinks are groups of nodes which link to each other but to no node
+// outside the group, so page rank flows into them and never leaves. They are
+// found exactly as the strongly connected components with no edges leaving
+// them. A closed component is only reported as a sink if it has at least one
+// edge (a single node with none is a leak) and some non-isolated node lies
+// outside every sink, otherwise all the rank stays where it is. Writes rank
+// sinks to standard out.
 void PageRanker::dumpRankSinks(const DirectedGraph& graph)
 {   
+    METRICS_PHASE("sinks");
+
     MatrixIndex numberOfNodes = graph.getNodeCount();
+    ComponentFinder components;
 
-    // calculate page rank using decay factor of 1
-    rankGraphNodes(graph, 1, SINK_DETECT_ITERATIONS);
+    components.findComponents(graph);
 
-    std::list<MatrixIndex> NodesWithZeroPageRank;
-    std::list<MatrixIndex> NodesWithNonZeroPageRank;
+    ComponentFinder::ComponentIndex numberOfSinks = 0;
+    MatrixIndex countOfNodesInSinks = 0;
+    MatrixIndex countOfOtherNodes = 0;
 
-    for(MatrixIndex i = 0 ; i < numberOfNodes ; ++i)
+    for(ComponentFinder::ComponentIndex component = 0 ; component < components.getComponentCount() ; ++component)
     {
-	// when counting nodes with zero page rank ignore isolated nodes (no in- or outbounds links)
-        if( (m_pageRankVector[i] < ZERO_PR_THRESHOLD) && (m_outboundLinkCount[i] || m_inboundLinkCount[i]))
+	if(components.isSink(component))
 	{
-	    NodesWithZeroPageRank.push_back(i);
+	    ++numberOfSinks;
+	    countOfNodesInSinks += components.getComponentSize(component);
 	}
-	else if(m_pageRankVector[i] >= ZERO_PR_THRESHOLD)
+    }
+
+    for(MatrixIndex i = 0 ; i < numberOfNodes ; ++i)
+    {
+	// ignore isolated nodes (no in- or outbound links)
+	if(!components.isSink(components.getComponent(i)) && (graph.getOutDegree(i) || graph.getInDegree(i)))
 	{
-	    NodesWithNonZeroPageRank.push_back(i);
+	    ++countOfOtherNodes;
 	}
     }
 
-    MatrixIndex countOfNodesWithZeroPageRank = NodesWithZeroPageRank.size();
-    MatrixIndex countOfNodesWithNonZeroPageRank = NodesWithNonZeroPageRank.size();
-   
-    std::cout << "##################" << std::endl;
-    std::cout << "Rank sink summary" << std::endl;
-    std::cout << "##################" << std::endl << std::endl;
+    LOG_SUMMARY("##################\n");
+    LOG_SUMMARY("Rank sink summary\n");
+    LOG_SUMMARY("##################\n\n");
 
-    std::cout << "There are " << countOfNodesWithZeroPageRank << " nodes with zero page rank (not including isolated nodes)" << std::endl;
-    std::cout << "There are " << countOfNodesWithNonZeroPageRank << " nodes with non-zero page rank " << std::endl;
-    std::cout << std::endl;
+    LOG_SUMMARY("There are " << components.getComponentCount() << " strongly connected components, " << numberOfSinks << " of them rank sinks\n");
+    LOG_SUMMARY("There are " << countOfNodesInSinks << " nodes in rank sinks\n");
+    LOG_SUMMARY("There are " << countOfOtherNodes << " nodes outside rank sinks (not including isolated nodes)\n");
+    LOG_SUMMARY("\n");
 
-    if(countOfNodesWithZeroPageRank && countOfNodesWithNonZeroPageRank)
+    if(numberOfSinks && countOfOtherNodes)
     {    
-	std::cout << "Sink node | PageRank" << std::endl;
-	
-	for(std::list<MatrixIndex>::iterator iter = NodesWithNonZeroPageRank.begin() ; iter != NodesWithNonZeroPageRank.end() ; ++iter)
-        {
-	    std::cout << graph.getNodeByIndex(*iter) << " (index " << *iter << ") " << m_pageRankVector[*iter] << std::endl;
+	LOG_SUMMARY("Sink component | Nodes\n");
+
+	for(ComponentFinder::ComponentIndex component = 0 ; component < components.getComponentCount() ; ++component)
+	{
+	    if(components.isSink(component))
+	    {
+		LOG_SUMMARY(component << " " << components.getComponentSize(component) << "\n");
+	    }
+	}
+
+	std::ostream& out = Logger::getStream();
+
+	// the sink nodes are the result of check mode so are written at every verbosity
+	out << "\nSink node | Component\n";
+
+	for(MatrixIndex i = 0 ; i < numberOfNodes ; ++i)
+	{
+	    ComponentFinder::ComponentIndex component = components.getComponent(i);
+
+	    if(components.isSink(component))
+	    {
+		out << graph.getNodeName(i) << " " << component << "\n";
+	    }
 	}
     }
     else
     {
-	std::cout << "NO SINK NODES WERE FOUND" << std::endl;
+	LOG_SUMMARY("NO SINK NODES WERE FOUND\n");
     }
 
-    std::cout << std::endl;
+    LOG_SUMMARY("\n");
 }
 
 // Remove orphan nodes (nodes with no inbound links) from the graph. Orphans
@@ -83,103 +177,154 @@ void PageRanker::dumpRankSinks(const DirectedGraph& graph)
 // also removed.
 void PageRanker::removeOrphanNodes(DirectedGraph& graph)
 {
-    std::cout << "#####################" << std::endl;
-    std::cout << "Removing orphan nodes" << std::endl;
-    std::cout << "#####################" << std::endl;
+    peelGraph(graph, PEEL_ORPHANS);
+}
+
+// Remove leak nodes (nodes with no outbound links, but with at least 1 inbound
+// link) from the graph. Leaks are removed recursively so nodes which only link
+// to leaks are also removed.
+void PageRanker::removeLeakNodes(DirectedGraph& graph)
+{
+    peelGraph(graph, PEEL_LEAKS);
+}
+
+// Recursively remove orphans (no inbound links but at least one outbound link),
+// leaks (no outbound links but at least one inbound link) or both. Every node's
+// in- and out-degree is counted once. Removing a node decrements the counts of
+// its neighbours and any neighbour left an orphan or leak is queued in turn, so
+// each node and edge is visited at most once. The graph itself is not touched
+// until the end, when all the queued nodes are removed in one pass.
+void PageRanker::peelGraph(DirectedGraph& graph, PeelMode mode)
+{
+    METRICS_PHASE("peel");
+
+    bool peelOrphans = mode & PEEL_ORPHANS;
+    bool peelLeaks = mode & PEEL_LEAKS;
+    const char* title = peelOrphans ? (peelLeaks ? "Removing orphan nodes and rank leaks" : "Removing orphan nodes") : "Removing rank leaks";
+
+    LOG_SUMMARY(std::string(strlen(title), '#') << "\n");
+    LOG_SUMMARY(title << "\n");
+    LOG_SUMMARY(std::string(strlen(title), '#') << "\n");
 
     MatrixIndex numberOfNodes = graph.getNodeCount();
     MatrixIndex numberOfOrphans = 0;
+    MatrixIndex numberOfRankLeaks = 0;
+
+    getOutBoundLinks(graph);
+    getInBoundLinks(graph);
 
-    getNodesWithAtLeastOneInBoundLink(graph);
-    getNodesWithAtLeastOneOutBoundLink(graph);
+    // degrees left once the nodes removed so far are gone
+    MatrixIndex* inDegree = m_inboundLinkCount;
+    MatrixIndex* outDegree = m_outboundLinkCount;
+    bool* isRemoved = m_workspace->get<bool>(RankWorkspace::NODE_FLAGS, numberOfNodes);
+    // nodes to remove, in the order they were found, no node is queued twice
+    MatrixIndex* worklist = m_workspace->get<MatrixIndex>(RankWorkspace::NODE_WORKLIST, numberOfNodes);
+    MatrixIndex worklistSize = 0;
 
-    for(MatrixIndex index = 0 ; index < numberOfNodes ; )
+    std::fill(isRemoved, isRemoved + numberOfNodes, false);
+
+    // queue a node if it is one of the kinds being removed
+    auto queueIfPeelable = [&](MatrixIndex node)
     {
-	if(!m_atLeastOneInboundLink[index] && m_atLeastOneOutboundLink[index])
+	if(peelOrphans && !inDegree[node] && outDegree[node])
 	{
-	    std::cout << "removing orphan node " << graph.getNodeByIndex(index) << std::endl;
-	    // removing an orphan might introduce other orphans
-	    // (i.e. nodes pointed to only by the orphan just removed 
-	    // so need to restart)
-	    graph.removeVertex(index);
-	    index = 0;
+	    LOG_DEBUG("removing orphan node " << graph.getNodeByIndex(node) << "\n");
 	    ++numberOfOrphans;
-	    getNodesWithAtLeastOneInBoundLink(graph);
-	    getNodesWithAtLeastOneOutBoundLink(graph);	
+	}
+	else if(peelLeaks && !outDegree[node] && inDegree[node])
+	{
+	    LOG_DEBUG("Removing rank leak node " << graph.getNodeByIndex(node) << "\n");
+	    ++numberOfRankLeaks;
 	}
 	else
 	{
-	    ++index;
+	    return;
 	}
+
+	isRemoved[node] = true;
+	worklist[worklistSize++] = node;
+    };
+
+    for(MatrixIndex node = 0 ; node < numberOfNodes ; ++node)
+    {
+	queueIfPeelable(node);
     }
 
-    std::cout << "Number of orphans removed: " << numberOfOrphans << std::endl << std::endl;
-}
- 
-// Show rank leaks in a graph.
-void PageRanker::dumpRankLeaks(const DirectedGraph& graph)
-{
-    std::cout << "#########################" << std::endl;
-    std::cout << "Looking for rank leaks..." << std::endl;
-    std::cout << "#########################" << std::endl << std::endl;
+    for(MatrixIndex next = 0 ; next < worklistSize ; ++next)
+    {
+	MatrixIndex node = worklist[next];
 
-    MatrixIndex numberOfNodes = graph.getNodeCount();
-    MatrixIndex numberOfRankLeaks = 0;
-    bool* isNodeRankLeak = new bool[numberOfNodes];
+	graph.forEachOutNeighbour(node, [&](MatrixIndex tonode)
+	{
+	    if(!isRemoved[tonode])
+	    {
+		--inDegree[tonode];
+		queueIfPeelable(tonode);
+	    }
+	});
 
-    findLeakNodes(isNodeRankLeak, graph, numberOfNodes);
+	graph.forEachInNeighbour(node, [&](MatrixIndex fromnode)
+	{
+	    if(!isRemoved[fromnode])
+	    {
+		--outDegree[fromnode];
+		queueIfPeelable(fromnode);
+	    }
+	});
+    }
 
-    for(MatrixIndex index = 0 ; index < numberOfNodes ; ++index)
+    graph.removeVertices(isRemoved);
+
+    METRICS_COUNT("orphans_removed", numberOfOrphans);
+    METRICS_COUNT("leaks_removed", numberOfRankLeaks);
+
+    if(peelOrphans)
     {
-	if(isNodeRankLeak[index])
-	{
-	    std::cout << "Node " << graph.getNodeByIndex(index) << " is a rank leak " << std::endl;
-	    ++numberOfRankLeaks;
-	}
+	LOG_SUMMARY("Number of orphans removed: " << numberOfOrphans << "\n");
     }
 
-    std::cout << "Number of rank leaks detected: " << numberOfRankLeaks << std::endl << std::endl;
+    if(peelLeaks)
+    {
+	LOG_SUMMARY("Number of rank leak nodes removed: " << numberOfRankLeaks << "\n");
+    }
 
-    delete[] isNodeRankLeak;
+    LOG_SUMMARY("\n");
 }
-
-// Remove leak nodes (nodes with no outbound links, but with at least 1 inbound
-// link) from the graph
-void PageRanker::removeLeakNodes(DirectedGraph& graph)
+ 
+// Show rank leaks in a graph.
+void PageRanker::dumpRankLeaks(const DirectedGraph& graph)
 {
-    std::cout << "###################" << std::endl;
-    std::cout << "Removing rank leaks" << std::endl;
-    std::cout << "###################" << std::endl;
+    METRICS_PHASE("leaks");
+
+    LOG_SUMMARY("#########################\n");
+    LOG_SUMMARY("Looking for rank leaks...\n");
+    LOG_SUMMARY("#########################\n\n");
 
     MatrixIndex numberOfNodes = graph.getNodeCount();
     MatrixIndex numberOfRankLeaks = 0;
-    bool* isNodeRankLeak = new bool[numberOfNodes];
+    bool* isNodeRankLeak = m_workspace->get<bool>(RankWorkspace::NODE_FLAGS, numberOfNodes);
 
     findLeakNodes(isNodeRankLeak, graph, numberOfNodes);
 
+    std::ostream& out = Logger::getStream();
+
+    // the leaks are a result of check mode so are written at every verbosity
     for(MatrixIndex index = 0 ; index < numberOfNodes ; ++index)
     {
 	if(isNodeRankLeak[index])
 	{
-	    std::cout << "Removing rank leak node " << graph.getNodeByIndex(index) << std::endl;
-	    graph.removeVertex(index); 
+	    out << "Node " << graph.getNodeName(index) << " is a rank leak\n";
 	    ++numberOfRankLeaks;
 	}
     }
 
-    std::cout << "Number of rank leak nodes removed: " << numberOfRankLeaks << std::endl << std::endl;
-
-    delete[] isNodeRankLeak;
+    LOG_SUMMARY("Number of rank leaks detected: " << numberOfRankLeaks << "\n\n");
 }
- 
+
 // Find leak nodes (nodes with no outbound links, but with at least 1 inbound
 // link) in graph and store in bool array isNodeRankLeak
 void PageRanker::findLeakNodes(bool* isNodeRankLeak, const DirectedGraph& graph, MatrixIndex numberOfNodes)
 {
-    // used to distinguish a leak from a node with neither 
-    // outbound nor inbound links
-    bool atLeastOneInboundLink = false;
-
     getOutBoundLinks(graph);
     getInBoundLinks(graph);
 
@@ -197,73 +342,16 @@ void PageRanker::findLeakNodes(bool* isNodeRankLeak, const DirectedGraph& graph,
     } 
 }
 
-// populate bool array indicating if a node has at least one outbound link
-// This is quicker than counting the total number of outbound links
-void PageRanker::getNodesWithAtLeastOneOutBoundLink(const DirectedGraph& graph)
-{
-    MatrixIndex numberOfNodes = graph.getNodeCount();
-
-    delete[] m_atLeastOneOutboundLink;
-
-    m_atLeastOneOutboundLink = new bool[numberOfNodes];
-    memset(m_atLeastOneOutboundLink, '\0', sizeof(bool)*numberOfNodes);
-
-    for(MatrixIndex fromnode = 0 ; fromnode < numberOfNodes ; ++fromnode)
-    {
-        for(MatrixIndex tonode = 0 ; tonode < numberOfNodes ; ++tonode)
-	{
-	    if(graph.isEdge(fromnode,tonode))
-	    {
-		m_atLeastOneOutboundLink[fromnode] = true;
-		break;
-	    }
-	}
-    }
-}
-
-// populate bool array indicating if a node has at least one inbound link
-// This is quicker than counting the total number of inbound links
-void PageRanker::getNodesWithAtLeastOneInBoundLink(const DirectedGraph& graph)
-{
-    MatrixIndex numberOfNodes = graph.getNodeCount();
-
-    delete[] m_atLeastOneInboundLink;
-
-    m_atLeastOneInboundLink = new bool[numberOfNodes];
-    memset(m_atLeastOneInboundLink, '\0', sizeof(bool)*numberOfNodes);
-
-    for(MatrixIndex tonode = 0 ; tonode < numberOfNodes ; ++tonode)
-    {
-        for(MatrixIndex fromnode = 0 ; fromnode < numberOfNodes ; ++fromnode)
-	{
-	    if(graph.isEdge(fromnode,tonode))
-	    {
-		m_atLeastOneInboundLink[tonode] = true;
-		break;
-	    }
-	}
-    }
-}
-
 // populate array holding count of outbound links for each node in graph
 void PageRanker::getOutBoundLinks(const DirectedGraph& graph)
 {
     MatrixIndex numberOfNodes = graph.getNodeCount();
 
-    delete[] m_outboundLinkCount;
-
-    m_outboundLinkCount = new MatrixIndex[numberOfNodes];
-    memset(m_outboundLinkCount, '\0', sizeof(MatrixIndex)*numberOfNodes);
+    m_outboundLinkCount = m_workspace->get<MatrixIndex>(RankWorkspace::OUTBOUND_LINK_COUNTS, numberOfNodes);
 
     for(MatrixIndex fromnode = 0 ; fromnode < numberOfNodes ; ++fromnode)
     {
-        for(MatrixIndex tonode = 0 ; tonode < numberOfNodes ; ++tonode)
-	{
-	    if(graph.isEdge(fromnode,tonode))
-	    {
-		++m_outboundLinkCount[fromnode];
-	    }
-	}
+	m_outboundLinkCount[fromnode] = graph.getOutDegree(fromnode);
     }
 }
 
@@ -272,20 +360,11 @@ void PageRanker::getInBoundLinks(const DirectedGraph& graph)
 {
     MatrixIndex numberOfNodes = graph.getNodeCount();
 
-    delete[] m_inboundLinkCount;
-
-    m_inboundLinkCount = new MatrixIndex[numberOfNodes];
-    memset(m_inboundLinkCount, '\0', sizeof(MatrixIndex)*numberOfNodes);
+    m_inboundLinkCount = m_workspace->get<MatrixIndex>(RankWorkspace::INBOUND_LINK_COUNTS, numberOfNodes);
 
     for(MatrixIndex tonode = 0 ; tonode < numberOfNodes ; ++tonode)
     {
-        for(MatrixIndex fromnode = 0 ; fromnode < numberOfNodes ; ++fromnode)
-	{
-	    if(graph.isEdge(fromnode,tonode))
-	    {
-		++m_inboundLinkCount[tonode];
-	    }
-	}
+	m_inboundLinkCount[tonode] = graph.getInDegree(tonode);
     }
 }
 
@@ -295,9 +374,11 @@ void PageRanker::getInBoundLinks(const DirectedGraph& graph)
 // Before calling this you may first want to call removeLeakNodes() and removeOrphanNodes() on the graph.
 void PageRanker::rankGraphNodes(const DirectedGraph& graph, float decayfactor, uint32_t iterations)
 {
-    std::cout << "########################" << std::endl;
-    std::cout << "Calculating page rank..." << std::endl;
-    std::cout << "########################" << std::endl;
+    METRICS_PHASE("rank");
+
+    LOG_SUMMARY("########################\n");
+    LOG_SUMMARY("Calculating page rank...\n");
+    LOG_SUMMARY("########################\n");
 
     MatrixIndex numberOfNodes = graph.getNodeCount();
 
@@ -307,24 +388,112 @@ void PageRanker::rankGraphNodes(const DirectedGraph& graph, float decayfactor, u
     // Count of how many nodes have no inbound or outbound links
     MatrixIndex isolatedNodeCount = 0;
 
-    // Find nodes with no edges (this includes the nodes removed by removeLeakNodes() 
-    // and removeOrphanNodes()). These nodes will be ignored during pagerank calculation.
+    // Find nodes with no edges (this includes the nodes removed by peelGraph()).
+    // These nodes will be ignored during pagerank calculation.
     for(MatrixIndex index = 0 ; index < numberOfNodes ; ++index)
     {
         if(!m_outboundLinkCount[index] && !m_inboundLinkCount[index])
 	{
 	    ++isolatedNodeCount;
-	    std::cout << "Isolated node " << graph.getNodeByIndex(index) << " will be ignored " << std::endl;
+	    LOG_DEBUG("Isolated node " << graph.getNodeByIndex(index) << " will be ignored \n");
 	}
     }
-    std::cout << std::endl;
+    LOG_SUMMARY(isolatedNodeCount << " isolated nodes will be ignored\n\n");
 
-    delete[] m_pageRankVector;
-    m_pageRankVector = new PageRank[numberOfNodes];
-    PageRank* previousPageRankVector = new float[numberOfNodes];
+    if(m_rankPrecision == PRECISION_DOUBLE)
+    {
+	rankWithStorage<double>(graph, decayfactor, iterations, isolatedNodeCount);
+    }
+    else
+    {
+	rankWithStorage<float>(graph, decayfactor, iterations, isolatedNodeCount);
+    }
+}
+
+// pick the kernel for the accumulator type and summation chosen
+template<typename Storage>
+void PageRanker::rankWithStorage(const DirectedGraph& graph, float decayfactor, uint32_t iterations, MatrixIndex isolatedNodeCount)
+{
+    if(m_sumPrecision == PRECISION_DOUBLE)
+    {
+	if(m_compensatedSum)
+	{
+	    rankWithPrecision<Storage, CompensatedSum<double> >(graph, decayfactor, iterations, isolatedNodeCount);
+	}
+	else
+	{
+	    rankWithPrecision<Storage, PlainSum<double> >(graph, decayfactor, iterations, isolatedNodeCount);
+	}
+    }
+    else
+    {
+	if(m_compensatedSum)
+	{
+	    rankWithPrecision<Storage, CompensatedSum<float> >(graph, decayfactor, iterations, isolatedNodeCount);
+	}
+	else
+	{
+	    rankWithPrecision<Storage, PlainSum<float> >(graph, decayfactor, iterations, isolatedNodeCount);
+	}
+    }
+}
+
+// The ranking kernel for one pairing of precisions. The ranks are stored as
+// Storage, so float halves the memory traffic of every iteration, and each
+// node's inbound contributions and each thread's residual are summed with Sum.
+// The final ranks are reported as PageRank whatever they were stored as.
+template<typename Storage, typename Sum>
+void PageRanker::rankWithPrecision(const DirectedGraph& graph, float decayfactor, uint32_t iterations, MatrixIndex isolatedNodeCount)
+{
+    typedef typename Sum::ValueType Accumulator;
+
+    MatrixIndex numberOfNodes = graph.getNodeCount();
+    ThreadPool serialThreadPool(1);
+    ThreadPool& threadPool = m_threadPool ? *m_threadPool : serialThreadPool;
+    unsigned threadCount = threadPool.getThreadCount();
+
+    // every vector comes from the workspace, so ranking a graph no larger
+    // than the last one allocates nothing
+    Storage* pageRankVector = m_workspace->get<Storage>(RankWorkspace::PAGE_RANKS, numberOfNodes);
+    Storage* previousPageRankVector = m_workspace->get<Storage>(RankWorkspace::PREVIOUS_PAGE_RANKS, numberOfNodes);
+    // 1/(outbound link count) for each node, zero for nodes with no outbound links
+    Storage* inverseOutboundLinkCount = m_workspace->get<Storage>(RankWorkspace::INVERSE_OUTBOUND_LINK_COUNTS, numberOfNodes);
+
+    // Plain sums in the storage type are done by the vector kernels chosen for
+    // this CPU, gathering contributions straight from the sparse columns when
+    // there are some. Other sums need a Sum per node so are done here.
+    const VectorKernelTable<Storage>& kernels = VectorKernels::get<Storage>();
+    const bool useVectorKernels = std::is_same<Sum, PlainSum<Storage> >::value;
+    const EdgeIndex* inOffsets = NULL;
+    const MatrixIndex* inDegrees = NULL;
+    const MatrixIndex* inNeighbours = NULL;
+    const bool isSparse = graph.getInNeighbourArrays(inOffsets, inDegrees, inNeighbours);
+
+    // Propagation blocking adds up contributions bin by bin so needs plain sums
+    bool blocked = m_propagation == PROPAGATION_BLOCKED ||
+		   (m_propagation == PROPAGATION_AUTOMATIC && (uint64_t)numberOfNodes*sizeof(Storage) > PropagationBins::getLastLevelCacheSize());
+
+    if(blocked && !useVectorKernels)
+    {
+	LOG_SUMMARY("Propagation blocking needs plain sums in the storage precision, pulling rank instead\n");
+	blocked = false;
+    }
+
+    // Rank each node passes along every one of its outbound links. Double buffered
+    // so a thread can start the next iteration while others still read this one's.
+    // Propagation blocking writes the rank passed along each edge into its bins instead.
+    Storage* contributionVectors[2] = {NULL, NULL};
+
+    if(!blocked)
+    {
+	contributionVectors[0] = m_workspace->get<Storage>(RankWorkspace::CONTRIBUTIONS, numberOfNodes);
+	contributionVectors[1] = m_workspace->get<Storage>(RankWorkspace::NEXT_CONTRIBUTIONS, numberOfNodes);
+    }
+
+    MatrixIndex rankedNodeCount = numberOfNodes - isolatedNodeCount;
 
     // initial page rank is evenly distributed
-    PageRank initialrank = (float)1/ (numberOfNodes-isolatedNodeCount);
+    Storage initialrank = (Storage)1 / rankedNodeCount;
 
     for(MatrixIndex i = 0 ; i < numberOfNodes ; ++i)
     {
@@ -335,69 +504,571 @@ void PageRanker::rankGraphNodes(const DirectedGraph& graph, float decayfactor, u
 	}
 	else
 	{
-            previousPageRankVector[i] = initialrank;
-        }
+	    previousPageRankVector[i] = initialrank;
+	}
+
+	inverseOutboundLinkCount[i] = m_outboundLinkCount[i] ? (Storage)1 / m_outboundLinkCount[i] : 0;
+    }
+
+    // share of the rank every non-isolated node receives from random jumps
+    Accumulator teleport = (Accumulator)( (1 - (Accumulator)decayfactor) / rankedNodeCount );
+
+    // rank each node receives from random jumps, zero for isolated nodes
+    Storage* teleportVector = NULL;
+
+    if(useVectorKernels)
+    {
+	teleportVector = m_workspace->get<Storage>(RankWorkspace::TELEPORTS, numberOfNodes);
+
+	for(MatrixIndex i = 0 ; i < numberOfNodes ; ++i)
+	{
+	    teleportVector[i] = (m_outboundLinkCount[i] || m_inboundLinkCount[i]) ? (Storage)teleport : 0;
+	}
+
+	LOG_SUMMARY("Ranking with " << VectorKernels::getInstructionSetName(VectorKernels::getInstructionSet()) << " vector kernels\n");
+    }
+
+    memcpy(pageRankVector, previousPageRankVector, sizeof(Storage)*numberOfNodes);
+
+    // each thread updates a range of nodes with roughly the same number of inbound links
+    std::vector<MatrixIndex>& partitions = m_partitions;
+    // rank passed along each edge, in the order of the propagation bins
+    Storage* binContributions = NULL;
+
+    if(blocked)
+    {
+	// each thread scatters the rank of a range of nodes with roughly the same
+	// number of outbound links, then adds up a run of bins with roughly the same
+	// number of edges, which gives the range of nodes it updates
+	partitionNodesByOutboundLinks(graph, threadCount, m_sourcePartitions);
+
+	unsigned binshift = m_binShift ? m_binShift : PropagationBins::chooseBinShift(numberOfNodes, sizeof(Storage), threadCount);
+
+	m_propagationBins.build(graph, binshift, m_sourcePartitions, partitions, *m_workspace, threadPool);
+	binContributions = m_workspace->get<Storage>(RankWorkspace::BIN_CONTRIBUTIONS, m_propagationBins.getSlotCount());
+
+	LOG_SUMMARY("Propagating rank through " << m_propagationBins.getBinCount() << " bins of " << ((uint64_t)1 << binshift) << " nodes\n");
+    }
+    else
+    {
+	partitionNodesByInboundLinks(graph, threadCount, partitions);
     }
 
-    memset(m_pageRankVector,'\0',sizeof(MatrixIndex)*numberOfNodes);
+    // each thread's share of the L1 residual, double buffered by iteration
+    std::vector<PartialSums>& partialResiduals = m_partialResiduals;
+    partialResiduals.resize(2*threadCount);
+    // each thread's share of the sums needed to extrapolate
+    std::vector<PartialSums>& partialExtrapolationSums = m_partialExtrapolationSums;
+    partialExtrapolationSums.resize(threadCount);
+    // iterates from two and three iterations back, only needed when extrapolating
+    Storage* olderPageRankVectors[2] = {NULL, NULL};
+
+    if(m_extrapolationInterval)
+    {
+	olderPageRankVectors[0] = m_workspace->get<Storage>(RankWorkspace::OLDER_PAGE_RANKS, numberOfNodes);
+	olderPageRankVectors[1] = m_workspace->get<Storage>(RankWorkspace::OLDEST_PAGE_RANKS, numberOfNodes);
+    }
 
-    // perform pagerank calculation
-    for(uint32_t iteration = 0 ; iteration < iterations ; ++iteration)
+    m_residualHistory.clear();
+    uint32_t iterationsRun = iterations;
+    Storage* finalPageRankVector = NULL;
+
+    // Perform pagerank calculation, each node pulls rank along its inbound links.
+    // A thread only writes contributions and ranks for its own range of nodes, so
+    // the one barrier per iteration is between writing the contributions and
+    // reading the contributions of other threads' nodes. The residual of the
+    // previous iteration is summed after the barrier, when every thread's share
+    // is known, so all threads agree on when to stop. With propagation blocking
+    // a thread scatters the rank of nodes other threads update, so there is a
+    // second barrier once every thread's ranks are written.
+    threadPool.run([&](unsigned threadindex)
     {
-        for(MatrixIndex tonode = 0 ; tonode < numberOfNodes ; ++tonode)
+	MatrixIndex begin = partitions[threadindex];
+	MatrixIndex end = partitions[threadindex + 1];
+	Storage* previous = previousPageRankVector;
+	Storage* current = pageRankVector;
+	uint32_t iteration = 0;
+
+	for( ; iteration < iterations ; ++iteration)
 	{
-	    m_pageRankVector[tonode] = 0;
+	    Storage* contributionVector = contributionVectors[iteration & 1];
+
+	    if(blocked)
+	    {
+		m_propagationBins.scatter(graph, previous, inverseOutboundLinkCount, threadindex, binContributions);
+	    }
+	    else
+	    {
+		kernels.multiply(contributionVector + begin, previous + begin, inverseOutboundLinkCount + begin, end - begin);
+	    }
+
+	    // current still holds the ranks from two iterations back, keep them
+	    // if they will be needed to extrapolate
+	    bool extrapolateAfterIteration = isExtrapolationIteration(iteration);
+
+	    if(extrapolateAfterIteration)
+	    {
+		memcpy(olderPageRankVectors[0] + begin, current + begin, sizeof(Storage)*(end - begin));
+	    }
+
+	    if(isExtrapolationIteration(iteration + 1))
+	    {
+		memcpy(olderPageRankVectors[1] + begin, current + begin, sizeof(Storage)*(end - begin));
+	    }
+
+	    threadPool.barrier();
 
-	    if(m_outboundLinkCount[tonode] || m_inboundLinkCount[tonode])
+	    if(iteration)
 	    {
-	        for(MatrixIndex fromnode = 0 ; fromnode < numberOfNodes ; ++fromnode)
-	        {        
-	            if(graph.isEdge(fromnode,tonode))
-	 	    {
-		        m_pageRankVector[tonode] += 1 * (PageRank)1/m_outboundLinkCount[fromnode] * previousPageRankVector[fromnode];
+		double residual = 0;
+
+		for(unsigned thread = 0 ; thread < threadCount ; ++thread)
+		{
+		    residual += partialResiduals[((iteration - 1) & 1)*threadCount + thread].value[0];
+		}
+
+		if(threadindex == 0)
+		{
+		    m_residualHistory.push_back(residual);
+		}
+
+		if(residual < m_tolerance)
+		{
+		    break;
+		}
+	    }
+
+	    double& partialResidual = partialResiduals[(iteration & 1)*threadCount + threadindex].value[0];
+
+	    if(useVectorKernels)
+	    {
+		// sum the inbound contributions of every node in the range, then
+		// apply the decay factor and teleport to the whole range at once
+		if(blocked)
+		{
+		    m_propagationBins.accumulate(binContributions, threadindex, current);
+		}
+		else if(isSparse)
+		{
+		    kernels.gatherSums(current, contributionVector, inOffsets, inDegrees, inNeighbours, begin, end);
+		}
+		else
+		{
+		    for(MatrixIndex tonode = begin ; tonode < end ; ++tonode)
+		    {
+			Storage sum = 0;
+
+			graph.forEachInNeighbour(tonode, [&sum, contributionVector](MatrixIndex fromnode)
+			{
+			    sum += contributionVector[fromnode];
+			});
+
+			current[tonode] = sum;
+		    }
+		}
+
+		partialResidual = kernels.decayAndSumResidual(current + begin, previous + begin, teleportVector + begin,
+							      (Storage)decayfactor, end - begin);
+	    }
+	    else
+	    {
+		Sum residual;
+
+		for(MatrixIndex tonode = begin ; tonode < end ; ++tonode)
+		{
+		    if(m_outboundLinkCount[tonode] || m_inboundLinkCount[tonode])
+		    {
+			Sum sum;
+
+			graph.forEachInNeighbour(tonode, [&sum, contributionVector](MatrixIndex fromnode)
+			{
+			    sum.add(contributionVector[fromnode]);
+			});
+
+			// apply the decay factor
+			current[tonode] = (Storage)((decayfactor * sum.get()) + teleport);
+		    }
+		    else
+		    {
+			current[tonode] = 0;
 		    }
-	        }
 
-	        // apply the decay factor
-	        m_pageRankVector[tonode] = (decayfactor * m_pageRankVector[tonode]) + (PageRank)( (1 - decayfactor) / (numberOfNodes-isolatedNodeCount) );
-            }
+		    residual.add(fabs((Accumulator)current[tonode] - previous[tonode]));
+		}
+
+		partialResidual = residual.get();
+	    }
+
+	    if(extrapolateAfterIteration)
+	    {
+		Storage* iterates[4] = {current, previous, olderPageRankVectors[0], olderPageRankVectors[1]};
+		extrapolate(threadPool, threadindex, iterates, begin, end, partialExtrapolationSums);
+	    }
+
+	    if(blocked)
+	    {
+		// every rank is written before any thread scatters them
+		threadPool.barrier();
+	    }
+
+	    Storage* tmpPrevious = previous;
+	    previous = current;
+	    current = tmpPrevious;
 	}
-    
-	PageRank* tmpPreviousPageRankVector = previousPageRankVector;
-	previousPageRankVector = m_pageRankVector;
-	m_pageRankVector = tmpPreviousPageRankVector;
+
+	if(threadindex == 0)
+	{
+	    iterationsRun = iteration;
+	    finalPageRankVector = previous;
+	}
+    });
+
+    // the final ranks are in whichever vector the threads wrote last
+    if(finalPageRankVector != pageRankVector)
+    {
+	Storage* tmpPreviousPageRankVector = previousPageRankVector;
+	previousPageRankVector = pageRankVector;
+	pageRankVector = tmpPreviousPageRankVector;
+    }
+
+    storeRankResults(pageRankVector, numberOfNodes);
+
+    if(iterationsRun == iterations && iterations)
+    {
+	// the residual of the final iteration has not been summed yet
+	double residual = 0;
+
+	for(unsigned threadindex = 0 ; threadindex < threadCount ; ++threadindex)
+	{
+	    residual += partialResiduals[((iterations - 1) & 1)*threadCount + threadindex].value[0];
+	}
+
+	m_residualHistory.push_back(residual);
     }
 
-    std::cout << "Magnitude of difference between page rank vectors in final two iterations: ";
-    std::cout << getDifferenceVectorMagnitude(m_pageRankVector, previousPageRankVector, numberOfNodes) << std::endl << std::endl;
+    METRICS_COUNT("iterations", iterationsRun);
+    METRICS_COUNT("edges_processed", graph.getEdgeCount() * iterationsRun);
+    METRICS_RESIDUALS(m_residualHistory);
 
-    delete[] previousPageRankVector;
+    if(iterationsRun < iterations)
+    {
+	LOG_SUMMARY("Converged after " << iterationsRun << " iterations (L1 residual below " << m_tolerance << ")\n");
+    }
+    else
+    {
+	LOG_SUMMARY("Stopped after " << iterationsRun << " iterations\n");
+    }
+
+    if(!m_residualHistory.empty())
+    {
+	LOG_SUMMARY("L1 norm of difference between page rank vectors in final two iterations: " << m_residualHistory.back() << "\n");
+    }
+
+    LOG_SUMMARY("Magnitude of difference between page rank vectors in final two iterations: ");
+    LOG_SUMMARY(getDifferenceVectorMagnitude(pageRankVector, previousPageRankVector, numberOfNodes) << "\n\n");
 }
 
-// Returns the magnitude of the difference of two vectors
-float PageRanker::getDifferenceVectorMagnitude(PageRank* a, PageRank* b, MatrixIndex length)
+// Ranks stored as PageRank are reported as they are
+void PageRanker::storeRankResults(PageRank* ranks, MatrixIndex)
+{
+    m_pageRankVector = ranks;
+}
+
+// Ranks stored in another type are converted to PageRank for reporting
+template<typename Storage>
+void PageRanker::storeRankResults(const Storage* ranks, MatrixIndex length)
+{
+    m_pageRankVector = m_workspace->get<PageRank>(RankWorkspace::RANK_RESULTS, length);
+    std::copy(ranks, ranks + length, m_pageRankVector);
+}
+
+// The page rank vector is extrapolated every m_extrapolationInterval iterations,
+// once there are the four iterates quadratic extrapolation needs
+bool PageRanker::isExtrapolationIteration(uint32_t iteration) const
+{
+    return m_extrapolationInterval && iteration + 1 >= 4 && (iteration + 1) % m_extrapolationInterval == 0;
+}
+
+// Replace the latest ranks of nodes begin .. end with an extrapolated estimate of
+// the converged ranks. iterates[0] is the latest page rank vector, iterates[1] the
+// one before and so on, four iterates are used. Every thread in the pool must
+// call this for its own range of nodes, as the threads' sums are combined.
+template<typename Storage>
+void PageRanker::extrapolate(ThreadPool& threadPool, unsigned threadindex, Storage* const* iterates,
+			     MatrixIndex begin, MatrixIndex end, std::vector<PartialSums>& partialSums)
+{
+    Storage* current = iterates[0];
+    const Storage* previous = iterates[1];
+    const Storage* older = iterates[2];
+    const Storage* oldest = iterates[3];
+
+    // Quadratic extrapolation assumes the error in the iterates is made up of
+    // the two slowest decaying eigenvectors, so the last three differences
+    // between iterates d1, d2, d3 satisfy d1 + c1*d2 + c0*d3 = 0 and the converged
+    // ranks are (x[k] + c1*x[k-1] + c0*x[k-2]) / (1 + c1 + c0). c0 and c1 come from
+    // a least squares fit over every node, sums[0] .. sums[4] holding this
+    // thread's share of the normal equations.
+    double* sums = partialSums[threadindex].value;
+
+    for(int i = 0 ; i < PARTIAL_SUM_COUNT ; ++i)
+    {
+	sums[i] = 0;
+    }
+
+    for(MatrixIndex node = begin ; node < end ; ++node)
+    {
+	double d1 = (double)current[node] - previous[node];
+	double d2 = (double)previous[node] - older[node];
+	double d3 = (double)older[node] - oldest[node];
+
+	sums[0] += d2*d2;
+	sums[1] += d2*d3;
+	sums[2] += d3*d3;
+	sums[3] += d2*d1;
+	sums[4] += d3*d1;
+    }
+
+    threadPool.barrier();
+
+    double total[PARTIAL_SUM_COUNT] = {0, 0, 0, 0, 0};
+
+    for(unsigned thread = 0 ; thread < threadPool.getThreadCount() ; ++thread)
+    {
+	for(int i = 0 ; i < PARTIAL_SUM_COUNT ; ++i)
+	{
+	    total[i] += partialSums[thread].value[i];
+	}
+    }
+
+    double determinant = total[0]*total[2] - total[1]*total[1];
+
+    if(determinant <= EXTRAPOLATION_MIN_DENOMINATOR*total[0]*total[2])
+    {
+	// differences are (nearly) parallel, there is nothing to cancel
+	return;
+    }
+
+    double c1 = -(total[2]*total[3] - total[1]*total[4]) / determinant;
+    double c0 = -(total[0]*total[4] - total[1]*total[3]) / determinant;
+    double normaliser = 1 + c1 + c0;
+
+    if(fabs(normaliser) <= EXTRAPOLATION_MIN_DENOMINATOR)
+    {
+	return;
+    }
+
+    for(MatrixIndex node = begin ; node < end ; ++node)
+    {
+	current[node] = (Storage)((current[node] + c1*previous[node] + c0*older[node]) / normaliser);
+    }
+}
+
+// Returns the L1 residual of each iteration of the last ranking, the
+// first entry is the change made by the first iteration
+const std::vector<PageRanker::PageRank>& PageRanker::getResidualHistory() const
 {
-    float magnitude = 0;
+    return m_residualHistory;
+}
 
-    for(MatrixIndex i = 0 ; i < length ; ++i)
+// show L1 residual of each iteration of the last ranking (debug output only)
+void PageRanker::dumpResidualHistory()
+{
+    if(!Logger::isEnabled(Logger::VERBOSITY_DEBUG))
     {
-        magnitude += powf((a[i] - b[i]),2);
+	return;
     }
 
-    magnitude = sqrt(magnitude);
+    std::ostream& out = Logger::getStream();
+
+    out << "Iteration | L1 residual\n";
+
+    for(size_t iteration = 0 ; iteration < m_residualHistory.size() ; ++iteration)
+    {
+	out << iteration + 1 << " " << m_residualHistory[iteration] << "\n";
+    }
 
-    return magnitude;
+    out << "\n";
 }
 
-// to be used for printing page rank vector
+// Split the nodes into one contiguous range per partition, weighting each
+// node by its outbound link count plus one (see partitionNodesByInboundLinks())
+void PageRanker::partitionNodesByOutboundLinks(const DirectedGraph& graph, unsigned partitionCount, std::vector<MatrixIndex>& boundaries)
+{
+    MatrixIndex numberOfNodes = graph.getNodeCount();
+    uint64_t totalWork = graph.getEdgeCount() + numberOfNodes;
+    uint64_t work = 0;
+    unsigned partition = 1;
+
+    boundaries.assign(partitionCount + 1, numberOfNodes);
+    boundaries[0] = 0;
+
+    for(MatrixIndex node = 0 ; node < numberOfNodes && partition < partitionCount ; ++node)
+    {
+	while(partition < partitionCount && work >= totalWork * partition / partitionCount)
+	{
+	    boundaries[partition++] = node;
+	}
+
+	work += graph.getOutDegree(node) + 1;
+    }
+}
+
+// Split the nodes into one contiguous range per partition. Each node is
+// weighted by its inbound link count plus one, so the ranges do a similar
+// amount of work even when a few nodes have most of the inbound links.
+// boundaries[p] .. boundaries[p + 1] is the range of partition p.
+void PageRanker::partitionNodesByInboundLinks(const DirectedGraph& graph, unsigned partitionCount, std::vector<MatrixIndex>& boundaries)
+{
+    MatrixIndex numberOfNodes = graph.getNodeCount();
+    uint64_t totalWork = graph.getEdgeCount() + numberOfNodes;
+    uint64_t work = 0;
+    unsigned partition = 1;
+
+    boundaries.assign(partitionCount + 1, numberOfNodes);
+    boundaries[0] = 0;
+
+    for(MatrixIndex node = 0 ; node < numberOfNodes && partition < partitionCount ; ++node)
+    {
+	while(partition < partitionCount && work >= totalWork * partition / partitionCount)
+	{
+	    boundaries[partition++] = node;
+	}
+
+	work += graph.getInDegree(node) + 1;
+    }
+}
+
+// Returns the magnitude of the difference of two vectors
+template<typename Storage>
+double PageRanker::getDifferenceVectorMagnitude(const Storage* a, const Storage* b, MatrixIndex length)
+{
+    return sqrt(VectorKernels::get<Storage>().sumSquaredDifference(a, b, length));
+}
+
+// to be used for printing page rank vector (debug output only)
 void PageRanker::dumpPageRank(PageRank* array, MatrixIndex size)
 {
+    if(!Logger::isEnabled(Logger::VERBOSITY_DEBUG))
+    {
+	return;
+    }
+
+    std::ostream& out = Logger::getStream();
+
     for(MatrixIndex i = 0 ; i < size ; ++i)
     {
-        std::cout << array[i] << " " ;
+	out << array[i] << " ";
     }
 
-    std::cout << std::endl;
+    out << "\n";
+}
+
+// Returns the count highest ranked nodes from the last ranking, highest
+// first and nodes of equal rank in their original index order.
+std::vector<PageRanker::RankedNode> PageRanker::getTopRankedNodes(const DirectedGraph& graph, MatrixIndex count)
+{
+    if(!m_pageRankVector)
+    {
+	return std::vector<RankedNode>();
+    }
+
+    ThreadPool serialThreadPool(1);
+
+    return selectTopRankedNodes(graph, m_pageRankVector, 1, count, m_threadPool ? *m_threadPool : serialThreadPool);
+}
+
+// Returns the count highest ranked nodes, highest first and nodes of equal
+// rank in the order of their index before any renumbering, given the rank of node i at ranks[i*stride]. Each
+// thread keeps a heap of the best count nodes of its own range of nodes,
+// with the worst of them on top, so finding them costs O(n log count). The
+// heaps are then merged and only the nodes returned have their names looked up.
+template<typename Rank>
+std::vector<PageRanker::RankedNode> PageRanker::selectTopRankedNodes(const DirectedGraph& graph, const Rank* ranks, MatrixIndex stride,
+								      MatrixIndex count, ThreadPool& threadPool)
+{
+    MatrixIndex numberOfNodes = graph.getNodeCount();
+    count = std::min(count, numberOfNodes);
+
+    unsigned threadCount = threadPool.getThreadCount();
+    std::vector<std::vector<MatrixIndex> > heaps(threadCount);
+
+    // true if node a ranks above node b
+    auto ranksAbove = [ranks, stride, &graph](MatrixIndex a, MatrixIndex b)
+    {
+	Rank rankA = ranks[(uint64_t)a*stride];
+	Rank rankB = ranks[(uint64_t)b*stride];
+
+	return rankA > rankB || (rankA == rankB && graph.getOriginalIndex(a) < graph.getOriginalIndex(b));
+    };
+    threadPool.run([&](unsigned threadindex)
+    {
+	MatrixIndex begin = (uint64_t)numberOfNodes * threadindex / threadCount;
+	MatrixIndex end = (uint64_t)numberOfNodes * (threadindex + 1) / threadCount;
+	std::vector<MatrixIndex>& heap = heaps[threadindex];
+
+	heap.reserve(count);
+
+	for(MatrixIndex node = begin ; node < end && count ; ++node)
+	{
+	    if(heap.size() < count)
+	    {
+		heap.push_back(node);
+		std::push_heap(heap.begin(), heap.end(), ranksAbove);
+	    }
+	    else if(ranksAbove(node, heap.front()))
+	    {
+		std::pop_heap(heap.begin(), heap.end(), ranksAbove);
+		heap.back() = node;
+		std::push_heap(heap.begin(), heap.end(), ranksAbove);
+	    }
+	}
+    });
+
+    std::vector<MatrixIndex> candidates;
+
+    for(unsigned thread = 0 ; thread < threadCount ; ++thread)
+    {
+	candidates.insert(candidates.end(), heaps[thread].begin(), heaps[thread].end());
+    }
+
+    std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(), ranksAbove);
+
+    std::vector<RankedNode> top(count);
+
+    for(MatrixIndex k = 0 ; k < count ; ++k)
+    {
+	MatrixIndex node = candidates[k];
+	RankedNode ranked = {node, node < graph.getNamedNodeCount() ? graph.getNodeName(node) : std::string_view(), ranks[(uint64_t)node*stride]};
+	top[k] = ranked;
+    }
+
+    return top;
+}
+
+// ranks are selected from the PageRanker's own vector and PersonalizedRanker's float matrix
+template std::vector<PageRanker::RankedNode> PageRanker::selectTopRankedNodes<PageRanker::PageRank>(const DirectedGraph&, const PageRank*, MatrixIndex,
+														    MatrixIndex, ThreadPool&);
+template std::vector<PageRanker::RankedNode> PageRanker::selectTopRankedNodes<float>(const DirectedGraph&, const float*, MatrixIndex,
+										     MatrixIndex, ThreadPool&);
+
+// show the count highest ranked nodes
+void PageRanker::dumpTopPageRank(const DirectedGraph& graph, MatrixIndex count)
+{
+    if(!m_pageRankVector)
+    {
+	LOG_SUMMARY("Page rank has not yet been calculated\n");
+	return;
+    }
+
+    std::vector<RankedNode> top = getTopRankedNodes(graph, count);
+    std::ostream& out = Logger::getStream();
+
+    // the page ranks are the result so are written at every verbosity
+    out << "Rank | Node | PageRank\n";
+    for(MatrixIndex k = 0 ; k < top.size() ; ++k)
+    {
+	out << k + 1 << " " << top[k].name << " " << top[k].rank << "\n";
+    }
 }
 
 // print page rank vector with node labels provided by the graph object
@@ -405,14 +1076,19 @@ void PageRanker::dumpPageRank(const DirectedGraph& graph)
 {
     if(!m_pageRankVector)
     {
-        std::cout << "Page rank has not yet been calculated" << std::endl;
+	LOG_SUMMARY("Page rank has not yet been calculated\n");
+	return;
     }
 
     MatrixIndex nodeCount = graph.getNodeCount();
+    std::ostream& out = Logger::getStream();
     
-    std::cout << "Node | PageRank" << std::endl;
+    // the page ranks are the result so are written at every verbosity,
+    // in the order the nodes had before any renumbering
+    out << "Node | PageRank\n";
     for(MatrixIndex i = 0 ; i < nodeCount ; ++i)
     {
-	std::cout << graph.getNodeByIndex(i) << " " << m_pageRankVector[i] << std::endl;
+	MatrixIndex node = graph.getCurrentIndex(i);
+	out << graph.getNodeName(node) << " " << m_pageRankVector[node] << "\n";
     }
 }
@@ -3,7 +3,7 @@ This class finds page rank leaks, page rank sinks and calculates
 the page rank of the nodes in a given directed graph. It can remove
 orphan nodes (no inbound links) and nodes pointed to only by orphan
 nodes. It can also remove nodes with no outgoing links (rank leaks)
-although this is not done in a recursive fashion.
+and nodes which only link to rank leaks.
 
 ****************************************************************/
 
@@ -11,20 +11,81 @@ although this is not done in a recursive fashion.
 #define PAGERANKER_H
 
 #include "directedgraph.h"
+#include "threadpool.h"
+#include "rankworkspace.h"
+#include "propagationbins.h"
 
-// The number of iterations to use when looking
-// for rank sinks
-#define SINK_DETECT_ITERATIONS 100
+#include <vector>
+#include <string_view>
 
-// Threshold below which nodes are considered to have
-// zero page rank. Used when detecting rank sinks
-#define ZERO_PR_THRESHOLD 0.01
+// Second differences smaller than this are treated as zero
+// when extrapolating, to avoid dividing by rounding noise
+#define EXTRAPOLATION_MIN_DENOMINATOR 1e-12
+
+// Number of values each thread can contribute to a reduction
+#define PARTIAL_SUM_COUNT 5
+
+// Size of a cache line in bytes. Per-thread values are padded to
+// this size so threads do not write to the same line.
+#define CACHE_LINE_SIZE 64
 
 class PageRanker
 {
     public:
+      // ranks are reported as double whatever they are stored and summed as
+      typedef double PageRank;
+
+      // precisions ranks can be stored and summed in
+      enum RankPrecision
+      {
+	  PRECISION_FLOAT,
+	  PRECISION_DOUBLE
+      };
+
+      // how each iteration passes rank along links
+      enum Propagation
+      {
+	  // blocked once the rank vector is larger than the last level cache
+	  PROPAGATION_AUTOMATIC,
+	  // every node pulls rank along its inbound links
+	  PROPAGATION_PULL,
+	  // rank is scattered into bins by destination, then each bin is added up
+	  PROPAGATION_BLOCKED
+      };
+
+      // a node and its page rank, as returned by getTopRankedNodes()
+      struct RankedNode
+      {
+	  MatrixIndex index;
+	  // points into the graph's name table, valid while the graph is
+	  std::string_view name;
+	  PageRank rank;
+      };
+
+      // which kinds of node peelGraph() removes
+      enum PeelMode
+      {
+	  PEEL_ORPHANS = 1,
+	  PEEL_LEAKS = 2,
+	  PEEL_ORPHANS_AND_LEAKS = PEEL_ORPHANS | PEEL_LEAKS
+      };
+
       PageRanker();
       virtual ~PageRanker();
+      // rank using the threads of the given pool (NULL ranks on the calling thread only)
+      void setThreadPool(ThreadPool* threadpool);
+      // draw vectors from the given workspace (NULL uses the ranker's own)
+      void setWorkspace(RankWorkspace* workspace);
+      // returns the workspace vectors are drawn from
+      RankWorkspace& getWorkspace();
+      // stop ranking once the L1 residual of an iteration is below tolerance (0 runs every iteration)
+      void setTolerance(PageRank tolerance);
+      // quadratically extrapolate the page rank vector every interval iterations (0 disables, otherwise at least 3)
+      void setExtrapolation(uint32_t interval);
+      // store ranks and sum contributions in the given precisions (float for both by default)
+      void setPrecision(RankPrecision storage, RankPrecision accumulator, bool compensated);
+      // choose how rank is passed along links, blocked in bins of 2^binshift nodes (0 sizes bins to L2 cache)
+      void setPropagation(Propagation propagation, unsigned binshift);
       // calculate page rank of nodes in graph
       void rankGraphNodes(const DirectedGraph& graph, float decayfactor, uint32_t iterations);
       // show rank leaks
@@ -33,13 +94,35 @@ class PageRanker
       void dumpRankSinks(const DirectedGraph& graph);
       // show calculated page rank
       void dumpPageRank(const DirectedGraph& graph);
-      // remove orphans from graph
+      // the count highest ranked nodes, highest first, ties in original index order
+      std::vector<RankedNode> getTopRankedNodes(const DirectedGraph& graph, MatrixIndex count);
+      // show the count highest ranked nodes
+      void dumpTopPageRank(const DirectedGraph& graph, MatrixIndex count);
+      // the count highest ranked nodes given the rank of node i at ranks[i*stride]
+      template<typename Rank>
+      static std::vector<RankedNode> selectTopRankedNodes(const DirectedGraph& graph, const Rank* ranks, MatrixIndex stride,
+							  MatrixIndex count, ThreadPool& threadPool);
+      // split nodes into ranges with a similar number of inbound links
+      static void partitionNodesByInboundLinks(const DirectedGraph& graph, unsigned partitionCount, std::vector<MatrixIndex>& boundaries);
+      // split nodes into ranges with a similar number of outbound links
+      static void partitionNodesByOutboundLinks(const DirectedGraph& graph, unsigned partitionCount, std::vector<MatrixIndex>& boundaries);
+      // L1 residual of each iteration of the last ranking
+      const std::vector<PageRank>& getResidualHistory() const;
+      // show L1 residual of each iteration of the last ranking
+      void dumpResidualHistory();
+      // recursively remove orphans, rank leaks or both from graph
+      void peelGraph(DirectedGraph& graph, PeelMode mode);
+      // recursively remove orphans from graph
       void removeOrphanNodes(DirectedGraph& graph);
-      // remove rank leaks from graph
+      // recursively remove rank leaks from graph
       void removeLeakNodes(DirectedGraph& graph);
 
    private:
-      typedef float PageRank;
+      // per-thread partial sums padded to their own cache line
+      struct alignas(CACHE_LINE_SIZE) PartialSums
+      {
+	  double value[PARTIAL_SUM_COUNT];
+      };
       
       // print out pagerank array
       void dumpPageRank(PageRank* array, MatrixIndex size);
@@ -50,30 +133,67 @@ class PageRanker
       // populate array holding count of outbound links for each node in graph
       void getOutBoundLinks(const DirectedGraph& graph);
 
-      // populate bool array indicating if a node has at least one outbound link
-      void getNodesWithAtLeastOneOutBoundLink(const DirectedGraph& graph);
-
       // populate array holding count of inbound links for each node in graph
       void getInBoundLinks(const DirectedGraph& graph);
 
-      // populate bool array indicating if a node has at least one inbound link
-      void getNodesWithAtLeastOneInBoundLink(const DirectedGraph& graph);
+      // true if the page rank vector is extrapolated after the given iteration
+      bool isExtrapolationIteration(uint32_t iteration) const;
+
+      // rank with ranks stored as Storage, choosing the accumulator
+      template<typename Storage>
+      void rankWithStorage(const DirectedGraph& graph, float decayfactor, uint32_t iterations, MatrixIndex isolatedNodeCount);
+
+      // rank with ranks stored as Storage and contributions summed with Sum
+      template<typename Storage, typename Sum>
+      void rankWithPrecision(const DirectedGraph& graph, float decayfactor, uint32_t iterations, MatrixIndex isolatedNodeCount);
+
+      // make the final ranks the ones reported, converting them to PageRank if need be
+      void storeRankResults(PageRank* ranks, MatrixIndex length);
+      template<typename Storage>
+      void storeRankResults(const Storage* ranks, MatrixIndex length);
+
+      // extrapolate the latest ranks of a range of nodes from recent iterates
+      template<typename Storage>
+      void extrapolate(ThreadPool& threadPool, unsigned threadindex, Storage* const* iterates,
+		       MatrixIndex begin, MatrixIndex end, std::vector<PartialSums>& partialSums);
 
       // Returns the magnitude of the difference of two vectors
-      float getDifferenceVectorMagnitude(PageRank* a, PageRank* b, MatrixIndex length);
+      template<typename Storage>
+      double getDifferenceVectorMagnitude(const Storage* a, const Storage* b, MatrixIndex length);
       // stores the last calculated pageranks for the nodes in the graph
       PageRank* m_pageRankVector;      
       // array holding the number of outbound links for given node
       MatrixIndex* m_outboundLinkCount;
       // array holding the number of inbound links for given node
       MatrixIndex* m_inboundLinkCount;
-      
-      // bool array for whether a node has at least one inbound link
-      // (this array is quicker to calculate than the one holding 
-      // the number of inbound links)
-      bool* m_atLeastOneInboundLink;
-      // bool array for whether a node has at least one outbound link
-      bool* m_atLeastOneOutboundLink;
+
+      // the arrays above and every other vector used while ranking are drawn
+      // from this workspace, which is m_ownedWorkspace unless one is set
+      RankWorkspace* m_workspace;
+      RankWorkspace m_ownedWorkspace;
+      // node ranges and per-thread sums of the last ranking, kept to reuse
+      std::vector<MatrixIndex> m_partitions;
+      std::vector<PartialSums> m_partialResiduals;
+      std::vector<PartialSums> m_partialExtrapolationSums;
+
+      // threads used for ranking, not owned by the ranker
+      ThreadPool* m_threadPool;
+      // residual below which ranking stops early, 0 to run all iterations
+      PageRank m_tolerance;
+      // how often to extrapolate, an interval of 0 for never
+      uint32_t m_extrapolationInterval;
+      // what ranks are stored and summed as, and whether sums are compensated
+      RankPrecision m_rankPrecision;
+      RankPrecision m_sumPrecision;
+      bool m_compensatedSum;
+      // how rank is passed along links, and log2 of the nodes per bin when blocked (0 to size them to L2 cache)
+      Propagation m_propagation;
+      unsigned m_binShift;
+      // edges laid out in bins by destination, and the ranges of nodes each thread scatters, when blocked
+      PropagationBins m_propagationBins;
+      std::vector<MatrixIndex> m_sourcePartitions;
+      // L1 residual of each iteration of the last ranking
+      std::vector<PageRank> m_residualHistory;
 };
 
 #endif
@@ -0,0 +1,416 @@
+/****************************************************************
+Calculates a batch of personalized page rank vectors together.
+Each vector has its own teleport vector, the distribution random
+jumps land on, instead of the uniform one used by PageRanker. The
+ranks are held as a matrix with a row per node and a column per
+teleport vector, so one pass over the graph's inbound links
+updates every vector in the batch and the inner loops run over
+contiguous columns, which the compiler vectorizes.
+****************************************************************/
+
+#include "personalizedranker.h"
+#include "logger.h"
+#include "metrics.h"
+
+#include <algorithm>
+#include <type_traits>
+#include <math.h>
+
+// Returns the number of columns each row is processed in, the smallest
+// power of two at least the batch size up to BATCH_LANE_COUNT, so a small
+// batch is padded to a narrower vector rather than a full 16 columns
+static MatrixIndex batchLaneCount(MatrixIndex batchsize)
+{
+    MatrixIndex lanes = 1;
+
+    while(lanes < batchsize && lanes < BATCH_LANE_COUNT)
+    {
+	lanes *= 2;
+    }
+
+    return lanes;
+}
+
+PersonalizedRanker::PersonalizedRanker():m_batchSize(0),m_rowStride(0),m_threadPool(NULL),m_tolerance(0){}
+
+PersonalizedRanker::~PersonalizedRanker(){}
+
+// Set the pool of threads used by rankGraphNodes(). The pool must outlive
+// the ranker. If no pool is set ranking runs on the calling thread.
+void PersonalizedRanker::setThreadPool(ThreadPool* threadpool)
+{
+    m_threadPool = threadpool;
+}
+
+// Stop ranking as soon as the L1 residual of every column is below the tolerance
+void PersonalizedRanker::setTolerance(PageRank tolerance)
+{
+    m_tolerance = tolerance;
+}
+
+// Set column k of the teleport matrix to 1/|S| for each node in seed set k
+// and 0 elsewhere. Seeds repeated within a set count once.
+void PersonalizedRanker::makeSeedTeleports(const DirectedGraph& graph, const std::vector<std::vector<MatrixIndex> >& seedSets,
+					   std::vector<PageRank>& teleports)
+{
+    MatrixIndex batchSize = seedSets.size();
+
+    teleports.assign((uint64_t)graph.getNodeCount() * batchSize, 0);
+
+    for(MatrixIndex column = 0 ; column < batchSize ; ++column)
+    {
+	std::vector<MatrixIndex> seeds(seedSets[column]);
+
+	std::sort(seeds.begin(), seeds.end());
+	seeds.erase(std::unique(seeds.begin(), seeds.end()), seeds.end());
+
+	for(MatrixIndex seed : seeds)
+	{
+	    teleports[(uint64_t)seed*batchSize + column] = (PageRank)1 / seeds.size();
+	}
+    }
+}
+
+// Calculate batchsize personalized page rank vectors of a graph. Column k of
+// the node count by batchsize matrix teleports is the distribution random
+// jumps land on for vector k, and each column is also that vector's starting
+// ranks. Rank reaching nodes with no outbound links jumps back to the
+// column's teleport vector, as random jumps do, so no rank is lost and the
+// graph need not be peeled first.
+//
+// Each thread owns a range of rows with a similar number of inbound links.
+// For every node it walks the inbound links once, adding the contributing
+// node's whole row of contributions into an accumulator row, so the graph is
+// read once per iteration however many vectors are being ranked.
+void PersonalizedRanker::rankGraphNodes(const DirectedGraph& graph, float decayfactor, uint32_t iterations,
+					const PageRank* teleports, MatrixIndex batchsize)
+{
+    METRICS_PHASE("personalized_rank");
+
+    LOG_SUMMARY("#########################################\n");
+    LOG_SUMMARY("Calculating " << batchsize << " personalized page ranks...\n");
+    LOG_SUMMARY("#########################################\n");
+
+    MatrixIndex numberOfNodes = graph.getNodeCount();
+    MatrixIndex laneCount = batchLaneCount(batchsize);
+    MatrixIndex stride = (batchsize + laneCount - 1) / laneCount * laneCount;
+    uint64_t matrixSize = (uint64_t)numberOfNodes * stride;
+
+    ThreadPool serialThreadPool(1);
+    ThreadPool& threadPool = m_threadPool ? *m_threadPool : serialThreadPool;
+    unsigned threadCount = threadPool.getThreadCount();
+
+    m_batchSize = batchsize;
+    m_rowStride = stride;
+
+    // teleport vectors with the padding columns left at zero
+    std::vector<PageRank> paddedTeleports(matrixSize, 0);
+    // 1/(outbound link count) for each node, zero for nodes with no outbound links
+    std::vector<PageRank> inverseOutboundLinkCount(numberOfNodes);
+
+    for(MatrixIndex node = 0 ; node < numberOfNodes ; ++node)
+    {
+	MatrixIndex outDegree = graph.getOutDegree(node);
+
+	inverseOutboundLinkCount[node] = outDegree ? (PageRank)1 / outDegree : 0;
+
+	for(MatrixIndex column = 0 ; column < batchsize ; ++column)
+	{
+	    paddedTeleports[(uint64_t)node*stride + column] = teleports[(uint64_t)node*batchsize + column];
+	}
+    }
+
+    // the teleport vectors are the starting ranks
+    m_rankMatrix = paddedTeleports;
+    std::vector<PageRank> previousRankMatrix(matrixSize);
+
+    // Rank each node passes along every one of its outbound links, in every
+    // column. Double buffered as in PageRanker::rankGraphNodes().
+    std::vector<PageRank> contributionMatrices[2] = {std::vector<PageRank>(matrixSize), std::vector<PageRank>(matrixSize)};
+
+    std::vector<MatrixIndex> partitions;
+    PageRanker::partitionNodesByInboundLinks(graph, threadCount, partitions);
+
+    // each thread's per-column share of the L1 residual, double buffered by iteration
+    std::vector<std::vector<double> > partialResiduals(2*threadCount, std::vector<double>(stride));
+    // each thread's per-column share of the rank held by nodes with no outbound links, double buffered by iteration
+    std::vector<std::vector<double> > partialDanglingRanks(2*threadCount, std::vector<double>(stride));
+    // each thread's row the inbound contributions of one node are summed into
+    std::vector<std::vector<PageRank> > accumulators(threadCount, std::vector<PageRank>(stride));
+    // each thread's copy of how much of each column's teleport vector every node gets,
+    // 1 - decay plus the decayed rank of the nodes with no outbound links
+    std::vector<std::vector<PageRank> > teleportScales(threadCount, std::vector<PageRank>(stride));
+
+    m_residualHistory.clear();
+    uint32_t iterationsRun = iterations;
+    PageRank* finalRankMatrix = NULL;
+
+    // largest column residual of an iteration from every thread's share of it
+    auto sumResidual = [&](uint32_t iteration)
+    {
+	double largest = 0;
+
+	for(MatrixIndex column = 0 ; column < batchsize ; ++column)
+	{
+	    double residual = 0;
+
+	    for(unsigned thread = 0 ; thread < threadCount ; ++thread)
+	    {
+		residual += partialResiduals[(iteration & 1)*threadCount + thread][column];
+	    }
+
+	    largest = std::max(largest, residual);
+	}
+
+	return (PageRank)largest;
+    };
+
+    // The iteration is structured exactly as PageRanker::rankGraphNodes(),
+    // with one barrier per iteration between writing contributions and
+    // reading those of other threads' nodes. The lane count is a template
+    // argument so every lane loop has a fixed trip count.
+    auto runIterations = [&](auto lanes)
+    {
+	constexpr int LANES = decltype(lanes)::value;
+
+	threadPool.run([&](unsigned threadindex)
+	{
+	    MatrixIndex begin = partitions[threadindex];
+	    MatrixIndex end = partitions[threadindex + 1];
+	    PageRank* previous = m_rankMatrix.data();
+	    PageRank* current = previousRankMatrix.data();
+	    PageRank* accumulator = accumulators[threadindex].data();
+	    uint32_t iteration = 0;
+
+	    for( ; iteration < iterations ; ++iteration)
+	    {
+		PageRank* contributions = contributionMatrices[iteration & 1].data();
+		double* danglingRanks = partialDanglingRanks[(iteration & 1)*threadCount + threadindex].data();
+
+		std::fill(danglingRanks, danglingRanks + stride, 0);
+
+		for(MatrixIndex fromnode = begin ; fromnode < end ; ++fromnode)
+		{
+		    const PageRank* rankRow = previous + (uint64_t)fromnode*stride;
+		    PageRank* contributionRow = contributions + (uint64_t)fromnode*stride;
+		    PageRank scale = inverseOutboundLinkCount[fromnode];
+
+		    if(!scale)
+		    {
+			for(MatrixIndex column = 0 ; column < stride ; ++column)
+			{
+			    danglingRanks[column] += rankRow[column];
+			}
+		    }
+
+		    for(MatrixIndex column = 0 ; column < stride ; column += LANES, rankRow += LANES, contributionRow += LANES)
+		    {
+#pragma GCC ivdep
+			for(int lane = 0 ; lane < LANES ; ++lane)
+			{
+			    contributionRow[lane] = rankRow[lane] * scale;
+			}
+		    }
+		}
+
+		threadPool.barrier();
+
+		if(iteration)
+		{
+		    PageRank residual = sumResidual(iteration - 1);
+
+		    if(threadindex == 0)
+		    {
+			m_residualHistory.push_back(residual);
+		    }
+
+		    if(residual < m_tolerance)
+		    {
+			break;
+		    }
+		}
+
+		PageRank* teleportScale = teleportScales[threadindex].data();
+
+		for(MatrixIndex column = 0 ; column < stride ; ++column)
+		{
+		    double danglingRank = 0;
+
+		    for(unsigned thread = 0 ; thread < threadCount ; ++thread)
+		    {
+			danglingRank += partialDanglingRanks[(iteration & 1)*threadCount + thread][column];
+		    }
+
+		    teleportScale[column] = (1 - decayfactor) + decayfactor * (PageRank)danglingRank;
+		}
+
+		double* residuals = partialResiduals[(iteration & 1)*threadCount + threadindex].data();
+
+		std::fill(residuals, residuals + stride, 0);
+
+		for(MatrixIndex tonode = begin ; tonode < end ; ++tonode)
+		{
+		    std::fill(accumulator, accumulator + stride, 0);
+
+		    graph.forEachInNeighbour(tonode, [=](MatrixIndex fromnode)
+		    {
+			const PageRank* contributionRow = contributions + (uint64_t)fromnode*stride;
+			const PageRank* contributionEnd = contributionRow + stride;
+			PageRank* sum = accumulator;
+
+			// the lane loop has a fixed trip count so it is vectorized at -O2
+			for( ; contributionRow != contributionEnd ; contributionRow += LANES, sum += LANES)
+			{
+#pragma GCC ivdep
+			    for(int lane = 0 ; lane < LANES ; ++lane)
+			    {
+				sum[lane] += contributionRow[lane];
+			    }
+			}
+		    });
+
+		    const PageRank* teleportRow = paddedTeleports.data() + (uint64_t)tonode*stride;
+		    const PageRank* previousRow = previous + (uint64_t)tonode*stride;
+		    PageRank* currentRow = current + (uint64_t)tonode*stride;
+
+		    for(MatrixIndex column = 0 ; column < stride ; column += LANES)
+		    {
+			const PageRank* sum = accumulator + column;
+			const PageRank* teleport = teleportRow + column;
+			const PageRank* scale = teleportScale + column;
+			const PageRank* previousRank = previousRow + column;
+			PageRank* rank = currentRow + column;
+			double* residual = residuals + column;
+
+#pragma GCC ivdep
+			for(int lane = 0 ; lane < LANES ; ++lane)
+			{
+			    rank[lane] = (decayfactor * sum[lane]) + scale[lane] * teleport[lane];
+			    residual[lane] += fabs(rank[lane] - previousRank[lane]);
+			}
+		    }
+		}
+
+		PageRank* tmpPrevious = previous;
+		previous = current;
+		current = tmpPrevious;
+	    }
+
+	    if(threadindex == 0)
+	    {
+		iterationsRun = iteration;
+		finalRankMatrix = previous;
+	    }
+	});
+    };
+
+    switch(laneCount)
+    {
+	case 1:
+	    runIterations(std::integral_constant<int, 1>());
+	    break;
+	case 2:
+	    runIterations(std::integral_constant<int, 2>());
+	    break;
+	case 4:
+	    runIterations(std::integral_constant<int, 4>());
+	    break;
+	case 8:
+	    runIterations(std::integral_constant<int, 8>());
+	    break;
+	default:
+	    runIterations(std::integral_constant<int, BATCH_LANE_COUNT>());
+	    break;
+    }
+
+    // the final ranks are in whichever matrix the threads wrote last
+    if(finalRankMatrix != m_rankMatrix.data())
+    {
+	m_rankMatrix.swap(previousRankMatrix);
+    }
+
+    if(iterationsRun == iterations && iterations)
+    {
+	// the residual of the final iteration has not been summed yet
+	m_residualHistory.push_back(sumResidual(iterations - 1));
+    }
+
+    METRICS_COUNT("iterations", iterationsRun);
+    METRICS_COUNT("edges_processed", graph.getEdgeCount() * iterationsRun);
+    METRICS_COUNT("rank_vectors", batchsize);
+    METRICS_RESIDUALS(std::vector<double>(m_residualHistory.begin(), m_residualHistory.end()));
+
+    if(iterationsRun < iterations)
+    {
+	LOG_SUMMARY("Converged after " << iterationsRun << " iterations (L1 residual of every column below " << m_tolerance << ")\n");
+    }
+    else
+    {
+	LOG_SUMMARY("Stopped after " << iterationsRun << " iterations\n");
+    }
+
+    if(!m_residualHistory.empty())
+    {
+	LOG_SUMMARY("Largest L1 norm of difference between page rank vectors in final two iterations: " << m_residualHistory.back() << "\n");
+    }
+
+    LOG_SUMMARY("\n");
+}
+
+// returns number of page rank vectors calculated by the last ranking
+MatrixIndex PersonalizedRanker::getBatchSize() const
+{
+    return m_batchSize;
+}
+
+// returns the rank of a node in one column of the last ranking
+PersonalizedRanker::PageRank PersonalizedRanker::getRank(MatrixIndex node, MatrixIndex column) const
+{
+    return m_rankMatrix[(uint64_t)node*m_rowStride + column];
+}
+
+// Returns the count highest ranked nodes of one column of the last ranking
+std::vector<PersonalizedRanker::RankedNode> PersonalizedRanker::getTopRankedNodes(const DirectedGraph& graph, MatrixIndex column, MatrixIndex count)
+{
+    if(column >= m_batchSize)
+    {
+	return std::vector<RankedNode>();
+    }
+
+    ThreadPool serialThreadPool(1);
+
+    return PageRanker::selectTopRankedNodes(graph, m_rankMatrix.data() + column, m_rowStride, count,
+					    m_threadPool ? *m_threadPool : serialThreadPool);
+}
+
+// show the count highest ranked nodes of every column, or every node in
+// rank order if count is 0
+void PersonalizedRanker::dumpTopPageRank(const DirectedGraph& graph, MatrixIndex count)
+{
+    if(!m_batchSize)
+    {
+	LOG_SUMMARY("Personalized page rank has not yet been calculated\n");
+	return;
+    }
+
+    std::ostream& out = Logger::getStream();
+
+    // the page ranks are the result so are written at every verbosity
+    out << "Seed set | Rank | Node | PageRank\n";
+
+    for(MatrixIndex column = 0 ; column < m_batchSize ; ++column)
+    {
+	std::vector<RankedNode> top = getTopRankedNodes(graph, column, count ? count : graph.getNodeCount());
+
+	for(MatrixIndex k = 0 ; k < top.size() ; ++k)
+	{
+	    out << column + 1 << " " << k + 1 << " " << top[k].name << " " << top[k].rank << "\n";
+	}
+    }
+}
+
+// Returns the largest L1 residual of any column in each iteration of the last ranking
+const std::vector<PersonalizedRanker::PageRank>& PersonalizedRanker::getResidualHistory() const
+{
+    return m_residualHistory;
+}
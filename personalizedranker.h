@@ -0,0 +1,76 @@
+/****************************************************************
+Calculates a batch of personalized page rank vectors together.
+Each vector has its own teleport vector, the distribution random
+jumps land on, instead of the uniform one used by PageRanker. The
+ranks are held as a matrix with a row per node and a column per
+teleport vector, so one pass over the graph's inbound links
+updates every vector in the batch and the inner loops run over
+contiguous columns, which the compiler vectorizes.
+****************************************************************/
+
+#ifndef PERSONALIZEDRANKER_H
+#define PERSONALIZEDRANKER_H
+
+#include "directedgraph.h"
+#include "pageranker.h"
+#include "threadpool.h"
+
+#include <vector>
+
+// Most columns of the rank matrices processed together, a 512-bit vector
+// of floats. Rows are padded to a multiple of the lane count, the smallest
+// power of two at least the batch size up to this, so the loops over a row
+// have no remainder to handle.
+#define BATCH_LANE_COUNT 16
+
+class PersonalizedRanker
+{
+    public:
+      // ranks are kept in float so twice as many lanes fit in a vector register
+      typedef float PageRank;
+      typedef PageRanker::RankedNode RankedNode;
+
+      PersonalizedRanker();
+      virtual ~PersonalizedRanker();
+      // rank using the threads of the given pool (NULL ranks on the calling thread only)
+      void setThreadPool(ThreadPool* threadpool);
+      // stop ranking once every column's L1 residual is below tolerance (0 runs every iteration)
+      void setTolerance(PageRank tolerance);
+      // calculate batchsize personalized page rank vectors, teleports holds the
+      // teleport vectors as a node count by batchsize row-major matrix
+      void rankGraphNodes(const DirectedGraph& graph, float decayfactor, uint32_t iterations,
+			  const PageRank* teleports, MatrixIndex batchsize);
+      // build teleport vectors spreading each column evenly over one set of seed nodes
+      static void makeSeedTeleports(const DirectedGraph& graph, const std::vector<std::vector<MatrixIndex> >& seedSets,
+				    std::vector<PageRank>& teleports);
+
+      // returns number of page rank vectors calculated by the last ranking
+      MatrixIndex getBatchSize() const;
+      // returns the rank of a node in one column of the last ranking
+      PageRank getRank(MatrixIndex node, MatrixIndex column) const;
+      // the count highest ranked nodes of one column, highest first, ties in original index order
+      std::vector<RankedNode> getTopRankedNodes(const DirectedGraph& graph, MatrixIndex column, MatrixIndex count);
+      // show the count highest ranked nodes of every column (every node if count is 0)
+      void dumpTopPageRank(const DirectedGraph& graph, MatrixIndex count);
+      // largest L1 residual of any column in each iteration of the last ranking
+      const std::vector<PageRank>& getResidualHistory() const;
+
+    private:
+      PersonalizedRanker(const PersonalizedRanker&);
+      PersonalizedRanker& operator=(const PersonalizedRanker&);
+
+      // ranks of the last ranking, row i holds node i's rank in every column
+      std::vector<PageRank> m_rankMatrix;
+      // number of columns in use and the padded length of each row
+      MatrixIndex m_batchSize;
+      MatrixIndex m_rowStride;
+
+      // threads used for ranking, not owned by the ranker
+      ThreadPool* m_threadPool;
+      // residual below which ranking stops early, 0 to run all iterations
+      PageRank m_tolerance;
+      // largest L1 residual of any column in each iteration of the last ranking
+      std::vector<PageRank> m_residualHistory;
+};
+
+#endif
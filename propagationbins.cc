@@ -0,0 +1,181 @@
+/****************************************************************
+Edges laid out for propagation blocking. Once the rank vector is
+larger than the last level cache, pulling rank along inbound links
+reads it at random and nearly every read misses. Instead each
+iteration first scatters the rank passed along every edge into bins
+by destination node, reading ranks and edges in order and appending
+to one stream per bin, then adds up the contributions in each bin,
+whose destinations span few enough nodes for their sums to stay in
+L2 cache. The destination of every slot in the bins depends only on
+the graph, so it is worked out once and only the contributions are
+written each iteration.
+****************************************************************/
+
+#include "propagationbins.h"
+
+#include <algorithm>
+#include <unistd.h>
+
+PropagationBins::PropagationBins():m_binShift(0),m_binCount(0),m_nodeCount(0),m_partitionCount(0),m_destinations(NULL){}
+
+// Returns the size in bytes of the L2 cache of the CPU
+size_t PropagationBins::getL2CacheSize()
+{
+    long size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+
+    return size > 0 ? size : PROPAGATION_DEFAULT_L2_CACHE_SIZE;
+}
+
+// Returns the size in bytes of the last level cache, L3 if there is one
+size_t PropagationBins::getLastLevelCacheSize()
+{
+    long size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+
+    if(size > 0)
+    {
+	return size;
+    }
+
+    size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+
+    return size > 0 ? size : PROPAGATION_DEFAULT_LLC_SIZE;
+}
+
+// Returns log2 of the number of destination nodes per bin. Bins are as wide
+// as they can be while the sums of their nodes fit in the share of L2 cache
+// given to them, then narrowed until every thread has several to add up.
+unsigned PropagationBins::chooseBinShift(MatrixIndex nodecount, size_t valuesize, unsigned threadcount)
+{
+    size_t budget = getL2CacheSize() / PROPAGATION_BIN_CACHE_FRACTION;
+    unsigned binshift = PROPAGATION_MIN_BIN_SHIFT;
+
+    while(binshift < 31 && ((size_t)2 << binshift) * valuesize <= budget)
+    {
+	++binshift;
+    }
+
+    while(binshift > PROPAGATION_MIN_BIN_SHIFT && (nodecount >> binshift) < (uint64_t)threadcount * PROPAGATION_MIN_BINS_PER_THREAD)
+    {
+	--binshift;
+    }
+
+    return binshift;
+}
+
+// Lay out the edges of the graph in bins of 2^binshift destination nodes. The
+// slots of each bin hold the edges of source partition 0, then partition 1 and
+// so on, each in order of source node, so a thread can scatter its partition's
+// contributions without synchronising with the others. The pool must have one
+// thread per source partition. Bins are then shared out between the threads for
+// adding up, each getting a run of bins with a similar number of slots and nodes.
+void PropagationBins::build(const DirectedGraph& graph, unsigned binshift, const std::vector<MatrixIndex>& sourcePartitions,
+			    std::vector<MatrixIndex>& destinationPartitions, RankWorkspace& workspace, ThreadPool& threadPool)
+{
+    m_binShift = binshift;
+    m_nodeCount = graph.getNodeCount();
+    m_binCount = m_nodeCount ? ((m_nodeCount - 1) >> binshift) + 1 : 0;
+    m_partitionCount = sourcePartitions.size() - 1;
+    m_sourcePartitions = sourcePartitions;
+
+    // count each partition's edges into each bin, the cursors serving as counters
+    m_cursors.assign((size_t)m_partitionCount * m_binCount, 0);
+
+    threadPool.run([&](unsigned threadindex)
+    {
+	EdgeIndex* counts = &m_cursors[(size_t)threadindex*m_binCount];
+
+	for(MatrixIndex node = m_sourcePartitions[threadindex] ; node < m_sourcePartitions[threadindex + 1] ; ++node)
+	{
+	    graph.forEachOutNeighbour(node, [counts, binshift](MatrixIndex tonode)
+	    {
+		++counts[tonode >> binshift];
+	    });
+	}
+    });
+
+    m_slotOffsets.resize((size_t)m_binCount * m_partitionCount + 1);
+    EdgeIndex slot = 0;
+
+    for(MatrixIndex bin = 0 ; bin < m_binCount ; ++bin)
+    {
+	for(unsigned partition = 0 ; partition < m_partitionCount ; ++partition)
+	{
+	    m_slotOffsets[(size_t)bin*m_partitionCount + partition] = slot;
+	    slot += m_cursors[(size_t)partition*m_binCount + bin];
+	}
+    }
+
+    m_slotOffsets.back() = slot;
+    m_destinations = workspace.get<MatrixIndex>(RankWorkspace::BIN_DESTINATIONS, slot);
+
+    threadPool.run([&](unsigned threadindex)
+    {
+	resetCursors(threadindex);
+
+	EdgeIndex* cursors = &m_cursors[(size_t)threadindex*m_binCount];
+	MatrixIndex* destinations = m_destinations;
+
+	for(MatrixIndex node = m_sourcePartitions[threadindex] ; node < m_sourcePartitions[threadindex + 1] ; ++node)
+	{
+	    graph.forEachOutNeighbour(node, [destinations, cursors, binshift](MatrixIndex tonode)
+	    {
+		destinations[cursors[tonode >> binshift]++] = tonode;
+	    });
+	}
+    });
+
+    // share out the bins as partitionNodesByInboundLinks() shares out nodes
+    uint64_t totalWork = slot + m_nodeCount;
+    uint64_t work = 0;
+    unsigned partition = 1;
+
+    m_partitionBins.assign(m_partitionCount + 1, m_binCount);
+    m_partitionBins[0] = 0;
+
+    for(MatrixIndex bin = 0 ; bin < m_binCount && partition < m_partitionCount ; ++bin)
+    {
+	while(partition < m_partitionCount && work >= totalWork * partition / m_partitionCount)
+	{
+	    m_partitionBins[partition++] = bin;
+	}
+
+	uint64_t binNodes = std::min<uint64_t>((uint64_t)(bin + 1) << binshift, m_nodeCount) - ((uint64_t)bin << binshift);
+	work += m_slotOffsets[(size_t)(bin + 1)*m_partitionCount] - m_slotOffsets[(size_t)bin*m_partitionCount] + binNodes;
+    }
+
+    destinationPartitions.resize(m_partitionCount + 1);
+
+    for(unsigned partition = 0 ; partition <= m_partitionCount ; ++partition)
+    {
+	destinationPartitions[partition] = std::min<uint64_t>((uint64_t)m_partitionBins[partition] << binshift, m_nodeCount);
+    }
+}
+
+// move a source partition's cursors to the start of its slots in every bin
+void PropagationBins::resetCursors(unsigned partition)
+{
+    EdgeIndex* cursors = &m_cursors[(size_t)partition*m_binCount];
+
+    for(MatrixIndex bin = 0 ; bin < m_binCount ; ++bin)
+    {
+	cursors[bin] = m_slotOffsets[(size_t)bin*m_partitionCount + partition];
+    }
+}
+
+// returns the number of slots, one per edge
+EdgeIndex PropagationBins::getSlotCount() const
+{
+    return m_slotOffsets.empty() ? 0 : m_slotOffsets.back();
+}
+
+// returns log2 of the nodes per bin
+unsigned PropagationBins::getBinShift() const
+{
+    return m_binShift;
+}
+
+// returns the number of bins
+MatrixIndex PropagationBins::getBinCount() const
+{
+    return m_binCount;
+}
@@ -0,0 +1,148 @@
+/****************************************************************
+Edges laid out for propagation blocking. Once the rank vector is
+larger than the last level cache, pulling rank along inbound links
+reads it at random and nearly every read misses. Instead each
+iteration first scatters the rank passed along every edge into bins
+by destination node, reading ranks and edges in order and appending
+to one stream per bin, then adds up the contributions in each bin,
+whose destinations span few enough nodes for their sums to stay in
+L2 cache. The destination of every slot in the bins depends only on
+the graph, so it is worked out once and only the contributions are
+written each iteration.
+****************************************************************/
+
+#ifndef PROPAGATIONBINS_H
+#define PROPAGATIONBINS_H
+
+#include "directedgraph.h"
+#include "rankworkspace.h"
+#include "threadpool.h"
+
+#include <stdint.h>
+#include <cstddef>
+#include <vector>
+
+// The sums of one bin's destinations take up at most this fraction
+// of L2 cache, leaving the rest for the streams read and written
+#define PROPAGATION_BIN_CACHE_FRACTION 2
+
+// L2 and last level cache sizes assumed when the system does not report them
+#define PROPAGATION_DEFAULT_L2_CACHE_SIZE (1 << 20)
+#define PROPAGATION_DEFAULT_LLC_SIZE (8 << 20)
+
+// Bins are narrowed until each thread has at least this many to add
+// up, so the threads can be given similar amounts of work
+#define PROPAGATION_MIN_BINS_PER_THREAD 4
+
+// log2 of the fewest destination nodes a bin covers
+#define PROPAGATION_MIN_BIN_SHIFT 10
+
+class PropagationBins
+{
+    public:
+	PropagationBins();
+	virtual ~PropagationBins(){};
+
+	// size in bytes of the L2 cache and of the last level cache
+	static size_t getL2CacheSize();
+	static size_t getLastLevelCacheSize();
+	// log2 of the nodes per bin whose sums of the given size fit in L2 cache
+	static unsigned chooseBinShift(MatrixIndex nodecount, size_t valuesize, unsigned threadcount);
+
+	// Lay out the edges of graph in bins of 2^binshift destination nodes.
+	// Thread i of the pool scatters the edges of source nodes
+	// sourcePartitions[i] .. sourcePartitions[i + 1] and adds up a run of
+	// bins, whose nodes are returned in the same form in destinationPartitions.
+	void build(const DirectedGraph& graph, unsigned binshift, const std::vector<MatrixIndex>& sourcePartitions,
+		   std::vector<MatrixIndex>& destinationPartitions, RankWorkspace& workspace, ThreadPool& threadPool);
+
+	// write the rank passed along each outbound link of the nodes of a source partition into its slot
+	template<typename Value>
+	void scatter(const DirectedGraph& graph, const Value* ranks, const Value* inverseOutboundLinkCount,
+		     unsigned partition, Value* contributions);
+	// set sums[node] to the sum of the contributions to node, for the nodes of a destination partition
+	template<typename Value>
+	void accumulate(const Value* contributions, unsigned partition, Value* sums) const;
+
+	// returns the number of slots, one per edge
+	EdgeIndex getSlotCount() const;
+	// returns log2 of the nodes per bin
+	unsigned getBinShift() const;
+	// returns the number of bins
+	MatrixIndex getBinCount() const;
+
+    private:
+	PropagationBins(const PropagationBins&);
+	PropagationBins& operator=(const PropagationBins&);
+
+	// move each source partition's cursors to the start of its slots in every bin
+	void resetCursors(unsigned partition);
+
+	unsigned m_binShift;
+	MatrixIndex m_binCount;
+	MatrixIndex m_nodeCount;
+	// The slots of the edges from source partition p into bin b start at
+	// m_slotOffsets[b*m_partitionCount + p]. The last entry is the slot count.
+	unsigned m_partitionCount;
+	std::vector<EdgeIndex> m_slotOffsets;
+	// next slot each source partition writes in each bin, partition by partition
+	std::vector<EdgeIndex> m_cursors;
+	// source nodes and first bin of each partition
+	std::vector<MatrixIndex> m_sourcePartitions;
+	std::vector<MatrixIndex> m_partitionBins;
+	// destination node of each slot, drawn from the workspace
+	MatrixIndex* m_destinations;
+};
+
+template<typename Value>
+inline void PropagationBins::scatter(const DirectedGraph& graph, const Value* ranks, const Value* inverseOutboundLinkCount,
+				     unsigned partition, Value* contributions)
+{
+    resetCursors(partition);
+
+    EdgeIndex* cursors = &m_cursors[(size_t)partition*m_binCount];
+    unsigned binshift = m_binShift;
+
+    for(MatrixIndex node = m_sourcePartitions[partition] ; node < m_sourcePartitions[partition + 1] ; ++node)
+    {
+	Value contribution = ranks[node] * inverseOutboundLinkCount[node];
+
+	graph.forEachOutNeighbour(node, [contributions, cursors, binshift, contribution](MatrixIndex tonode)
+	{
+	    contributions[cursors[tonode >> binshift]++] = contribution;
+	});
+    }
+}
+
+// Contributions to a node are added in the order of the nodes they come
+// from, exactly as when they are pulled along the node's inbound links
+template<typename Value>
+inline void PropagationBins::accumulate(const Value* contributions, unsigned partition, Value* sums) const
+{
+    MatrixIndex firstBin = m_partitionBins[partition];
+    MatrixIndex lastBin = m_partitionBins[partition + 1];
+
+    if(firstBin == lastBin)
+    {
+	return;
+    }
+
+    MatrixIndex begin = firstBin << m_binShift;
+    MatrixIndex end = lastBin == m_binCount ? m_nodeCount : lastBin << m_binShift;
+
+    for(MatrixIndex node = begin ; node < end ; ++node)
+    {
+	sums[node] = 0;
+    }
+
+    const MatrixIndex* destination = m_destinations + m_slotOffsets[(size_t)firstBin*m_partitionCount];
+    const MatrixIndex* lastDestination = m_destinations + m_slotOffsets[(size_t)lastBin*m_partitionCount];
+    const Value* contribution = contributions + m_slotOffsets[(size_t)firstBin*m_partitionCount];
+
+    for( ; destination != lastDestination ; ++destination, ++contribution)
+    {
+	sums[*destination] += *contribution;
+    }
+}
+
+#endif
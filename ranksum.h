@@ -0,0 +1,73 @@
+/****************************************************************
+Running sums used to accumulate page rank. PlainSum adds values
+in the accumulator type it is given. CompensatedSum also carries
+the rounding error of every addition (Neumaier's variant of Kahan
+summation), so a long sum of small values loses almost no accuracy
+even in float. Both are templates so the ranking kernel can be
+instantiated once for every pairing of storage and accumulator.
+****************************************************************/
+
+#ifndef RANKSUM_H
+#define RANKSUM_H
+
+#include <math.h>
+
+template<typename Value>
+class PlainSum
+{
+    public:
+	typedef Value ValueType;
+
+	PlainSum():m_sum(0){}
+
+	void add(Value value)
+	{
+	    m_sum += value;
+	}
+
+	Value get() const
+	{
+	    return m_sum;
+	}
+
+    private:
+	Value m_sum;
+};
+
+template<typename Value>
+class CompensatedSum
+{
+    public:
+	typedef Value ValueType;
+
+	CompensatedSum():m_sum(0),m_compensation(0){}
+
+	// add a value, keeping the low order bits lost from whichever of the
+	// sum and the value is smaller
+	void add(Value value)
+	{
+	    Value total = m_sum + value;
+
+	    if(fabs(m_sum) >= fabs(value))
+	    {
+		m_compensation += (m_sum - total) + value;
+	    }
+	    else
+	    {
+		m_compensation += (value - total) + m_sum;
+	    }
+
+	    m_sum = total;
+	}
+
+	Value get() const
+	{
+	    return m_sum + m_compensation;
+	}
+
+    private:
+	Value m_sum;
+	Value m_compensation;
+};
+
+#endif
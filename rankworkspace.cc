@@ -0,0 +1,127 @@
+/****************************************************************
+Buffers used while ranking a graph, kept from one call to the next
+so ranking graphs of the same size over and over allocates nothing
+once the buffers have grown to fit. Every buffer starts on a cache
+line and can optionally be backed by transparent huge pages to cut
+TLB misses on large graphs. Buffer contents are not kept when a
+buffer has to grow.
+****************************************************************/
+
+#include "rankworkspace.h"
+
+#include <cstdlib>
+#include <new>
+#include <sys/mman.h>
+
+RankWorkspace::RankWorkspace():m_hugePages(false)
+{
+    for(int buffer = 0 ; buffer < BUFFER_COUNT ; ++buffer)
+    {
+	Allocation empty = {NULL, 0, NULL, 0};
+	m_buffers[buffer] = empty;
+    }
+}
+
+RankWorkspace::~RankWorkspace()
+{
+    release();
+}
+
+// Back buffers allocated from now on with transparent huge pages. Buffers
+// already held keep their pages until they next grow.
+void RankWorkspace::setHugePages(bool hugepages)
+{
+    m_hugePages = hugepages;
+}
+
+// Returns a buffer of at least size bytes. The buffer is only reallocated
+// when it is too small, so its size only ever grows.
+void* RankWorkspace::reserve(Buffer buffer, size_t size)
+{
+    Allocation& allocation = m_buffers[buffer];
+
+    if(allocation.data && size <= allocation.capacity)
+    {
+	return allocation.data;
+    }
+
+    freeAllocation(allocation);
+
+    if(!size)
+    {
+	return NULL;
+    }
+
+    if(m_hugePages)
+    {
+	// map an extra huge page so the buffer can start on a huge page boundary
+	size_t capacity = (size + WORKSPACE_HUGE_PAGE_SIZE - 1) / WORKSPACE_HUGE_PAGE_SIZE * WORKSPACE_HUGE_PAGE_SIZE;
+	size_t mappingSize = capacity + WORKSPACE_HUGE_PAGE_SIZE;
+	void* mapping = mmap(NULL, mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if(mapping != MAP_FAILED)
+	{
+	    uintptr_t start = ((uintptr_t)mapping + WORKSPACE_HUGE_PAGE_SIZE - 1) / WORKSPACE_HUGE_PAGE_SIZE * WORKSPACE_HUGE_PAGE_SIZE;
+
+	    // only a hint, the kernel falls back to normal pages without it
+	    madvise((void*)start, capacity, MADV_HUGEPAGE);
+
+	    Allocation mapped = {(void*)start, capacity, mapping, mappingSize};
+	    allocation = mapped;
+	    return allocation.data;
+	}
+
+	// fall back to an ordinary allocation if the mapping failed
+    }
+
+    size_t capacity = (size + WORKSPACE_ALIGNMENT - 1) / WORKSPACE_ALIGNMENT * WORKSPACE_ALIGNMENT;
+    void* data = aligned_alloc(WORKSPACE_ALIGNMENT, capacity);
+
+    if(!data)
+    {
+	throw std::bad_alloc();
+    }
+
+    Allocation allocated = {data, capacity, NULL, 0};
+    allocation = allocated;
+
+    return allocation.data;
+}
+
+// free one buffer
+void RankWorkspace::freeAllocation(Allocation& allocation)
+{
+    if(allocation.mapping)
+    {
+	munmap(allocation.mapping, allocation.mappingSize);
+    }
+    else
+    {
+	free(allocation.data);
+    }
+
+    Allocation empty = {NULL, 0, NULL, 0};
+    allocation = empty;
+}
+
+// free every buffer, any pointers returned by get() are no longer valid
+void RankWorkspace::release()
+{
+    for(int buffer = 0 ; buffer < BUFFER_COUNT ; ++buffer)
+    {
+	freeAllocation(m_buffers[buffer]);
+    }
+}
+
+// returns the total size in bytes of the buffers held
+uint64_t RankWorkspace::getReservedBytes() const
+{
+    uint64_t bytes = 0;
+
+    for(int buffer = 0 ; buffer < BUFFER_COUNT ; ++buffer)
+    {
+	bytes += m_buffers[buffer].capacity;
+    }
+
+    return bytes;
+}
@@ -0,0 +1,88 @@
+/****************************************************************
+Buffers used while ranking a graph, kept from one call to the next
+so ranking graphs of the same size over and over allocates nothing
+once the buffers have grown to fit. Every buffer starts on a cache
+line and can optionally be backed by transparent huge pages to cut
+TLB misses on large graphs. Buffer contents are not kept when a
+buffer has to grow.
+****************************************************************/
+
+#ifndef RANKWORKSPACE_H
+#define RANKWORKSPACE_H
+
+#include <stdint.h>
+#include <cstddef>
+
+// Alignment in bytes of every buffer (one cache line)
+#define WORKSPACE_ALIGNMENT 64
+
+// Size in bytes of a huge page, buffers backed by huge pages
+// are rounded up to and aligned on a multiple of this
+#define WORKSPACE_HUGE_PAGE_SIZE (2 << 20)
+
+class RankWorkspace
+{
+    public:
+	// the buffers held by a workspace
+	enum Buffer
+	{
+	    OUTBOUND_LINK_COUNTS,
+	    INBOUND_LINK_COUNTS,
+	    PAGE_RANKS,
+	    PREVIOUS_PAGE_RANKS,
+	    INVERSE_OUTBOUND_LINK_COUNTS,
+	    CONTRIBUTIONS,
+	    NEXT_CONTRIBUTIONS,
+	    OLDER_PAGE_RANKS,
+	    OLDEST_PAGE_RANKS,
+	    RANK_RESULTS,
+	    TELEPORTS,
+	    BIN_DESTINATIONS,
+	    BIN_CONTRIBUTIONS,
+	    NODE_FLAGS,
+	    NODE_WORKLIST,
+	    BUFFER_COUNT
+	};
+
+	RankWorkspace();
+	virtual ~RankWorkspace();
+
+	// back buffers allocated from now on with huge pages
+	void setHugePages(bool hugepages);
+	// returns a buffer with room for at least count values of type T
+	template<typename T>
+	T* get(Buffer buffer, uint64_t count)
+	{
+	    return static_cast<T*>(reserve(buffer, count * sizeof(T)));
+	}
+	// free every buffer
+	void release();
+	// returns the total size in bytes of the buffers held
+	uint64_t getReservedBytes() const;
+
+    private:
+	RankWorkspace(const RankWorkspace&);
+	RankWorkspace& operator=(const RankWorkspace&);
+
+	// a block of memory and how it was allocated
+	struct Allocation
+	{
+	    // start of the usable, aligned memory
+	    void* data;
+	    // usable size in bytes
+	    size_t capacity;
+	    // start and size of the mapping when backed by huge pages, NULL otherwise
+	    void* mapping;
+	    size_t mappingSize;
+	};
+
+	// returns a buffer of at least size bytes, growing it if needed
+	void* reserve(Buffer buffer, size_t size);
+	// free one buffer
+	void freeAllocation(Allocation& allocation);
+
+	Allocation m_buffers[BUFFER_COUNT];
+	bool m_hugePages;
+};
+
+#endif
@@ -0,0 +1,679 @@
+/****************************************************************
+A directed graph kept on disk for ranking graphs whose edges do
+not fit in memory, in the style of GraphChi's shards. The nodes
+are split into intervals and every edge is stored in the shard of
+its destination's interval, as compressed sparse columns of that
+interval. A ranker then holds only per-node vectors in memory and
+streams the shards from disk in turn every iteration. The shards
+are built from a links file in a few sequential passes, with
+memory bounded by the node count plus one shard. The directory
+holds an index file, with the intervals, each node's degrees and
+the node names, and one file per shard.
+****************************************************************/
+
+#include "shardedgraph.h"
+#include "linksfileparser.h"
+#include "nodeinterner.h"
+#include "logger.h"
+#include "metrics.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <sys/stat.h>
+
+ShardedGraph::ShardedGraph():m_nodeCount(0),m_edgeCount(0),m_shardCount(0),m_shardBoundaries(NULL),
+			     m_outDegree(NULL),m_inDegree(NULL),m_nameOffsets(NULL),m_names(NULL){}
+
+// returns the path of the index in a shard directory
+std::string ShardedGraph::getIndexPath(const std::string& directory)
+{
+    return directory + "/index";
+}
+
+// returns the path of a shard in a shard directory
+std::string ShardedGraph::getShardPath(const std::string& directory, unsigned shard)
+{
+    return directory + "/shard." + std::to_string(shard);
+}
+
+// returns the path of the links of a shard before they are sorted
+std::string ShardedGraph::getLinksPath(const std::string& directory, unsigned shard)
+{
+    return directory + "/shard." + std::to_string(shard) + ".links";
+}
+
+// returns true if the directory holds the index of a sharded graph
+bool ShardedGraph::isShardedGraph(const char* directory)
+{
+    std::ifstream file(getIndexPath(directory).c_str(), std::ios::binary);
+    char magic[sizeof(SHARDS_MAGIC)];
+
+    return file.read(magic, sizeof(magic)) && !memcmp(magic, SHARDS_MAGIC, sizeof(magic));
+}
+
+// Split a links file into shards. The file is read three times: once to
+// number the nodes, as LinksFileParser numbers them, and to count the links
+// into each node so the nodes can be split into intervals with about
+// shardBytes of links each; once to append every link to the links file of
+// its destination's shard; and once shard by shard, sorting each shard's
+// links and dropping duplicates before writing it out. Only the node names,
+// per-node counts and one shard's links are ever held in memory. Returns
+// the number of shards.
+unsigned ShardedGraph::create(const char* linksFilepath, const char* directory, uint64_t shardBytes, bool sortNodesByName)
+{
+    METRICS_PHASE("shard");
+
+    std::string directoryPath(directory);
+
+    if(mkdir(directory, 0777) != 0 && errno != EEXIST)
+    {
+	throw ShardedGraphException("Failed to create shard directory");
+    }
+
+    LOG_SUMMARY("####################\n");
+    LOG_SUMMARY("Sharding file " << linksFilepath << "\n");
+    LOG_SUMMARY("####################\n\n");
+
+    MappedFile file;
+
+    if(!file.open(linksFilepath))
+    {
+	throw ShardedGraphException("Failed to open links file");
+    }
+
+    METRICS_COUNT("bytes_read", 2*(uint64_t)file.getSize());
+
+    // number the nodes and count the links into each of them
+    NodeInterner nodes;
+    std::vector<EdgeIndex> linkCounts;
+    uint64_t linkCount = 0;
+
+    uint64_t ignoredLines = forEachLink(file, [&](std::string_view fromnode, std::string_view tonode)
+    {
+	nodes.intern(fromnode);
+	NodeInterner::NodeIndex to = nodes.intern(tonode);
+
+	linkCounts.resize(nodes.getNodeCount(), 0);
+	++linkCounts[to];
+	++linkCount;
+    });
+
+    if(ignoredLines)
+    {
+	LOG_SUMMARY("WARNING: Ignored " << ignoredLines << " lines without a link between two nodes\n");
+    }
+
+    if(!linkCount)
+    {
+	throw ShardedGraphException("No valid nodes read from file");
+    }
+
+    MatrixIndex nodeCount = nodes.getNodeCount();
+    std::vector<NodeInterner::NodeIndex> oldToNew;
+
+    if(sortNodesByName)
+    {
+	nodes.renumberLexicographically(oldToNew);
+
+	std::vector<EdgeIndex> sortedCounts(nodeCount);
+
+	for(MatrixIndex node = 0 ; node < nodeCount ; ++node)
+	{
+	    sortedCounts[oldToNew[node]] = linkCounts[node];
+	}
+
+	linkCounts.swap(sortedCounts);
+	std::vector<NodeInterner::NodeIndex>().swap(oldToNew);
+    }
+
+    // close an interval once adding the next node would overfill its shard,
+    // a node with more inbound links than fit in a shard gets one of its own
+    uint64_t shardCapacity = std::max<uint64_t>(shardBytes / sizeof(Link), 1);
+    std::vector<MatrixIndex> boundaries(1, 0);
+    uint64_t shardLinks = 0;
+
+    for(MatrixIndex node = 0 ; node < nodeCount ; ++node)
+    {
+	if(shardLinks && shardLinks + linkCounts[node] > shardCapacity)
+	{
+	    boundaries.push_back(node);
+	    shardLinks = 0;
+	}
+
+	shardLinks += linkCounts[node];
+    }
+
+    boundaries.push_back(nodeCount);
+    std::vector<EdgeIndex>().swap(linkCounts);
+
+    unsigned shardCount = boundaries.size() - 1;
+
+    LOG_SUMMARY("Splitting " << linkCount << " links between " << nodeCount << " nodes into " << shardCount << " shards\n");
+
+    // append each link to its shard's links file, a buffer at a time
+    std::vector<Links> buffers(shardCount);
+
+    auto flushBuffer = [&](unsigned shard)
+    {
+	std::ofstream out(getLinksPath(directoryPath, shard).c_str(), std::ios::binary | std::ios::app);
+
+	if(!out.write(reinterpret_cast<const char*>(buffers[shard].data()), buffers[shard].size() * sizeof(Link)))
+	{
+	    throw ShardedGraphException("Failed to write shard links file");
+	}
+
+	buffers[shard].clear();
+    };
+
+    for(unsigned shard = 0 ; shard < shardCount ; ++shard)
+    {
+	std::ofstream out(getLinksPath(directoryPath, shard).c_str(), std::ios::binary | std::ios::trunc);
+
+	if(!out)
+	{
+	    throw ShardedGraphException("Failed to create shard links file");
+	}
+    }
+
+    forEachLink(file, [&](std::string_view fromnode, std::string_view tonode)
+    {
+	// the interner already gives the nodes their indices in name order
+	Link link = {nodes.intern(fromnode), nodes.intern(tonode)};
+	unsigned shard = std::upper_bound(boundaries.begin(), boundaries.end(), link.to) - boundaries.begin() - 1;
+	Links& buffer = buffers[shard];
+
+	buffer.push_back(link);
+
+	if(buffer.size() == SHARDS_LINK_BUFFER_SIZE)
+	{
+	    flushBuffer(shard);
+	}
+    });
+
+    file.close();
+
+    for(unsigned shard = 0 ; shard < shardCount ; ++shard)
+    {
+	flushBuffer(shard);
+	Links().swap(buffers[shard]);
+    }
+
+    // sort each shard's links into columns and count every node's links
+    std::vector<MatrixIndex> outDegree(nodeCount, 0);
+    std::vector<MatrixIndex> inDegree(nodeCount, 0);
+    EdgeIndex edgeCount = 0;
+    Links links;
+
+    for(unsigned shard = 0 ; shard < shardCount ; ++shard)
+    {
+	std::string linksPath = getLinksPath(directoryPath, shard);
+	std::ifstream in(linksPath.c_str(), std::ios::binary | std::ios::ate);
+
+	if(!in)
+	{
+	    throw ShardedGraphException("Failed to open shard links file");
+	}
+
+	links.resize(in.tellg() / sizeof(Link));
+	in.seekg(0);
+
+	if(!in.read(reinterpret_cast<char*>(links.data()), links.size() * sizeof(Link)))
+	{
+	    throw ShardedGraphException("Failed to read shard links file");
+	}
+
+	in.close();
+
+	std::sort(links.begin(), links.end(), [](const Link& a, const Link& b)
+	{
+	    return a.to < b.to || (a.to == b.to && a.from < b.from);
+	});
+
+	links.erase(std::unique(links.begin(), links.end(), [](const Link& a, const Link& b)
+	{
+	    return a.to == b.to && a.from == b.from;
+	}), links.end());
+
+	for(Links::const_iterator iter = links.begin() ; iter != links.end() ; ++iter)
+	{
+	    ++outDegree[iter->from];
+	    ++inDegree[iter->to];
+	}
+
+	writeShard(getShardPath(directoryPath, shard), boundaries[shard], boundaries[shard + 1] - boundaries[shard], links);
+	std::remove(linksPath.c_str());
+
+	LOG_DEBUG("Shard " << shard << " holds nodes " << boundaries[shard] << " to " << boundaries[shard + 1] - 1
+		  << " and " << links.size() << " edges\n");
+
+	edgeCount += links.size();
+    }
+
+    Links().swap(links);
+
+    if(edgeCount < linkCount)
+    {
+	LOG_SUMMARY("WARNING: Ignored " << linkCount - edgeCount << " duplicate edges\n");
+    }
+
+    METRICS_COUNT("links_parsed", linkCount);
+    METRICS_COUNT("edges", edgeCount);
+
+    // write the index
+    IndexHeader header;
+    startHeader(header);
+    header.nodeCount = nodeCount;
+    header.edgeCount = edgeCount;
+    header.shardCount = shardCount;
+    header.nameBytes = 0;
+
+    for(MatrixIndex node = 0 ; node < nodeCount ; ++node)
+    {
+	header.nameBytes += nodes.getName(node).size();
+    }
+
+    uint64_t sizes[INDEX_SECTION_COUNT];
+    sizes[SHARD_BOUNDARIES] = (shardCount + 1) * sizeof(MatrixIndex);
+    sizes[OUT_DEGREES] = nodeCount * sizeof(MatrixIndex);
+    sizes[IN_DEGREES] = sizes[OUT_DEGREES];
+    sizes[NAME_OFFSETS] = (nodeCount + 1) * sizeof(uint64_t);
+    sizes[NAMES] = header.nameBytes;
+    layoutSections(header, sizes, INDEX_SECTION_COUNT);
+
+    std::ofstream index(getIndexPath(directoryPath).c_str(), std::ios::binary | std::ios::trunc);
+
+    if(!index)
+    {
+	throw ShardedGraphException("Failed to create shard index file");
+    }
+
+    index.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    uint64_t position = sizeof(header);
+
+    startSection(index, position, header.sectionOffsets[SHARD_BOUNDARIES], sizes[SHARD_BOUNDARIES]);
+    index.write(reinterpret_cast<const char*>(boundaries.data()), sizes[SHARD_BOUNDARIES]);
+    startSection(index, position, header.sectionOffsets[OUT_DEGREES], sizes[OUT_DEGREES]);
+    index.write(reinterpret_cast<const char*>(outDegree.data()), sizes[OUT_DEGREES]);
+    startSection(index, position, header.sectionOffsets[IN_DEGREES], sizes[IN_DEGREES]);
+    index.write(reinterpret_cast<const char*>(inDegree.data()), sizes[IN_DEGREES]);
+
+    startSection(index, position, header.sectionOffsets[NAME_OFFSETS], sizes[NAME_OFFSETS]);
+    uint64_t nameOffset = 0;
+
+    for(MatrixIndex node = 0 ; node <= nodeCount ; ++node)
+    {
+	index.write(reinterpret_cast<const char*>(&nameOffset), sizeof(nameOffset));
+	nameOffset += node < nodeCount ? nodes.getName(node).size() : 0;
+    }
+
+    startSection(index, position, header.sectionOffsets[NAMES], sizes[NAMES]);
+
+    for(MatrixIndex node = 0 ; node < nodeCount ; ++node)
+    {
+	std::string_view name = nodes.getName(node);
+	index.write(name.data(), name.size());
+    }
+
+    if(!index.flush())
+    {
+	throw ShardedGraphException("Failed to write shard index file");
+    }
+
+    LOG_SUMMARY("Wrote " << shardCount << " shards with " << nodeCount << " nodes and " << edgeCount << " edges to " << directory << "\n");
+
+    return shardCount;
+}
+
+// Write one shard, the column offsets of its interval then the source of
+// every link, with the links sorted by destination and then by source
+void ShardedGraph::writeShard(const std::string& path, MatrixIndex firstNode, MatrixIndex nodeCount, const Links& links)
+{
+    ShardHeader header;
+    startHeader(header);
+    header.firstNode = firstNode;
+    header.nodeCount = nodeCount;
+    header.edgeCount = links.size();
+
+    uint64_t sizes[SHARD_SECTION_COUNT];
+    sizes[SHARD_OFFSETS] = (header.nodeCount + 1) * sizeof(EdgeIndex);
+    sizes[SHARD_SOURCES] = header.edgeCount * sizeof(MatrixIndex);
+    layoutSections(header, sizes, SHARD_SECTION_COUNT);
+
+    std::vector<EdgeIndex> offsets(nodeCount + 1, 0);
+    std::vector<MatrixIndex> sources(links.size());
+
+    for(size_t k = 0 ; k < links.size() ; ++k)
+    {
+	++offsets[links[k].to - firstNode + 1];
+	sources[k] = links[k].from;
+    }
+
+    for(MatrixIndex i = 0 ; i < nodeCount ; ++i)
+    {
+	offsets[i + 1] += offsets[i];
+    }
+
+    std::ofstream file(path.c_str(), std::ios::binary | std::ios::trunc);
+
+    if(!file)
+    {
+	throw ShardedGraphException("Failed to create shard file");
+    }
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    uint64_t position = sizeof(header);
+
+    startSection(file, position, header.sectionOffsets[SHARD_OFFSETS], sizes[SHARD_OFFSETS]);
+    file.write(reinterpret_cast<const char*>(offsets.data()), sizes[SHARD_OFFSETS]);
+    startSection(file, position, header.sectionOffsets[SHARD_SOURCES], sizes[SHARD_SOURCES]);
+    file.write(reinterpret_cast<const char*>(sources.data()), sizes[SHARD_SOURCES]);
+
+    if(!file.flush())
+    {
+	throw ShardedGraphException("Failed to write shard file");
+    }
+}
+
+// Map the index of the sharded graph in a directory. Only the index is
+// mapped, the shards are mapped one at a time by mapShard().
+void ShardedGraph::open(const char* directory)
+{
+    m_directory = directory;
+
+    if(!m_index.open(getIndexPath(m_directory).c_str()))
+    {
+	throw ShardedGraphException("Failed to open shard index file");
+    }
+
+    IndexHeader header;
+
+    if(m_index.getSize() < sizeof(header))
+    {
+	throw ShardedGraphException("Shard index file is truncated");
+    }
+
+    memcpy(&header, m_index.getData(), sizeof(header));
+
+    if(!isValidHeader(header))
+    {
+	throw ShardedGraphException("Not a shard index file, or written by another version or machine");
+    }
+
+    // every count is at most the file size, so the section sizes cannot overflow
+    if(header.nodeCount > 0xFFFFFFFFULL || header.nodeCount > m_index.getSize() ||
+       header.shardCount > m_index.getSize() || header.nameBytes > m_index.getSize())
+    {
+	throw ShardedGraphException("Shard index file has invalid counts");
+    }
+
+    uint64_t sizes[INDEX_SECTION_COUNT];
+    sizes[SHARD_BOUNDARIES] = (header.shardCount + 1) * sizeof(MatrixIndex);
+    sizes[OUT_DEGREES] = header.nodeCount * sizeof(MatrixIndex);
+    sizes[IN_DEGREES] = sizes[OUT_DEGREES];
+    sizes[NAME_OFFSETS] = (header.nodeCount + 1) * sizeof(uint64_t);
+    sizes[NAMES] = header.nameBytes;
+
+    if(!sectionsFitFile(header, sizes, INDEX_SECTION_COUNT, m_index.getSize()))
+    {
+	throw ShardedGraphException("Shard index file is truncated");
+    }
+
+    const char* data = m_index.getData();
+    m_nodeCount = header.nodeCount;
+    m_edgeCount = header.edgeCount;
+    m_shardCount = header.shardCount;
+    m_shardBoundaries = reinterpret_cast<const MatrixIndex*>(data + header.sectionOffsets[SHARD_BOUNDARIES]);
+    m_outDegree = reinterpret_cast<const MatrixIndex*>(data + header.sectionOffsets[OUT_DEGREES]);
+    m_inDegree = reinterpret_cast<const MatrixIndex*>(data + header.sectionOffsets[IN_DEGREES]);
+    m_nameOffsets = reinterpret_cast<const uint64_t*>(data + header.sectionOffsets[NAME_OFFSETS]);
+    m_names = data + header.sectionOffsets[NAMES];
+
+    if(!isValidBoundaries(m_nodeCount, m_shardCount, m_shardBoundaries))
+    {
+	throw ShardedGraphException("Shard index file has invalid shard boundaries");
+    }
+
+    LOG_SUMMARY("Mapped " << m_shardCount << " shards from " << directory << " with " << m_nodeCount << " nodes and "
+		<< m_edgeCount << " edges\n\n");
+}
+
+// Map a shard and check it covers the interval the index says it does and
+// only links to nodes of the graph. The mapping is read sequentially, and the
+// kernel starts reading it straight away.
+void ShardedGraph::mapShard(unsigned shard, MappedFile& file, Shard& view) const
+{
+    if(!file.open(getShardPath(m_directory, shard).c_str()))
+    {
+	throw ShardedGraphException("Failed to open shard file");
+    }
+
+    ShardHeader header;
+
+    if(file.getSize() < sizeof(header))
+    {
+	throw ShardedGraphException("Shard file is truncated");
+    }
+
+    memcpy(&header, file.getData(), sizeof(header));
+
+    if(!isValidHeader(header) || header.firstNode != m_shardBoundaries[shard] || header.nodeCount > m_nodeCount ||
+       header.firstNode + header.nodeCount != m_shardBoundaries[shard + 1])
+    {
+	throw ShardedGraphException("Shard file does not match the shard index");
+    }
+
+    if(header.edgeCount > file.getSize())
+    {
+	throw ShardedGraphException("Shard file has an invalid edge count");
+    }
+
+    uint64_t sizes[SHARD_SECTION_COUNT];
+    sizes[SHARD_OFFSETS] = (header.nodeCount + 1) * sizeof(EdgeIndex);
+    sizes[SHARD_SOURCES] = header.edgeCount * sizeof(MatrixIndex);
+
+    if(!sectionsFitFile(header, sizes, SHARD_SECTION_COUNT, file.getSize()))
+    {
+	throw ShardedGraphException("Shard file is truncated");
+    }
+
+    file.prefetch();
+
+    const EdgeIndex* offsets = reinterpret_cast<const EdgeIndex*>(file.getData() + header.sectionOffsets[SHARD_OFFSETS]);
+    const MatrixIndex* sources = reinterpret_cast<const MatrixIndex*>(file.getData() + header.sectionOffsets[SHARD_SOURCES]);
+
+    if(!isValidShard(m_nodeCount, header.nodeCount, header.edgeCount, offsets, sources))
+    {
+	throw ShardedGraphException("Shard file is corrupt");
+    }
+
+    view.firstNode = header.firstNode;
+    view.nodeCount = header.nodeCount;
+    view.edgeCount = header.edgeCount;
+    view.offsets = offsets;
+    view.sources = sources;
+}
+
+// Call visitor(from, to) with the names at each end of every link in a links
+// file, skipping the lines LinksFileParser ignores. Returns how many lines
+// were ignored, not counting blank lines.
+template<typename Visitor>
+uint64_t ShardedGraph::forEachLink(const MappedFile& file, Visitor visitor)
+{
+    const char* position = file.getData();
+    const char* end = position + file.getSize();
+    uint64_t ignoredLines = 0;
+
+    while(position < end)
+    {
+	const char* lineEnd = static_cast<const char*>(memchr(position, '\n', end - position));
+
+	if(!lineEnd)
+	{
+	    lineEnd = end;
+	}
+
+	std::string_view fromnode = LinksFileParser::nextToken(position, lineEnd);
+	std::string_view tonode = LinksFileParser::nextToken(position, lineEnd);
+
+	if(!fromnode.empty())
+	{
+	    if(fromnode == tonode || tonode.empty())
+	    {
+		++ignoredLines;
+	    }
+	    else
+	    {
+		visitor(fromnode, tonode);
+	    }
+	}
+
+	position = lineEnd + 1;
+    }
+
+    return ignoredLines;
+}
+
+// fill in the magic, version and byte order a header starts with
+template<typename Header>
+void ShardedGraph::startHeader(Header& header)
+{
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SHARDS_MAGIC, sizeof(header.magic));
+    header.version = SHARDS_VERSION;
+    header.byteOrder = SHARDS_BYTE_ORDER;
+}
+
+// returns true if a header read from a file starts as startHeader() fills it in
+template<typename Header>
+bool ShardedGraph::isValidHeader(const Header& header)
+{
+    return !memcmp(header.magic, SHARDS_MAGIC, sizeof(header.magic)) && header.version == SHARDS_VERSION &&
+	   header.byteOrder == SHARDS_BYTE_ORDER;
+}
+
+// returns true if the shard boundaries start at 0, end at nodecount and never decrease
+bool ShardedGraph::isValidBoundaries(MatrixIndex nodecount, unsigned shardcount, const MatrixIndex* boundaries)
+{
+    if(boundaries[0] != 0 || boundaries[shardcount] != nodecount)
+    {
+	return false;
+    }
+
+    for(unsigned shard = 0 ; shard < shardcount ; ++shard)
+    {
+	if(boundaries[shard + 1] < boundaries[shard])
+	{
+	    return false;
+	}
+    }
+
+    return true;
+}
+
+// returns true if the offsets of a shard start at 0, end at edgecount and never
+// decrease, and the sources of each node are increasing and below graphNodeCount
+bool ShardedGraph::isValidShard(MatrixIndex graphNodeCount, MatrixIndex nodecount, EdgeIndex edgecount,
+				const EdgeIndex* offsets, const MatrixIndex* sources)
+{
+    if(offsets[0] != 0 || offsets[nodecount] != edgecount)
+    {
+	return false;
+    }
+
+    for(MatrixIndex node = 0 ; node < nodecount ; ++node)
+    {
+	if(offsets[node + 1] < offsets[node] || offsets[node + 1] > edgecount)
+	{
+	    return false;
+	}
+
+	for(EdgeIndex k = offsets[node] ; k < offsets[node + 1] ; ++k)
+	{
+	    if(sources[k] >= graphNodeCount || (k > offsets[node] && sources[k] <= sources[k - 1]))
+	    {
+		return false;
+	    }
+	}
+    }
+
+    return true;
+}
+
+// place sections of the given sizes one after another following the header,
+// each starting on a multiple of SHARDS_SECTION_ALIGNMENT bytes
+template<typename Header>
+void ShardedGraph::layoutSections(Header& header, const uint64_t* sizes, int sectionCount)
+{
+    uint64_t position = sizeof(header);
+
+    for(int section = 0 ; section < sectionCount ; ++section)
+    {
+	position = (position + SHARDS_SECTION_ALIGNMENT - 1) / SHARDS_SECTION_ALIGNMENT * SHARDS_SECTION_ALIGNMENT;
+	header.sectionOffsets[section] = position;
+	position += sizes[section];
+    }
+}
+
+// returns true if every section lies within a file of the given size
+template<typename Header>
+bool ShardedGraph::sectionsFitFile(const Header& header, const uint64_t* sizes, int sectionCount, size_t filesize)
+{
+    for(int section = 0 ; section < sectionCount ; ++section)
+    {
+	if(header.sectionOffsets[section] > filesize || sizes[section] > filesize - header.sectionOffsets[section] ||
+	   header.sectionOffsets[section] % SHARDS_SECTION_ALIGNMENT)
+	{
+	    return false;
+	}
+    }
+
+    return true;
+}
+
+// pad the file with zeros from position up to the start of a section,
+// leaving position at the end of the section
+void ShardedGraph::startSection(std::ofstream& file, uint64_t& position, uint64_t sectionOffset, uint64_t sectionSize)
+{
+    static const char zeros[SHARDS_SECTION_ALIGNMENT] = {0};
+
+    file.write(zeros, sectionOffset - position);
+    position = sectionOffset + sectionSize;
+}
+
+// returns count of how many nodes in the graph
+MatrixIndex ShardedGraph::getNodeCount() const
+{
+    return m_nodeCount;
+}
+
+// returns count of how many edges in the graph
+EdgeIndex ShardedGraph::getEdgeCount() const
+{
+    return m_edgeCount;
+}
+
+// returns the number of shards
+unsigned ShardedGraph::getShardCount() const
+{
+    return m_shardCount;
+}
+
+// returns number of outbound links of a node
+MatrixIndex ShardedGraph::getOutDegree(MatrixIndex node) const
+{
+    return m_outDegree[node];
+}
+
+// returns number of inbound links of a node
+MatrixIndex ShardedGraph::getInDegree(MatrixIndex node) const
+{
+    return m_inDegree[node];
+}
+
+// returns the name of the node with the given index
+std::string_view ShardedGraph::getNodeName(MatrixIndex index) const
+{
+    return std::string_view(m_names + m_nameOffsets[index], m_nameOffsets[index + 1] - m_nameOffsets[index]);
+}
@@ -0,0 +1,202 @@
+/****************************************************************
+A directed graph kept on disk for ranking graphs whose edges do
+not fit in memory, in the style of GraphChi's shards. The nodes
+are split into intervals and every edge is stored in the shard of
+its destination's interval, as compressed sparse columns of that
+interval. A ranker then holds only per-node vectors in memory and
+streams the shards from disk in turn every iteration. The shards
+are built from a links file in a few sequential passes, with
+memory bounded by the node count plus one shard. The directory
+holds an index file, with the intervals, each node's degrees and
+the node names, and one file per shard.
+****************************************************************/
+
+#ifndef SHARDEDGRAPH_H
+#define SHARDEDGRAPH_H
+
+#include "graphtypes.h"
+#include "mappedfile.h"
+
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <exception>
+#include <fstream>
+#include <vector>
+
+// the first 8 bytes of the index and of every shard
+#define SHARDS_MAGIC "PRSHARD"
+// bumped whenever the layout of the index or of a shard changes
+#define SHARDS_VERSION 1
+// written in native byte order to detect shards from other machines
+#define SHARDS_BYTE_ORDER 0x01020304
+// every section starts on a multiple of this many bytes
+#define SHARDS_SECTION_ALIGNMENT 64
+// shard size in bytes used when none is given, about 8 million edges
+#define SHARDS_DEFAULT_SHARD_BYTES (64 << 20)
+// links buffered per shard before they are appended to its links file
+#define SHARDS_LINK_BUFFER_SIZE 8192
+
+// Exception class for unreadable or invalid shards
+class ShardedGraphException : public std::exception
+{
+    public:
+	ShardedGraphException():std::exception(){}
+	ShardedGraphException(const char* message):std::exception(),m_message(message){}
+	virtual ~ShardedGraphException() throw(){}
+	virtual const char* what() const throw()
+	{
+	    return m_message.c_str();
+	}
+
+    private:
+	std::string m_message;
+};
+
+class ShardedGraph
+{
+    public:
+	// One shard mapped into memory. The in-neighbours of node firstNode + i
+	// are sources[offsets[i]] .. sources[offsets[i + 1]], in increasing order.
+	struct Shard
+	{
+	    MatrixIndex firstNode;
+	    MatrixIndex nodeCount;
+	    EdgeIndex edgeCount;
+	    const EdgeIndex* offsets;
+	    const MatrixIndex* sources;
+	};
+
+	ShardedGraph();
+	virtual ~ShardedGraph(){};
+
+	// returns true if the directory holds a sharded graph
+	static bool isShardedGraph(const char* directory);
+	// Split the links file into shards of about shardBytes of edges each,
+	// written to directory, which is created if need be. Nodes are numbered
+	// as LinksFileParser numbers them. Returns the number of shards.
+	static unsigned create(const char* linksFilepath, const char* directory, uint64_t shardBytes, bool sortNodesByName);
+
+	// map the index of the sharded graph in the directory
+	void open(const char* directory);
+	// Map a shard, which stays mapped until file is closed or reused.
+	// The kernel is asked to start reading it in straight away, and the
+	// shard is then read through once to check its offsets and sources.
+	void mapShard(unsigned shard, MappedFile& file, Shard& view) const;
+
+	// returns count of how many nodes in the graph
+	MatrixIndex getNodeCount() const;
+	// returns count of how many edges in the graph
+	EdgeIndex getEdgeCount() const;
+	// returns the number of shards
+	unsigned getShardCount() const;
+	// returns number of outbound links of a node
+	MatrixIndex getOutDegree(MatrixIndex node) const;
+	// returns number of inbound links of a node
+	MatrixIndex getInDegree(MatrixIndex node) const;
+	// returns the name of the node with the given index
+	std::string_view getNodeName(MatrixIndex index) const;
+
+    private:
+	ShardedGraph(const ShardedGraph&);
+	ShardedGraph& operator=(const ShardedGraph&);
+
+	// the sections of the index, in the order they appear in the file
+	enum IndexSection
+	{
+	    SHARD_BOUNDARIES,
+	    OUT_DEGREES,
+	    IN_DEGREES,
+	    NAME_OFFSETS,
+	    NAMES,
+	    INDEX_SECTION_COUNT
+	};
+
+	// the sections of a shard, in the order they appear in the file
+	enum ShardSection
+	{
+	    SHARD_OFFSETS,
+	    SHARD_SOURCES,
+	    SHARD_SECTION_COUNT
+	};
+
+	// start of the index, followed by its sections
+	struct IndexHeader
+	{
+	    char magic[8];
+	    uint32_t version;
+	    uint32_t byteOrder;
+	    uint64_t nodeCount;
+	    uint64_t edgeCount;
+	    uint64_t shardCount;
+	    uint64_t nameBytes;
+	    // byte offset of each section from the start of the file
+	    uint64_t sectionOffsets[INDEX_SECTION_COUNT];
+	};
+
+	// start of every shard, followed by its sections
+	struct ShardHeader
+	{
+	    char magic[8];
+	    uint32_t version;
+	    uint32_t byteOrder;
+	    uint64_t firstNode;
+	    uint64_t nodeCount;
+	    uint64_t edgeCount;
+	    // byte offset of each section from the start of the file
+	    uint64_t sectionOffsets[SHARD_SECTION_COUNT];
+	};
+
+	// a link as the indices of the nodes at each end
+	struct Link
+	{
+	    MatrixIndex from;
+	    MatrixIndex to;
+	};
+
+	typedef std::vector<Link> Links;
+
+	// returns the paths of the index, of a shard and of a shard's unsorted links
+	static std::string getIndexPath(const std::string& directory);
+	static std::string getShardPath(const std::string& directory, unsigned shard);
+	static std::string getLinksPath(const std::string& directory, unsigned shard);
+	// call visitor(from, to) for each link of a links file, returns how many lines were ignored
+	template<typename Visitor>
+	static uint64_t forEachLink(const MappedFile& file, Visitor visitor);
+	// fill in the magic, version and byte order a header starts with
+	template<typename Header>
+	static void startHeader(Header& header);
+	// returns true if a header read from a file starts as startHeader() fills it in
+	template<typename Header>
+	static bool isValidHeader(const Header& header);
+	// returns true if the boundaries run from 0 to nodecount without decreasing
+	static bool isValidBoundaries(MatrixIndex nodecount, unsigned shardcount, const MatrixIndex* boundaries);
+	// returns true if a shard's offsets run from 0 to edgecount without decreasing
+	// and each node's sources are in increasing order and below graphNodeCount
+	static bool isValidShard(MatrixIndex graphNodeCount, MatrixIndex nodecount, EdgeIndex edgecount,
+				 const EdgeIndex* offsets, const MatrixIndex* sources);
+	// place sections of the given sizes one after another following the header
+	template<typename Header>
+	static void layoutSections(Header& header, const uint64_t* sizes, int sectionCount);
+	// returns true if every section lies within a file of the given size
+	template<typename Header>
+	static bool sectionsFitFile(const Header& header, const uint64_t* sizes, int sectionCount, size_t filesize);
+	// pad the file with zeros from position up to the start of a section
+	static void startSection(std::ofstream& file, uint64_t& position, uint64_t sectionOffset, uint64_t sectionSize);
+	// write the links of a shard sorted by destination, which must have no duplicates
+	static void writeShard(const std::string& path, MatrixIndex firstNode, MatrixIndex nodeCount, const Links& links);
+
+	std::string m_directory;
+	MappedFile m_index;
+	MatrixIndex m_nodeCount;
+	EdgeIndex m_edgeCount;
+	unsigned m_shardCount;
+	// the arrays point into the mapped index
+	const MatrixIndex* m_shardBoundaries;
+	const MatrixIndex* m_outDegree;
+	const MatrixIndex* m_inDegree;
+	const uint64_t* m_nameOffsets;
+	const char* m_names;
+};
+
+#endif
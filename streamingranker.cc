@@ -0,0 +1,309 @@
+/****************************************************************
+Calculates page rank over a sharded graph on disk, for graphs too
+large to hold in memory. Only the rank of every node, the rank it
+passes along each outbound link and the inverse of its outbound
+link count are held in memory, so memory grows with the number of
+nodes rather than the number of edges. Every iteration streams the
+shards in turn, mapping the next one so the kernel reads it ahead
+while the nodes of the current one pull rank along their inbound
+links. Ranks are the same as PageRanker's with no nodes peeled:
+the shards hold only inbound links, so orphans and rank leaks are
+not removed and the rank reaching nodes with no outbound links is
+lost, leaving ranks that sum to less than 1.
+****************************************************************/
+
+#include "streamingranker.h"
+#include "logger.h"
+#include "metrics.h"
+
+#include <algorithm>
+#include <cmath>
+
+StreamingRanker::StreamingRanker():m_tolerance(0),m_threadPool(NULL){}
+
+// Set the pool of threads used by rankGraphNodes(). The pool must outlive
+// the ranker. If no pool is set ranking runs on the calling thread.
+void StreamingRanker::setThreadPool(ThreadPool* threadPool)
+{
+    m_threadPool = threadPool;
+}
+
+// stop ranking once the L1 residual of an iteration is below tolerance
+void StreamingRanker::setTolerance(float tolerance)
+{
+    m_tolerance = tolerance;
+}
+
+// Calculate the page rank of every node of a sharded graph, as PageRanker
+// does: nodes with no links at all are ignored and the rank of nodes with
+// no outbound links is lost. Each iteration first works out the rank every
+// node passes along each of its outbound links, then streams the shards,
+// mapping shard k + 1 before ranking the nodes of shard k.
+void StreamingRanker::rankGraphNodes(const ShardedGraph& graph, float decayfactor, uint32_t iterations)
+{
+    METRICS_PHASE("stream_rank");
+
+    LOG_SUMMARY("########################\n");
+    LOG_SUMMARY("Calculating page rank...\n");
+    LOG_SUMMARY("########################\n");
+
+    MatrixIndex numberOfNodes = graph.getNodeCount();
+    unsigned shardCount = graph.getShardCount();
+    ThreadPool serialThreadPool(1);
+    ThreadPool& threadPool = m_threadPool ? *m_threadPool : serialThreadPool;
+    unsigned threadCount = threadPool.getThreadCount();
+
+    m_pageRanks.resize(numberOfNodes);
+    m_contributions.resize(numberOfNodes);
+    m_inverseOutboundLinkCount.resize(numberOfNodes);
+    m_partialResiduals.resize(threadCount);
+    m_residualHistory.clear();
+
+    MatrixIndex isolatedNodeCount = 0;
+
+    for(MatrixIndex node = 0 ; node < numberOfNodes ; ++node)
+    {
+	MatrixIndex outDegree = graph.getOutDegree(node);
+
+	if(!outDegree && !graph.getInDegree(node))
+	{
+	    ++isolatedNodeCount;
+	}
+
+	m_inverseOutboundLinkCount[node] = outDegree ? (PageRank)1 / outDegree : 0;
+    }
+
+    LOG_SUMMARY(isolatedNodeCount << " isolated nodes will be ignored\n");
+    LOG_SUMMARY("Streaming " << shardCount << " shards every iteration\n\n");
+
+    // a graph of isolated nodes has no ranked nodes, and every rank stays zero
+    MatrixIndex rankedNodeCount = numberOfNodes - isolatedNodeCount;
+    PageRank initialrank = rankedNodeCount ? (PageRank)1 / rankedNodeCount : 0;
+    PageRank teleport = rankedNodeCount ? (PageRank)((1 - (PageRank)decayfactor) / rankedNodeCount) : 0;
+
+    for(MatrixIndex node = 0 ; node < numberOfNodes ; ++node)
+    {
+	bool isolated = !graph.getOutDegree(node) && !graph.getInDegree(node);
+	m_pageRanks[node] = isolated ? 0 : initialrank;
+    }
+
+    // the shard being ranked and the one being read ahead
+    MappedFile shardFiles[2];
+    ShardedGraph::Shard shards[2];
+    uint64_t bytesStreamed = 0;
+    uint32_t iteration = 0;
+
+    while(iteration < iterations)
+    {
+	++iteration;
+
+	threadPool.run([&](unsigned threadindex)
+	{
+	    MatrixIndex begin = (uint64_t)numberOfNodes * threadindex / threadCount;
+	    MatrixIndex end = (uint64_t)numberOfNodes * (threadindex + 1) / threadCount;
+
+	    for(MatrixIndex node = begin ; node < end ; ++node)
+	    {
+		m_contributions[node] = m_pageRanks[node] * m_inverseOutboundLinkCount[node];
+	    }
+	});
+
+	double residual = 0;
+
+	if(shardCount)
+	{
+	    graph.mapShard(0, shardFiles[0], shards[0]);
+	}
+
+	for(unsigned shard = 0 ; shard < shardCount ; ++shard)
+	{
+	    if(shard + 1 < shardCount)
+	    {
+		graph.mapShard(shard + 1, shardFiles[(shard + 1) & 1], shards[(shard + 1) & 1]);
+	    }
+
+	    residual += rankShard(shards[shard & 1], decayfactor, teleport, threadPool);
+	    bytesStreamed += shardFiles[shard & 1].getSize();
+	    shardFiles[shard & 1].close();
+	}
+
+	m_residualHistory.push_back(residual);
+
+	if(m_tolerance > 0 && residual < m_tolerance)
+	{
+	    break;
+	}
+    }
+
+    METRICS_COUNT("iterations", iteration);
+    METRICS_COUNT("edges_processed", graph.getEdgeCount() * iteration);
+    METRICS_COUNT("bytes_streamed", bytesStreamed);
+    METRICS_RESIDUALS(m_residualHistory);
+
+    if(iteration < iterations)
+    {
+	LOG_SUMMARY("Converged after " << iteration << " iterations (L1 residual below " << m_tolerance << ")\n");
+    }
+    else
+    {
+	LOG_SUMMARY("Stopped after " << iteration << " iterations\n");
+    }
+
+    if(!m_residualHistory.empty())
+    {
+	LOG_SUMMARY("L1 norm of difference between page rank vectors in final two iterations: " << m_residualHistory.back() << "\n");
+    }
+
+    LOG_SUMMARY("\n");
+}
+
+// Update the ranks of the nodes of one shard from the contributions, each
+// thread taking a run of nodes with about the same number of inbound links.
+// Contributions are summed in order of source node, as PageRanker sums them.
+// Returns the L1 residual of the shard's nodes.
+double StreamingRanker::rankShard(const ShardedGraph::Shard& shard, PageRank decayfactor, PageRank teleport, ThreadPool& threadPool)
+{
+    unsigned threadCount = threadPool.getThreadCount();
+
+    threadPool.run([&](unsigned threadindex)
+    {
+	const EdgeIndex* offsets = shard.offsets;
+	MatrixIndex begin = std::lower_bound(offsets, offsets + shard.nodeCount, shard.edgeCount * threadindex / threadCount) - offsets;
+	MatrixIndex end = threadindex + 1 == threadCount ? shard.nodeCount :
+			  std::lower_bound(offsets, offsets + shard.nodeCount, shard.edgeCount * (threadindex + 1) / threadCount) - offsets;
+	double residual = 0;
+
+	for(MatrixIndex i = begin ; i < end ; ++i)
+	{
+	    MatrixIndex node = shard.firstNode + i;
+	    PageRank rank = 0;
+
+	    if(m_inverseOutboundLinkCount[node] != 0 || offsets[i + 1] != offsets[i])
+	    {
+		PageRank sum = 0;
+
+		for(EdgeIndex k = offsets[i] ; k < offsets[i + 1] ; ++k)
+		{
+		    sum += m_contributions[shard.sources[k]];
+		}
+
+		rank = decayfactor * sum + teleport;
+	    }
+
+	    residual += fabs(rank - m_pageRanks[node]);
+	    m_pageRanks[node] = rank;
+	}
+
+	m_partialResiduals[threadindex] = residual;
+    });
+
+    double residual = 0;
+
+    for(unsigned threadindex = 0 ; threadindex < threadCount ; ++threadindex)
+    {
+	residual += m_partialResiduals[threadindex];
+    }
+
+    return residual;
+}
+
+// returns the rank of a node in the last ranking
+StreamingRanker::PageRank StreamingRanker::getRank(MatrixIndex node) const
+{
+    return m_pageRanks[node];
+}
+
+// returns the L1 residual of each iteration of the last ranking
+const std::vector<double>& StreamingRanker::getResidualHistory() const
+{
+    return m_residualHistory;
+}
+
+// show the L1 residual of each iteration (debug output only)
+void StreamingRanker::dumpResidualHistory()
+{
+    if(!Logger::isEnabled(Logger::VERBOSITY_DEBUG))
+    {
+	return;
+    }
+
+    std::ostream& out = Logger::getStream();
+
+    out << "Iteration | L1 residual\n";
+
+    for(size_t iteration = 0 ; iteration < m_residualHistory.size() ; ++iteration)
+    {
+	out << iteration + 1 << " " << m_residualHistory[iteration] << "\n";
+    }
+
+    out << "\n";
+}
+
+// print the page rank of every node with its name
+void StreamingRanker::dumpPageRank(const ShardedGraph& graph)
+{
+    if(m_pageRanks.empty())
+    {
+	LOG_SUMMARY("Page rank has not yet been calculated\n");
+	return;
+    }
+
+    std::ostream& out = Logger::getStream();
+
+    // the page ranks are the result so are written at every verbosity
+    out << "Node | PageRank\n";
+    for(MatrixIndex node = 0 ; node < graph.getNodeCount() ; ++node)
+    {
+	out << graph.getNodeName(node) << " " << m_pageRanks[node] << "\n";
+    }
+}
+
+// Show the count highest ranked nodes, highest first and nodes of equal
+// rank in index order. A heap of the best count nodes, with the worst of
+// them on top, finds them in O(n log count).
+void StreamingRanker::dumpTopPageRank(const ShardedGraph& graph, MatrixIndex count)
+{
+    if(m_pageRanks.empty())
+    {
+	LOG_SUMMARY("Page rank has not yet been calculated\n");
+	return;
+    }
+
+    MatrixIndex numberOfNodes = graph.getNodeCount();
+    count = std::min(count, numberOfNodes);
+
+    // true if node a ranks above node b
+    auto ranksAbove = [this](MatrixIndex a, MatrixIndex b)
+    {
+	return m_pageRanks[a] > m_pageRanks[b] || (m_pageRanks[a] == m_pageRanks[b] && a < b);
+    };
+
+    std::vector<MatrixIndex> heap;
+    heap.reserve(count);
+
+    for(MatrixIndex node = 0 ; node < numberOfNodes && count ; ++node)
+    {
+	if(heap.size() < count)
+	{
+	    heap.push_back(node);
+	    std::push_heap(heap.begin(), heap.end(), ranksAbove);
+	}
+	else if(ranksAbove(node, heap.front()))
+	{
+	    std::pop_heap(heap.begin(), heap.end(), ranksAbove);
+	    heap.back() = node;
+	    std::push_heap(heap.begin(), heap.end(), ranksAbove);
+	}
+    }
+
+    std::sort_heap(heap.begin(), heap.end(), ranksAbove);
+
+    std::ostream& out = Logger::getStream();
+
+    // the page ranks are the result so are written at every verbosity
+    out << "Rank | Node | PageRank\n";
+    for(MatrixIndex k = 0 ; k < heap.size() ; ++k)
+    {
+	out << k + 1 << " " << graph.getNodeName(heap[k]) << " " << m_pageRanks[heap[k]] << "\n";
+    }
+}
@@ -0,0 +1,71 @@
+/****************************************************************
+Calculates page rank over a sharded graph on disk, for graphs too
+large to hold in memory. Only the rank of every node, the rank it
+passes along each outbound link and the inverse of its outbound
+link count are held in memory, so memory grows with the number of
+nodes rather than the number of edges. Every iteration streams the
+shards in turn, mapping the next one so the kernel reads it ahead
+while the nodes of the current one pull rank along their inbound
+links. Ranks are the same as PageRanker's with no nodes peeled:
+the shards hold only inbound links, so orphans and rank leaks are
+not removed and the rank reaching nodes with no outbound links is
+lost, leaving ranks that sum to less than 1.
+****************************************************************/
+
+#ifndef STREAMINGRANKER_H
+#define STREAMINGRANKER_H
+
+#include "shardedgraph.h"
+#include "threadpool.h"
+
+#include <stdint.h>
+#include <vector>
+
+class StreamingRanker
+{
+    public:
+	typedef float PageRank;
+
+	StreamingRanker();
+	virtual ~StreamingRanker(){};
+
+	// rank using the threads of the given pool (NULL ranks on the calling thread only)
+	void setThreadPool(ThreadPool* threadPool);
+	// stop ranking once the L1 residual is below tolerance (0 runs every iteration)
+	void setTolerance(float tolerance);
+	// calculate the page rank of every node of the graph
+	void rankGraphNodes(const ShardedGraph& graph, float decayfactor, uint32_t iterations);
+
+	// returns the rank of a node in the last ranking
+	PageRank getRank(MatrixIndex node) const;
+	// L1 residual of each iteration of the last ranking
+	const std::vector<double>& getResidualHistory() const;
+	// show the L1 residual of each iteration (debug output only)
+	void dumpResidualHistory();
+	// print the page rank of every node with its name
+	void dumpPageRank(const ShardedGraph& graph);
+	// show the count highest ranked nodes, ties in index order
+	void dumpTopPageRank(const ShardedGraph& graph, MatrixIndex count);
+
+    private:
+	StreamingRanker(const StreamingRanker&);
+	StreamingRanker& operator=(const StreamingRanker&);
+
+	// update the ranks of the nodes of one shard, returns their L1 residual
+	double rankShard(const ShardedGraph::Shard& shard, PageRank decayfactor, PageRank teleport, ThreadPool& threadPool);
+
+	// rank of each node
+	std::vector<PageRank> m_pageRanks;
+	// rank each node passes along every outbound link this iteration
+	std::vector<PageRank> m_contributions;
+	// 1/(outbound link count) for each node, zero for nodes with no outbound links
+	std::vector<PageRank> m_inverseOutboundLinkCount;
+	// each thread's share of a shard's residual
+	std::vector<double> m_partialResiduals;
+	std::vector<double> m_residualHistory;
+	float m_tolerance;
+	// threads used for ranking, not owned by the ranker
+	ThreadPool* m_threadPool;
+};
+
+#endif
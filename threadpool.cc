@@ -0,0 +1,136 @@
+/****************************************************************
+A fixed size pool of worker threads which persist for the life
+of the pool. run() executes a task on every thread in the pool,
+with the calling thread taking part as thread 0, and returns once
+all of them have finished. Threads running a task can wait for
+each other with barrier(). Tasks must not throw.
+****************************************************************/
+
+#include "threadpool.h"
+
+// start the worker threads, the calling thread is the first thread in the pool
+ThreadPool::ThreadPool(unsigned threadcount):m_threadcount(threadcount ? threadcount : 1),m_task(NULL),m_taskGeneration(0),m_busyWorkers(0),m_stopping(false),m_barrierWaiting(0),m_barrierGeneration(0)
+{
+    for(unsigned threadindex = 1 ; threadindex < m_threadcount ; ++threadindex)
+    {
+	m_workers.push_back(std::thread(&ThreadPool::workerLoop, this, threadindex));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stopping = true;
+    }
+
+    m_taskReady.notify_all();
+
+    for(std::vector<std::thread>::iterator iter = m_workers.begin() ; iter != m_workers.end() ; ++iter)
+    {
+	iter->join();
+    }
+}
+
+// returns number of threads taking part in each task
+unsigned ThreadPool::getThreadCount() const
+{
+    return m_threadcount;
+}
+
+// Run a task on every thread in the pool. The calling thread runs the
+// task as thread 0. Returns when every thread has finished the task.
+void ThreadPool::run(const Task& task)
+{
+    if(m_workers.empty())
+    {
+	task(0);
+	return;
+    }
+
+    {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_task = &task;
+	m_busyWorkers = m_workers.size();
+	++m_taskGeneration;
+    }
+
+    m_taskReady.notify_all();
+
+    task(0);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while(m_busyWorkers)
+    {
+	m_taskDone.wait(lock);
+    }
+
+    m_task = NULL;
+}
+
+// Wait until every thread running the current task has reached the barrier.
+// Threads spin briefly as barriers are usually short, then yield.
+void ThreadPool::barrier()
+{
+    if(m_threadcount == 1)
+    {
+	return;
+    }
+
+    uint64_t generation = m_barrierGeneration.load(std::memory_order_acquire);
+
+    if(m_barrierWaiting.fetch_add(1, std::memory_order_acq_rel) + 1 == m_threadcount)
+    {
+	// last thread to arrive releases the others
+	m_barrierWaiting.store(0, std::memory_order_relaxed);
+	m_barrierGeneration.fetch_add(1, std::memory_order_release);
+	return;
+    }
+
+    for(unsigned spins = 0 ; m_barrierGeneration.load(std::memory_order_acquire) == generation ; ++spins)
+    {
+	if(spins > BARRIER_SPIN_LIMIT)
+	{
+	    std::this_thread::yield();
+	}
+    }
+}
+
+// wait for tasks and run them until the pool is destroyed
+void ThreadPool::workerLoop(unsigned threadindex)
+{
+    uint64_t lastGeneration = 0;
+
+    for(;;)
+    {
+	const Task* task;
+
+	{
+	    std::unique_lock<std::mutex> lock(m_mutex);
+
+	    while(!m_stopping && m_taskGeneration == lastGeneration)
+	    {
+		m_taskReady.wait(lock);
+	    }
+
+	    if(m_stopping)
+	    {
+		return;
+	    }
+
+	    lastGeneration = m_taskGeneration;
+	    task = m_task;
+	}
+
+	(*task)(threadindex);
+
+	{
+	    std::lock_guard<std::mutex> lock(m_mutex);
+
+	    if(--m_busyWorkers == 0)
+	    {
+		m_taskDone.notify_one();
+	    }
+	}
+    }
+}
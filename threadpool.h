@@ -0,0 +1,64 @@
+/****************************************************************
+A fixed size pool of worker threads which persist for the life
+of the pool. run() executes a task on every thread in the pool,
+with the calling thread taking part as thread 0, and returns once
+all of them have finished. Threads running a task can wait for
+each other with barrier(). Tasks must not throw.
+****************************************************************/
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <stdint.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+// Number of times a thread polls a barrier before it starts
+// yielding its time slice to other threads
+#define BARRIER_SPIN_LIMIT 4096
+
+class ThreadPool
+{
+    public:
+	typedef std::function<void(unsigned threadindex)> Task;
+
+	ThreadPool(unsigned threadcount);
+	virtual ~ThreadPool();
+
+	// returns number of threads taking part in each task
+	unsigned getThreadCount() const;
+	// run a task on every thread and wait for all of them to finish
+	void run(const Task& task);
+	// wait until every thread running the current task reaches the barrier
+	void barrier();
+
+    private:
+	ThreadPool(const ThreadPool&);
+	ThreadPool& operator=(const ThreadPool&);
+
+	// wait for tasks and run them until the pool is destroyed
+	void workerLoop(unsigned threadindex);
+
+	std::vector<std::thread> m_workers;
+	unsigned m_threadcount;
+
+	std::mutex m_mutex;
+	std::condition_variable m_taskReady;
+	std::condition_variable m_taskDone;
+	// task being run and a count of tasks handed out so far
+	const Task* m_task;
+	uint64_t m_taskGeneration;
+	// number of worker threads still running the current task
+	unsigned m_busyWorkers;
+	bool m_stopping;
+
+	// threads waiting at the barrier and a count of barriers passed
+	std::atomic<unsigned> m_barrierWaiting;
+	std::atomic<uint64_t> m_barrierGeneration;
+};
+
+#endif
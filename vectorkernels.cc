@@ -0,0 +1,558 @@
+/****************************************************************
+Vector kernels used by the ranker: scaling ranks into the rank
+passed along each link, summing those contributions over each
+node's inbound links, applying the decay factor while summing the
+L1 residual, and summing squared differences. Each kernel has a
+portable version as well as AVX2 and AVX-512 versions. The best
+set the CPU supports is chosen at startup with CPUID, so a single
+binary runs well on any x86-64 machine. Other architectures only
+have the portable kernels.
+****************************************************************/
+
+#include "vectorkernels.h"
+
+#include <algorithm>
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define VECTOR_KERNELS_X86
+#include <immintrin.h>
+// GCC 12's intrinsics start some vectors from deliberately undefined values,
+// which -Wall reports as uninitialized once they are inlined
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+// Squared differences are summed in the value type over blocks of this
+// many elements, and the block sums are added up in double
+#define SQUARED_DIFFERENCE_BLOCK_LENGTH 4096
+
+VectorKernels::InstructionSet VectorKernels::s_instructionSet = VectorKernels::getSupportedInstructionSet();
+
+// The portable kernels add up values in the same order as a plain loop over
+// the nodes would, so their results do not depend on the machine.
+
+template<typename Value>
+static void multiplyPortable(Value* product, const Value* a, const Value* b, MatrixIndex length)
+{
+    for(MatrixIndex i = 0 ; i < length ; ++i)
+    {
+	product[i] = a[i] * b[i];
+    }
+}
+
+template<typename Value>
+static void gatherSumsPortable(Value* sums, const Value* values, const EdgeIndex* offsets, const MatrixIndex* degrees,
+			       const MatrixIndex* neighbours, MatrixIndex begin, MatrixIndex end)
+{
+    for(MatrixIndex node = begin ; node < end ; ++node)
+    {
+	const MatrixIndex* neighbour = neighbours + offsets[node];
+	const MatrixIndex* last = neighbour + degrees[node];
+	Value sum = 0;
+
+	for( ; neighbour != last ; ++neighbour)
+	{
+	    sum += values[*neighbour];
+	}
+
+	sums[node] = sum;
+    }
+}
+
+template<typename Value>
+static Value decayAndSumResidualPortable(Value* ranks, const Value* previous, const Value* teleports, Value decay, MatrixIndex length)
+{
+    Value residual = 0;
+
+    for(MatrixIndex i = 0 ; i < length ; ++i)
+    {
+	ranks[i] = (decay * ranks[i]) + teleports[i];
+	residual += fabs(ranks[i] - previous[i]);
+    }
+
+    return residual;
+}
+
+template<typename Value>
+static double sumSquaredDifferencePortable(const Value* a, const Value* b, MatrixIndex length)
+{
+    double sum = 0;
+
+    for(MatrixIndex i = 0 ; i < length ; ++i)
+    {
+	double difference = (double)a[i] - b[i];
+	sum += difference*difference;
+    }
+
+    return sum;
+}
+
+#ifdef VECTOR_KERNELS_X86
+
+// Gathers take signed 32 bit indices. Flipping the top bit of a node index
+// and offsetting the base by 2^31 elements reaches every 32 bit node index.
+#define GATHER_INDEX_BIAS ((uintptr_t)1 << 31)
+
+template<typename Value>
+static const Value* biasGatherBase(const Value* values)
+{
+    return reinterpret_cast<const Value*>(reinterpret_cast<uintptr_t>(values) + GATHER_INDEX_BIAS*sizeof(Value));
+}
+
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+
+// AVX2 operations on each value type, 8 floats or 4 doubles at a time
+template<typename Value>
+struct Avx2;
+
+template<>
+struct Avx2<float>
+{
+    typedef __m256 Vector;
+    static const MatrixIndex LANES = 8;
+
+    static Vector zero() { return _mm256_setzero_ps(); }
+    static Vector broadcast(float value) { return _mm256_set1_ps(value); }
+    static Vector load(const float* values) { return _mm256_loadu_ps(values); }
+    static void store(float* values, Vector vector) { _mm256_storeu_ps(values, vector); }
+    static Vector add(Vector a, Vector b) { return _mm256_add_ps(a, b); }
+    static Vector subtract(Vector a, Vector b) { return _mm256_sub_ps(a, b); }
+    static Vector multiply(Vector a, Vector b) { return _mm256_mul_ps(a, b); }
+    static Vector multiplyAdd(Vector a, Vector b, Vector c) { return _mm256_fmadd_ps(a, b, c); }
+    static Vector absolute(Vector vector) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), vector); }
+
+    static Vector gather(const float* biasedValues, const MatrixIndex* indices)
+    {
+	__m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices));
+	return _mm256_i32gather_ps(biasedValues, _mm256_xor_si256(index, _mm256_set1_epi32(INT32_MIN)), sizeof(float));
+    }
+
+    static float sum(Vector vector)
+    {
+	__m128 half = _mm_add_ps(_mm256_castps256_ps128(vector), _mm256_extractf128_ps(vector, 1));
+	half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+	half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+	return _mm_cvtss_f32(half);
+    }
+};
+
+template<>
+struct Avx2<double>
+{
+    typedef __m256d Vector;
+    static const MatrixIndex LANES = 4;
+
+    static Vector zero() { return _mm256_setzero_pd(); }
+    static Vector broadcast(double value) { return _mm256_set1_pd(value); }
+    static Vector load(const double* values) { return _mm256_loadu_pd(values); }
+    static void store(double* values, Vector vector) { _mm256_storeu_pd(values, vector); }
+    static Vector add(Vector a, Vector b) { return _mm256_add_pd(a, b); }
+    static Vector subtract(Vector a, Vector b) { return _mm256_sub_pd(a, b); }
+    static Vector multiply(Vector a, Vector b) { return _mm256_mul_pd(a, b); }
+    static Vector multiplyAdd(Vector a, Vector b, Vector c) { return _mm256_fmadd_pd(a, b, c); }
+    static Vector absolute(Vector vector) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), vector); }
+
+    static Vector gather(const double* biasedValues, const MatrixIndex* indices)
+    {
+	__m128i index = _mm_loadu_si128(reinterpret_cast<const __m128i*>(indices));
+	return _mm256_i32gather_pd(biasedValues, _mm_xor_si128(index, _mm_set1_epi32(INT32_MIN)), sizeof(double));
+    }
+
+    static double sum(Vector vector)
+    {
+	__m128d half = _mm_add_pd(_mm256_castpd256_pd128(vector), _mm256_extractf128_pd(vector, 1));
+	return _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+    }
+};
+
+template<typename Value>
+static void multiplyAvx2(Value* product, const Value* a, const Value* b, MatrixIndex length)
+{
+    typedef Avx2<Value> Simd;
+    MatrixIndex i = 0;
+
+    for( ; i + Simd::LANES <= length ; i += Simd::LANES)
+    {
+	Simd::store(product + i, Simd::multiply(Simd::load(a + i), Simd::load(b + i)));
+    }
+
+    for( ; i < length ; ++i)
+    {
+	product[i] = a[i] * b[i];
+    }
+}
+
+template<typename Value>
+static void gatherSumsAvx2(Value* sums, const Value* values, const EdgeIndex* offsets, const MatrixIndex* degrees,
+			   const MatrixIndex* neighbours, MatrixIndex begin, MatrixIndex end)
+{
+    typedef Avx2<Value> Simd;
+    const Value* biasedValues = biasGatherBase(values);
+
+    for(MatrixIndex node = begin ; node < end ; ++node)
+    {
+	const MatrixIndex* neighbour = neighbours + offsets[node];
+	MatrixIndex degree = degrees[node];
+	MatrixIndex k = 0;
+	Value sum = 0;
+
+	if(degree >= Simd::LANES)
+	{
+	    typename Simd::Vector partialSums = Simd::zero();
+
+	    for( ; k + Simd::LANES <= degree ; k += Simd::LANES)
+	    {
+		partialSums = Simd::add(partialSums, Simd::gather(biasedValues, neighbour + k));
+	    }
+
+	    sum = Simd::sum(partialSums);
+	}
+
+	for( ; k < degree ; ++k)
+	{
+	    sum += values[neighbour[k]];
+	}
+
+	sums[node] = sum;
+    }
+}
+
+template<typename Value>
+static Value decayAndSumResidualAvx2(Value* ranks, const Value* previous, const Value* teleports, Value decay, MatrixIndex length)
+{
+    typedef Avx2<Value> Simd;
+    typename Simd::Vector decays = Simd::broadcast(decay);
+    typename Simd::Vector residuals = Simd::zero();
+    MatrixIndex i = 0;
+
+    for( ; i + Simd::LANES <= length ; i += Simd::LANES)
+    {
+	typename Simd::Vector rank = Simd::multiplyAdd(decays, Simd::load(ranks + i), Simd::load(teleports + i));
+	Simd::store(ranks + i, rank);
+	residuals = Simd::add(residuals, Simd::absolute(Simd::subtract(rank, Simd::load(previous + i))));
+    }
+
+    Value residual = Simd::sum(residuals);
+
+    for( ; i < length ; ++i)
+    {
+	ranks[i] = (decay * ranks[i]) + teleports[i];
+	residual += fabs(ranks[i] - previous[i]);
+    }
+
+    return residual;
+}
+
+template<typename Value>
+static double sumSquaredDifferenceAvx2(const Value* a, const Value* b, MatrixIndex length)
+{
+    typedef Avx2<Value> Simd;
+    double sum = 0;
+
+    for(MatrixIndex block = 0 ; block < length ; block += SQUARED_DIFFERENCE_BLOCK_LENGTH)
+    {
+	MatrixIndex blockEnd = std::min<MatrixIndex>(length, block + SQUARED_DIFFERENCE_BLOCK_LENGTH);
+	typename Simd::Vector squares = Simd::zero();
+	MatrixIndex i = block;
+
+	for( ; i + Simd::LANES <= blockEnd ; i += Simd::LANES)
+	{
+	    typename Simd::Vector difference = Simd::subtract(Simd::load(a + i), Simd::load(b + i));
+	    squares = Simd::multiplyAdd(difference, difference, squares);
+	}
+
+	Value blockSum = Simd::sum(squares);
+
+	for( ; i < blockEnd ; ++i)
+	{
+	    Value difference = a[i] - b[i];
+	    blockSum += difference*difference;
+	}
+
+	sum += blockSum;
+    }
+
+    return sum;
+}
+
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+
+// AVX-512 operations on each value type, 16 floats or 8 doubles at a time.
+// Gathers of the last few inbound links of a node are masked.
+template<typename Value>
+struct Avx512;
+
+template<>
+struct Avx512<float>
+{
+    typedef __m512 Vector;
+    static const MatrixIndex LANES = 16;
+
+    static Vector zero() { return _mm512_setzero_ps(); }
+    static Vector broadcast(float value) { return _mm512_set1_ps(value); }
+    static Vector load(const float* values) { return _mm512_loadu_ps(values); }
+    static void store(float* values, Vector vector) { _mm512_storeu_ps(values, vector); }
+    static Vector add(Vector a, Vector b) { return _mm512_add_ps(a, b); }
+    static Vector subtract(Vector a, Vector b) { return _mm512_sub_ps(a, b); }
+    static Vector multiply(Vector a, Vector b) { return _mm512_mul_ps(a, b); }
+    static Vector multiplyAdd(Vector a, Vector b, Vector c) { return _mm512_fmadd_ps(a, b, c); }
+    static Vector absolute(Vector vector) { return _mm512_abs_ps(vector); }
+
+    // gather only the first count values, count being at most LANES
+    static Vector gather(const float* biasedValues, const MatrixIndex* indices, MatrixIndex count)
+    {
+	__mmask16 mask = (__mmask16)((1u << count) - 1);
+	__m512i index = _mm512_maskz_loadu_epi32(mask, indices);
+	return _mm512_mask_i32gather_ps(_mm512_setzero_ps(), mask, _mm512_xor_si512(index, _mm512_set1_epi32(INT32_MIN)),
+					biasedValues, sizeof(float));
+    }
+
+    static Vector gather(const float* biasedValues, const MatrixIndex* indices)
+    {
+	__m512i index = _mm512_loadu_si512(indices);
+	return _mm512_i32gather_ps(_mm512_xor_si512(index, _mm512_set1_epi32(INT32_MIN)), biasedValues, sizeof(float));
+    }
+
+    static float sum(Vector vector) { return _mm512_reduce_add_ps(vector); }
+};
+
+template<>
+struct Avx512<double>
+{
+    typedef __m512d Vector;
+    static const MatrixIndex LANES = 8;
+
+    static Vector zero() { return _mm512_setzero_pd(); }
+    static Vector broadcast(double value) { return _mm512_set1_pd(value); }
+    static Vector load(const double* values) { return _mm512_loadu_pd(values); }
+    static void store(double* values, Vector vector) { _mm512_storeu_pd(values, vector); }
+    static Vector add(Vector a, Vector b) { return _mm512_add_pd(a, b); }
+    static Vector subtract(Vector a, Vector b) { return _mm512_sub_pd(a, b); }
+    static Vector multiply(Vector a, Vector b) { return _mm512_mul_pd(a, b); }
+    static Vector multiplyAdd(Vector a, Vector b, Vector c) { return _mm512_fmadd_pd(a, b, c); }
+    static Vector absolute(Vector vector) { return _mm512_abs_pd(vector); }
+
+    // gather only the first count values, count being at most LANES
+    static Vector gather(const double* biasedValues, const MatrixIndex* indices, MatrixIndex count)
+    {
+	__mmask8 mask = (__mmask8)((1u << count) - 1);
+	__m256i index = _mm512_castsi512_si256(_mm512_maskz_loadu_epi32(mask, indices));
+	return _mm512_mask_i32gather_pd(_mm512_setzero_pd(), mask, _mm256_xor_si256(index, _mm256_set1_epi32(INT32_MIN)),
+					biasedValues, sizeof(double));
+    }
+
+    static Vector gather(const double* biasedValues, const MatrixIndex* indices)
+    {
+	__m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices));
+	return _mm512_i32gather_pd(_mm256_xor_si256(index, _mm256_set1_epi32(INT32_MIN)), biasedValues, sizeof(double));
+    }
+
+    static double sum(Vector vector) { return _mm512_reduce_add_pd(vector); }
+};
+
+template<typename Value>
+static void multiplyAvx512(Value* product, const Value* a, const Value* b, MatrixIndex length)
+{
+    typedef Avx512<Value> Simd;
+    MatrixIndex i = 0;
+
+    for( ; i + Simd::LANES <= length ; i += Simd::LANES)
+    {
+	Simd::store(product + i, Simd::multiply(Simd::load(a + i), Simd::load(b + i)));
+    }
+
+    for( ; i < length ; ++i)
+    {
+	product[i] = a[i] * b[i];
+    }
+}
+
+template<typename Value>
+static void gatherSumsAvx512(Value* sums, const Value* values, const EdgeIndex* offsets, const MatrixIndex* degrees,
+			     const MatrixIndex* neighbours, MatrixIndex begin, MatrixIndex end)
+{
+    typedef Avx512<Value> Simd;
+    const Value* biasedValues = biasGatherBase(values);
+
+    for(MatrixIndex node = begin ; node < end ; ++node)
+    {
+	const MatrixIndex* neighbour = neighbours + offsets[node];
+	MatrixIndex degree = degrees[node];
+
+	if(!degree)
+	{
+	    sums[node] = 0;
+	    continue;
+	}
+
+	typename Simd::Vector partialSums = Simd::zero();
+	MatrixIndex k = 0;
+
+	for( ; k + Simd::LANES <= degree ; k += Simd::LANES)
+	{
+	    partialSums = Simd::add(partialSums, Simd::gather(biasedValues, neighbour + k));
+	}
+
+	if(k < degree)
+	{
+	    partialSums = Simd::add(partialSums, Simd::gather(biasedValues, neighbour + k, degree - k));
+	}
+
+	sums[node] = Simd::sum(partialSums);
+    }
+}
+
+template<typename Value>
+static Value decayAndSumResidualAvx512(Value* ranks, const Value* previous, const Value* teleports, Value decay, MatrixIndex length)
+{
+    typedef Avx512<Value> Simd;
+    typename Simd::Vector decays = Simd::broadcast(decay);
+    typename Simd::Vector residuals = Simd::zero();
+    MatrixIndex i = 0;
+
+    for( ; i + Simd::LANES <= length ; i += Simd::LANES)
+    {
+	typename Simd::Vector rank = Simd::multiplyAdd(decays, Simd::load(ranks + i), Simd::load(teleports + i));
+	Simd::store(ranks + i, rank);
+	residuals = Simd::add(residuals, Simd::absolute(Simd::subtract(rank, Simd::load(previous + i))));
+    }
+
+    Value residual = Simd::sum(residuals);
+
+    for( ; i < length ; ++i)
+    {
+	ranks[i] = (decay * ranks[i]) + teleports[i];
+	residual += fabs(ranks[i] - previous[i]);
+    }
+
+    return residual;
+}
+
+template<typename Value>
+static double sumSquaredDifferenceAvx512(const Value* a, const Value* b, MatrixIndex length)
+{
+    typedef Avx512<Value> Simd;
+    double sum = 0;
+
+    for(MatrixIndex block = 0 ; block < length ; block += SQUARED_DIFFERENCE_BLOCK_LENGTH)
+    {
+	MatrixIndex blockEnd = std::min<MatrixIndex>(length, block + SQUARED_DIFFERENCE_BLOCK_LENGTH);
+	typename Simd::Vector squares = Simd::zero();
+	MatrixIndex i = block;
+
+	for( ; i + Simd::LANES <= blockEnd ; i += Simd::LANES)
+	{
+	    typename Simd::Vector difference = Simd::subtract(Simd::load(a + i), Simd::load(b + i));
+	    squares = Simd::multiplyAdd(difference, difference, squares);
+	}
+
+	Value blockSum = Simd::sum(squares);
+
+	for( ; i < blockEnd ; ++i)
+	{
+	    Value difference = a[i] - b[i];
+	    blockSum += difference*difference;
+	}
+
+	sum += blockSum;
+    }
+
+    return sum;
+}
+
+#pragma GCC pop_options
+
+#define AVX2_KERNELS(Value) {multiplyAvx2<Value>, gatherSumsAvx2<Value>, decayAndSumResidualAvx2<Value>, sumSquaredDifferenceAvx2<Value>}
+#define AVX512_KERNELS(Value) {multiplyAvx512<Value>, gatherSumsAvx512<Value>, decayAndSumResidualAvx512<Value>, sumSquaredDifferenceAvx512<Value>}
+
+#else
+
+// only the portable kernels are built for other architectures
+#define AVX2_KERNELS(Value) PORTABLE_KERNELS(Value)
+#define AVX512_KERNELS(Value) PORTABLE_KERNELS(Value)
+
+#endif
+
+#define PORTABLE_KERNELS(Value) {multiplyPortable<Value>, gatherSumsPortable<Value>, decayAndSumResidualPortable<Value>, sumSquaredDifferencePortable<Value>}
+
+// kernels for each instruction set, in InstructionSet order
+static const VectorKernelTable<float> floatKernels[VectorKernels::INSTRUCTION_SET_COUNT] =
+{
+    PORTABLE_KERNELS(float),
+    AVX2_KERNELS(float),
+    AVX512_KERNELS(float)
+};
+
+static const VectorKernelTable<double> doubleKernels[VectorKernels::INSTRUCTION_SET_COUNT] =
+{
+    PORTABLE_KERNELS(double),
+    AVX2_KERNELS(double),
+    AVX512_KERNELS(double)
+};
+
+// Returns the best instruction set the CPU supports, checked with CPUID
+// (which also confirms the operating system saves the vector registers)
+VectorKernels::InstructionSet VectorKernels::getSupportedInstructionSet()
+{
+#ifdef VECTOR_KERNELS_X86
+    // this runs while static objects are constructed, before the CPU model is known
+    __builtin_cpu_init();
+
+    if(__builtin_cpu_supports("avx512f"))
+    {
+	return INSTRUCTIONS_AVX512;
+    }
+
+    if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+	return INSTRUCTIONS_AVX2;
+    }
+#endif
+
+    return INSTRUCTIONS_PORTABLE;
+}
+
+// Use the kernels for an instruction set other than the best supported, for
+// example the portable ones to get the same results on every machine
+bool VectorKernels::setInstructionSet(InstructionSet instructionSet)
+{
+    if(instructionSet > getSupportedInstructionSet())
+    {
+	return false;
+    }
+
+    s_instructionSet = instructionSet;
+
+    return true;
+}
+
+// returns the name of an instruction set, as used on the command line
+const char* VectorKernels::getInstructionSetName(InstructionSet instructionSet)
+{
+    switch(instructionSet)
+    {
+	case INSTRUCTIONS_AVX2:
+	    return "avx2";
+	case INSTRUCTIONS_AVX512:
+	    return "avx512";
+	default:
+	    return "portable";
+    }
+}
+
+template<>
+const VectorKernelTable<float>& VectorKernels::get<float>()
+{
+    return floatKernels[s_instructionSet];
+}
+
+template<>
+const VectorKernelTable<double>& VectorKernels::get<double>()
+{
+    return doubleKernels[s_instructionSet];
+}
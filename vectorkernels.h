@@ -0,0 +1,71 @@
+/****************************************************************
+Vector kernels used by the ranker: scaling ranks into the rank
+passed along each link, summing those contributions over each
+node's inbound links, applying the decay factor while summing the
+L1 residual, and summing squared differences. Each kernel has a
+portable version as well as AVX2 and AVX-512 versions. The best
+set the CPU supports is chosen at startup with CPUID, so a single
+binary runs well on any x86-64 machine. Other architectures only
+have the portable kernels.
+****************************************************************/
+
+#ifndef VECTORKERNELS_H
+#define VECTORKERNELS_H
+
+#include "graphtypes.h"
+
+#include <stdint.h>
+
+// The kernels for one value type, float or double
+template<typename Value>
+struct VectorKernelTable
+{
+    // product[i] = a[i]*b[i] for i < length
+    void (*multiply)(Value* product, const Value* a, const Value* b, MatrixIndex length);
+    // sums[node] = the sum of values[neighbours[offsets[node] + k]] for k < degrees[node],
+    // for nodes begin .. end (compressed sparse columns give each node's inbound sum)
+    void (*gatherSums)(Value* sums, const Value* values, const EdgeIndex* offsets, const MatrixIndex* degrees,
+		       const MatrixIndex* neighbours, MatrixIndex begin, MatrixIndex end);
+    // ranks[i] = decay*ranks[i] + teleports[i] for i < length, returns the sum of |ranks[i] - previous[i]|
+    Value (*decayAndSumResidual)(Value* ranks, const Value* previous, const Value* teleports, Value decay, MatrixIndex length);
+    // returns the sum of (a[i] - b[i])^2 for i < length
+    double (*sumSquaredDifference)(const Value* a, const Value* b, MatrixIndex length);
+};
+
+class VectorKernels
+{
+    public:
+	enum InstructionSet
+	{
+	    INSTRUCTIONS_PORTABLE,
+	    INSTRUCTIONS_AVX2,
+	    INSTRUCTIONS_AVX512,
+	    INSTRUCTION_SET_COUNT
+	};
+
+	// the best instruction set the CPU supports
+	static InstructionSet getSupportedInstructionSet();
+	// the instruction set of the kernels returned by get()
+	static InstructionSet getInstructionSet()
+	{
+	    return s_instructionSet;
+	}
+	// use kernels for the given instruction set, returns false if the CPU does not support it
+	static bool setInstructionSet(InstructionSet instructionSet);
+	// returns the name of an instruction set, as used on the command line
+	static const char* getInstructionSetName(InstructionSet instructionSet);
+
+	// the kernels for the chosen instruction set
+	template<typename Value>
+	static const VectorKernelTable<Value>& get();
+
+    private:
+	static InstructionSet s_instructionSet;
+};
+
+template<>
+const VectorKernelTable<float>& VectorKernels::get<float>();
+template<>
+const VectorKernelTable<double>& VectorKernels::get<double>();
+
+#endif